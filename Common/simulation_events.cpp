@@ -0,0 +1,145 @@
+#include "simulation_events.h"
+
+
+using namespace std;
+
+PxFilterFlags contactReportFilterShader(
+	PxFilterObjectAttributes attributes0, PxFilterData filter_data0,
+	PxFilterObjectAttributes attributes1, PxFilterData filter_data1,
+	PxPairFlags &pair_flags, const void* constant_block, PxU32 constant_block_size)
+{
+	PX_UNUSED(constant_block);
+	PX_UNUSED(constant_block_size);
+
+	// triggerはPxDefaultSimulationFilterShaderと同じ
+	if (PxFilterObjectIsTrigger(attributes0) || PxFilterObjectIsTrigger(attributes1)) {
+		pair_flags = PxPairFlag::eTRIGGER_DEFAULT;
+		return PxFilterFlag::eDEFAULT;
+	}
+
+	pair_flags = PxPairFlag::eCONTACT_DEFAULT;
+
+	// どちらかが相手のグループを購読している場合のみ報告させる
+	if ((filter_data0.word0 & filter_data1.word1) || (filter_data1.word0 & filter_data0.word1))
+		pair_flags |= PxPairFlag::eNOTIFY_TOUCH_FOUND | PxPairFlag::eNOTIFY_CONTACT_POINTS
+			| PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND | PxPairFlag::eNOTIFY_THRESHOLD_FORCE_PERSISTS;
+	return PxFilterFlag::eDEFAULT;
+}
+
+SimulationEventRecorder::SimulationEventRecorder(PxU32 capacity)
+	: mask_(0), head_(0), tail_(0), dropped_cnt_(0), step_(0)
+{
+	PxU32 size = 1;
+	while (size < capacity)
+		size <<= 1;
+	events_.resize(size);
+	mask_ = size - 1;
+}
+
+bool SimulationEventRecorder::pop(SimulationEvent &event)
+{
+	const PxU32 kTail = tail_.load(memory_order_relaxed);
+	if (kTail == head_.load(memory_order_acquire))
+		return false;
+
+	event = events_[kTail & mask_];
+	tail_.store(kTail + 1, memory_order_release);
+	return true;
+}
+
+PxU32 SimulationEventRecorder::drain(vector<SimulationEvent> &events)
+{
+	const PxU32 kTail = tail_.load(memory_order_relaxed);
+	const PxU32 kHead = head_.load(memory_order_acquire);
+	for (PxU32 i = kTail; i != kHead; i++)
+		events.push_back(events_[i & mask_]);
+	tail_.store(kHead, memory_order_release);
+	return kHead - kTail;
+}
+
+void SimulationEventRecorder::push(const SimulationEvent &event)
+{
+	const PxU32 kHead = head_.load(memory_order_relaxed);
+	if (kHead - tail_.load(memory_order_acquire) == (PxU32)events_.size()) {
+		dropped_cnt_.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+
+	events_[kHead & mask_] = event;
+	head_.store(kHead + 1, memory_order_release);
+}
+
+void SimulationEventRecorder::pushActorEvents(SimulationEventType::Enum type, PxActor** actors, PxU32 count)
+{
+	SimulationEvent event = {};
+	event.type = type;
+	event.step = step_;
+	for (PxU32 i = 0; i != count; i++) {
+		event.actors[0] = actors[i];
+		push(event);
+	}
+}
+
+void SimulationEventRecorder::onConstraintBreak(PxConstraintInfo* constraints, PxU32 count)
+{
+	SimulationEvent event = {};
+	event.type = SimulationEventType::eCONSTRAINT_BREAK;
+	event.step = step_;
+	for (PxU32 i = 0; i != count; i++) {
+		// joint以外の拘束(vehicleなど)は記録しない
+		if (constraints[i].type != PxConstraintExtIDs::eJOINT)
+			continue;
+
+		PxJoint* joint = static_cast<PxJoint*>(constraints[i].externalReference);
+		PxRigidActor *actor0, *actor1;
+		joint->getActors(actor0, actor1);
+		event.joint = joint;
+		event.actors[0] = actor0;
+		event.actors[1] = actor1;
+		push(event);
+	}
+}
+
+void SimulationEventRecorder::onWake(PxActor** actors, PxU32 count)
+{
+	pushActorEvents(SimulationEventType::eWAKE, actors, count);
+}
+
+void SimulationEventRecorder::onSleep(PxActor** actors, PxU32 count)
+{
+	pushActorEvents(SimulationEventType::eSLEEP, actors, count);
+}
+
+void SimulationEventRecorder::onContact(const PxContactPairHeader &pair_header,
+	const PxContactPair* pairs, PxU32 pair_cnt)
+{
+	// 削除されたアクターのペアは読み出さない
+	if (pair_header.flags & (PxContactPairHeaderFlag::eREMOVED_ACTOR_0 | PxContactPairHeaderFlag::eREMOVED_ACTOR_1))
+		return;
+
+	// 接触し始めたペアと、力がしきい値を超えたペアを記録する(両方の場合はeCONTACTのみ)
+	const PxPairFlags kForceEvents = PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND | PxPairFlag::eNOTIFY_THRESHOLD_FORCE_PERSISTS;
+	PxContactPairPoint points[kMaxContactPointCnt];
+	for (PxU32 i = 0; i != pair_cnt; i++) {
+		const PxContactPair &pair = pairs[i];
+		if (!(pair.events & (PxPairFlag::eNOTIFY_TOUCH_FOUND | kForceEvents)))
+			continue;
+		if (pair.flags & (PxContactPairFlag::eREMOVED_SHAPE_0 | PxContactPairFlag::eREMOVED_SHAPE_1))
+			continue;
+
+		SimulationEvent event = {};
+		event.type = pair.events & PxPairFlag::eNOTIFY_TOUCH_FOUND
+			? SimulationEventType::eCONTACT : SimulationEventType::eCONTACT_FORCE;
+		event.step = step_;
+		event.actors[0] = pair_header.actors[0];
+		event.actors[1] = pair_header.actors[1];
+		event.groups[0] = pair.shapes[0]->getSimulationFilterData().word0;
+		event.groups[1] = pair.shapes[1]->getSimulationFilterData().word0;
+
+		const PxU32 kPointCnt = pair.extractContacts(points, kMaxContactPointCnt);
+		event.position = kPointCnt ? points[0].position : PxVec3(0.0f);
+		for (PxU32 p = 0; p != kPointCnt; p++)
+			event.impulse += points[p].impulse.magnitude();
+		push(event);
+	}
+}
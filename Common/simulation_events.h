@@ -0,0 +1,95 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <atomic>
+
+using namespace std;
+using namespace physx;
+
+// シミュレーションイベントの種類
+struct SimulationEventType {
+	enum Enum {
+		eCONSTRAINT_BREAK,  // jointが破断した
+		eWAKE,              // アクターが起きた(PxActorFlag::eSEND_SLEEP_NOTIFIESを設定したもののみ)
+		eSLEEP,             // アクターがスリープした(同上)
+		eCONTACT,           // 購読したグループ同士が接触し始めた
+		eCONTACT_FORCE,     // 購読したグループ同士の接触の力がcontact report thresholdを超えた(接触し始めた場合を除く)
+		eCOUNT
+	};
+};
+
+// 1つのシミュレーションイベント
+struct SimulationEvent {
+	SimulationEventType::Enum type;
+	PxU32 step;          // イベントが起きたステップ(SimulationEventRecorder::setStepで設定した値)
+	PxActor* actors[2];  // eWAKE, eSLEEPはactors[0]のみ。eCONSTRAINT_BREAKはjointの2つのアクター
+	PxJoint* joint;      // eCONSTRAINT_BREAKのみ
+	PxU32 groups[2];     // eCONTACT, eCONTACT_FORCEのみ。2つのshapeのグループ(PxFilterData::word0)
+	PxVec3 position;     // eCONTACT, eCONTACT_FORCEのみ。最初の接触点
+	PxReal impulse;      // eCONTACT, eCONTACT_FORCEのみ。接触点の力積の大きさの合計
+};
+
+// 接触を報告させるshapeのPxFilterDataを作る
+// group: shapeが属するグループのビット
+// report_groups: 接触したときにonContactで報告させる相手のグループのビット(0なら報告させない)
+inline PxFilterData makeContactReportFilterData(PxU32 group, PxU32 report_groups)
+{
+	return PxFilterData(group, report_groups, 0, 0);
+}
+
+// PxDefaultSimulationFilterShaderの代わりに使うフィルタシェーダ
+// 全てのペアを通常通り衝突させ、makeContactReportFilterDataで購読したペアのみ接触を報告させる
+// (報告しないペアでは接触点を書き出さないので、通常のペアのコストは増えない)
+// 購読したペアは、どちらかのアクターにPxRigidBody::setContactReportThresholdを設定していれば、
+// 接触が続いている間も力がしきい値を超えたステップを報告する(eCONTACT_FORCE)
+PxFilterFlags contactReportFilterShader(
+	PxFilterObjectAttributes attributes0, PxFilterData filter_data0,
+	PxFilterObjectAttributes attributes1, PxFilterData filter_data1,
+	PxPairFlags &pair_flags, const void* constant_block, PxU32 constant_block_size);
+
+// PxSimulationEventCallbackに報告されたイベントを固定長のリングバッファに記録する
+// 記録はfetchResultsを呼んだスレッドで行われ、取り出しは別の1つのスレッドから行ってよい(ロックを使わない)
+// バッファが一杯の場合、新しいイベントは捨てて数だけ数える
+//
+// PxSceneDesc::simulationEventCallbackに設定し、各ステップのsimulateの前にsetStepを呼ぶ
+class SimulationEventRecorder : public PxSimulationEventCallback {
+public:
+	// capacity: 記録できるイベント数(2のべき乗に切り上げる)
+	explicit SimulationEventRecorder(PxU32 capacity = 4096);
+
+	SimulationEventRecorder(const SimulationEventRecorder&) = delete;
+	SimulationEventRecorder& operator=(const SimulationEventRecorder&) = delete;
+
+	// 以降に記録するイベントのステップ
+	void setStep(PxU32 step) { step_ = step; }
+
+	// 最も古いイベントを1つ取り出す。無ければfalse
+	bool pop(SimulationEvent &event);
+
+	// 全てのイベントを取り出してeventsの末尾に追加し、取り出した数を返す
+	PxU32 drain(vector<SimulationEvent> &events);
+
+	// バッファが一杯で捨てたイベントの数
+	PxU64 getDroppedCount() const { return dropped_cnt_.load(memory_order_relaxed); }
+
+	// PxSimulationEventCallback
+	virtual void onConstraintBreak(PxConstraintInfo* constraints, PxU32 count);
+	virtual void onWake(PxActor** actors, PxU32 count);
+	virtual void onSleep(PxActor** actors, PxU32 count);
+	virtual void onContact(const PxContactPairHeader &pair_header, const PxContactPair* pairs, PxU32 pair_cnt);
+	virtual void onTrigger(PxTriggerPair*, PxU32) {}
+	virtual void onAdvance(const PxRigidBody*const*, const PxTransform*, const PxU32) {}
+
+private:
+	static const PxU32 kMaxContactPointCnt = 8;  // 1つのペアから読み出す接触点の数
+
+	vector<SimulationEvent> events_;
+	PxU32 mask_;                 // events_.size() - 1
+	atomic<PxU32> head_;         // 次に書き込む位置(記録側のみが進める)
+	atomic<PxU32> tail_;         // 次に読み出す位置(取り出し側のみが進める)
+	atomic<PxU64> dropped_cnt_;
+	PxU32 step_;
+
+	void push(const SimulationEvent &event);
+	void pushActorEvents(SimulationEventType::Enum type, PxActor** actors, PxU32 count);
+};
@@ -0,0 +1,129 @@
+#include "telemetry_log.h"
+#include <chrono>
+
+
+using namespace std;
+
+TelemetryLog::TelemetryLog()
+	: format_(TelemetryFormat::eBINARY), mask_(0), written_cnt_(0), head_(0), tail_(0), dropped_cnt_(0),
+	stopping_(false)
+{
+}
+
+TelemetryLog::~TelemetryLog()
+{
+	close();
+}
+
+bool TelemetryLog::open(const string &path, TelemetryFormat::Enum format, PxU32 capacity)
+{
+	if (isOpen())
+		return false;
+
+	stream_.open(path, format == TelemetryFormat::eBINARY ? ios::binary : ios::out);
+	if (!stream_)
+		return false;
+	format_ = format;
+	if (format_ == TelemetryFormat::eBINARY)
+		writeTelemetryHeader(stream_, TelemetryHeader());
+	else
+		writeTelemetryCsvHeader(stream_);
+
+	size_t record_cnt = 1;
+	while (record_cnt < capacity)
+		record_cnt *= 2;
+	records_.resize(record_cnt);
+	mask_ = record_cnt - 1;
+	head_.store(0, memory_order_relaxed);
+	tail_.store(0, memory_order_relaxed);
+	dropped_cnt_.store(0, memory_order_relaxed);
+	written_cnt_ = 0;
+	stopping_.store(false, memory_order_relaxed);
+	writer_thread_ = thread(&TelemetryLog::writerLoop, this);
+	return true;
+}
+
+bool TelemetryLog::push(PxU32 step, PxU32 actor_id, const PxTransform &pose, const PxVec3 &linear_velocity,
+	const PxVec3 &angular_velocity)
+{
+	const size_t kHead = head_.load(memory_order_relaxed);
+	if (kHead - tail_.load(memory_order_acquire) == records_.size()) {
+		dropped_cnt_.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+	TelemetryRecord &record = records_[kHead & mask_];
+	record.step = step;
+	record.actor_id = actor_id;
+	record.q[0] = pose.q.x;
+	record.q[1] = pose.q.y;
+	record.q[2] = pose.q.z;
+	record.q[3] = pose.q.w;
+	record.p[0] = pose.p.x;
+	record.p[1] = pose.p.y;
+	record.p[2] = pose.p.z;
+	record.linear_velocity[0] = linear_velocity.x;
+	record.linear_velocity[1] = linear_velocity.y;
+	record.linear_velocity[2] = linear_velocity.z;
+	record.angular_velocity[0] = angular_velocity.x;
+	record.angular_velocity[1] = angular_velocity.y;
+	record.angular_velocity[2] = angular_velocity.z;
+	head_.store(kHead + 1, memory_order_release);
+	return true;
+}
+
+void TelemetryLog::close()
+{
+	if (!isOpen())
+		return;
+	stopping_.store(true, memory_order_release);
+	writer_thread_.join();
+
+	if (format_ == TelemetryFormat::eBINARY) {
+		TelemetryHeader header;
+		header.record_cnt = written_cnt_;
+		header.dropped_cnt = getDroppedCount();
+		stream_.seekp(0);
+		writeTelemetryHeader(stream_, header);
+	}
+	stream_.close();
+	records_.clear();
+}
+
+// 溜まったレコードをまとめて書き出し、無ければ少し待つ
+// stoppingになった後は、残りを全て書き出してから終了する
+void TelemetryLog::writerLoop()
+{
+	const chrono::milliseconds kIdleWait(1);
+	for (;;) {
+		const bool kStopping = stopping_.load(memory_order_acquire);
+		const size_t kTail = tail_.load(memory_order_relaxed);
+		const size_t kHead = head_.load(memory_order_acquire);
+		if (kHead == kTail) {
+			if (kStopping)
+				break;
+			this_thread::sleep_for(kIdleWait);
+			continue;
+		}
+
+		// リングバッファの終端で折り返す場合は2回に分ける
+		const size_t kBegin = kTail & mask_;
+		const size_t kFirstCnt = PxMin(kHead - kTail, records_.size() - kBegin);
+		writeRecords(&records_[kBegin], kFirstCnt);
+		writeRecords(&records_[0], kHead - kTail - kFirstCnt);
+		tail_.store(kHead, memory_order_release);
+	}
+	stream_.flush();
+}
+
+void TelemetryLog::writeRecords(const TelemetryRecord* records, size_t record_cnt)
+{
+	if (format_ == TelemetryFormat::eBINARY) {
+		stream_.write((const char*)records, record_cnt * sizeof(TelemetryRecord));
+	}
+	else {
+		for (size_t i = 0; i != record_cnt; i++)
+			writeTelemetryCsv(stream_, records[i]);
+	}
+	written_cnt_ += record_cnt;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "telemetry_record.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+using namespace physx;
+
+// テレメトリログの出力形式
+struct TelemetryFormat {
+	enum Enum {
+		eBINARY,  // telemetry_record.hの形式(PhysXTelemetryDecodeでCSVに変換する)
+		eCSV      // writeTelemetryCsvの形式
+	};
+};
+
+// シミュレーションのステップごとのアクターの状態(姿勢と速度)をファイルに書き出す
+// シミュレーションスレッドはpushで固定サイズのレコードをリングバッファに入れるだけで、
+// ファイルへの書き込み(と標準出力へのflush)を待たない
+//
+// リングバッファは書き込み側(push)と読み出し側(書き出しスレッド)が1つずつのSPSCで、ロックを使わない
+// リングバッファが一杯のときはシミュレーションを止めずにレコードを捨て、捨てた数を数える
+// pushは1つのスレッドからのみ呼ぶ
+class TelemetryLog {
+public:
+	TelemetryLog();
+	~TelemetryLog();
+	TelemetryLog(const TelemetryLog&) = delete;
+	TelemetryLog& operator=(const TelemetryLog&) = delete;
+
+	// ファイルを開いて書き出しスレッドを開始する
+	// capacity: リングバッファのレコード数(2の累乗に切り上げる)
+	bool open(const string &path, TelemetryFormat::Enum format, PxU32 capacity = kDefaultCapacity);
+
+	// レコードをリングバッファに入れる。一杯の場合は捨ててfalseを返す
+	bool push(PxU32 step, PxU32 actor_id, const PxTransform &pose, const PxVec3 &linear_velocity,
+		const PxVec3 &angular_velocity);
+
+	// アクターの状態をpushする
+	bool push(PxU32 step, PxU32 actor_id, const PxRigidDynamic &actor)
+	{
+		return push(step, actor_id, actor.getGlobalPose(), actor.getLinearVelocity(), actor.getAngularVelocity());
+	}
+
+	// リングバッファに残っているレコードを全て書き出してファイルを閉じる
+	// バイナリではヘッダにレコード数と捨てたレコード数を書き込む
+	void close();
+
+	bool isOpen() const { return writer_thread_.joinable(); }
+	PxU64 getWrittenCount() const { return written_cnt_; }  // closeの後に呼ぶ
+	PxU64 getDroppedCount() const { return dropped_cnt_.load(memory_order_relaxed); }
+
+	static const PxU32 kDefaultCapacity = 64 * 1024;
+
+private:
+	static const size_t kCacheLineSize = 64;
+
+	TelemetryFormat::Enum format_;
+	ofstream stream_;
+	vector<TelemetryRecord> records_;
+	size_t mask_;
+	PxU64 written_cnt_;  // 書き出しスレッドのみが更新する
+
+	// 書き込み側と読み出し側が別々に更新する位置は、別のキャッシュラインに置く
+	alignas(kCacheLineSize) atomic<size_t> head_;  // 次にpushする位置(pushのみが更新する)
+	alignas(kCacheLineSize) atomic<size_t> tail_;  // 次に書き出す位置(書き出しスレッドのみが更新する)
+	alignas(kCacheLineSize) atomic<PxU64> dropped_cnt_;
+	atomic<bool> stopping_;
+	thread writer_thread_;
+
+	void writerLoop();
+	void writeRecords(const TelemetryRecord* records, size_t record_cnt);
+};
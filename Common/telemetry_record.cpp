@@ -0,0 +1,49 @@
+#include "telemetry_record.h"
+#include <cstring>
+
+
+using namespace std;
+
+namespace {
+	const char kMagic[4] = { 'P', 'X', 'T', 'L' };
+}
+
+void writeTelemetryHeader(ostream &out, const TelemetryHeader &header)
+{
+	const uint32_t kReserved = 0;
+	out.write(kMagic, sizeof(kMagic));
+	out.write((const char*)&header.version, sizeof(uint32_t));
+	out.write((const char*)&header.record_size, sizeof(uint32_t));
+	out.write((const char*)&kReserved, sizeof(uint32_t));
+	out.write((const char*)&header.record_cnt, sizeof(uint64_t));
+	out.write((const char*)&header.dropped_cnt, sizeof(uint64_t));
+}
+
+bool readTelemetryHeader(istream &in, TelemetryHeader &header)
+{
+	char magic[4];
+	uint32_t reserved;
+	in.read(magic, sizeof(magic));
+	in.read((char*)&header.version, sizeof(uint32_t));
+	in.read((char*)&header.record_size, sizeof(uint32_t));
+	in.read((char*)&reserved, sizeof(uint32_t));
+	in.read((char*)&header.record_cnt, sizeof(uint64_t));
+	in.read((char*)&header.dropped_cnt, sizeof(uint64_t));
+	return in && memcmp(magic, kMagic, sizeof(kMagic)) == 0 && header.version == TelemetryHeader::kVersion
+		&& header.record_size == sizeof(TelemetryRecord);
+}
+
+void writeTelemetryCsvHeader(ostream &out)
+{
+	out << "step,actor,px,py,pz,qx,qy,qz,qw,vx,vy,vz,wx,wy,wz\n";
+}
+
+void writeTelemetryCsv(ostream &out, const TelemetryRecord &record)
+{
+	out << record.step << "," << record.actor_id
+		<< "," << record.p[0] << "," << record.p[1] << "," << record.p[2]
+		<< "," << record.q[0] << "," << record.q[1] << "," << record.q[2] << "," << record.q[3]
+		<< "," << record.linear_velocity[0] << "," << record.linear_velocity[1] << "," << record.linear_velocity[2]
+		<< "," << record.angular_velocity[0] << "," << record.angular_velocity[1] << "," << record.angular_velocity[2]
+		<< "\n";
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+using namespace std;
+
+// テレメトリログ(TelemetryLog)の1レコードとファイルの形式
+// デコーダ(PhysXTelemetryDecode)からも使うので、PhysXのヘッダには依存しない
+//
+// バイナリの形式(リトルエンディアン)
+//  ヘッダ:   "PXTL", バージョン(uint32), レコードのサイズ(uint32), 予約(uint32),
+//            レコード数(uint64), 捨てたレコード数(uint64)
+//  レコード: TelemetryRecordを書き出した順に並べる
+// レコード数と捨てたレコード数は、ログを閉じるときに書き込む
+struct TelemetryRecord {
+	uint32_t step;
+	uint32_t actor_id;
+	float q[4];  // 姿勢の回転(x, y, z, w)
+	float p[3];  // 位置
+	float linear_velocity[3];
+	float angular_velocity[3];
+};
+
+struct TelemetryHeader {
+	static const uint32_t kVersion = 1;
+
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t record_cnt;
+	uint64_t dropped_cnt;
+
+	TelemetryHeader() : version(kVersion), record_size(sizeof(TelemetryRecord)), record_cnt(0), dropped_cnt(0) {}
+};
+
+// ヘッダの書き込みと読み込み
+// 読み込みではマジックナンバーとバージョン、レコードのサイズが一致しない場合にfalseを返す
+void writeTelemetryHeader(ostream &out, const TelemetryHeader &header);
+bool readTelemetryHeader(istream &in, TelemetryHeader &header);
+
+// CSVの見出し行とレコードの行
+void writeTelemetryCsvHeader(ostream &out);
+void writeTelemetryCsv(ostream &out, const TelemetryRecord &record);
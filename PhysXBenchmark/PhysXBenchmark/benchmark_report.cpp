@@ -0,0 +1,125 @@
+#include "benchmark_report.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+
+using namespace std;
+
+// 昇順に並んだvaluesのpパーセンタイル(nearest-rank法)
+static double percentile(const vector<double> &values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	size_t rank = (size_t)ceil(p / 100.0 * values.size());
+	return values[PxClamp(rank, (size_t)1, values.size()) - 1];
+}
+
+void BenchmarkResult::setStepTimes(const vector<double> &step_times)
+{
+	vector<double> sorted(step_times);
+	sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (size_t i = 0; i != sorted.size(); i++)
+		total += sorted[i];
+
+	total_ms = total * 1000.0;
+	mean_ms = sorted.empty() ? 0.0 : total_ms / sorted.size();
+	p50_ms = percentile(sorted, 50.0) * 1000.0;
+	p95_ms = percentile(sorted, 95.0) * 1000.0;
+	p99_ms = percentile(sorted, 99.0) * 1000.0;
+	max_ms = sorted.empty() ? 0.0 : sorted.back() * 1000.0;
+}
+
+// PhysXのバージョン("4.1.1"など)
+static string physxVersion()
+{
+	stringstream version;
+	version << PX_PHYSICS_VERSION_MAJOR << "." << PX_PHYSICS_VERSION_MINOR << "." << PX_PHYSICS_VERSION_BUGFIX;
+	return version.str();
+}
+
+// ビルド設定
+static const char* buildConfiguration()
+{
+#if defined(_DEBUG)
+	return "debug";
+#else
+	return "release";
+#endif
+}
+
+static void writeText(ostream &out, const vector<BenchmarkResult> &results)
+{
+	out << "PhysX " << physxVersion() << " (" << buildConfiguration() << ")" << endl;
+	out << "scene\tprofile\tthreads\tsteps\ttotal[ms]\tmean\tp50\tp95\tp99\tmax\tactive\tsleeping"
+		"\tjoints\tdrift max[mm]\tdrift mean" << endl;
+	for (size_t i = 0; i != results.size(); i++) {
+		const BenchmarkResult &r = results[i];
+		out << r.scene << "\t" << r.profile << "\t" << r.thread_cnt << "\t" << r.steps << "\t"
+			<< fixed << setprecision(1) << r.total_ms << "\t"
+			<< setprecision(3) << r.mean_ms << "\t" << r.p50_ms << "\t" << r.p95_ms << "\t"
+			<< r.p99_ms << "\t" << r.max_ms << "\t"
+			<< r.active_actor_cnt << "\t" << r.sleeping_actor_cnt << "\t"
+			<< r.joint_cnt << "\t" << r.joint_drift_max_mm << "\t" << r.joint_drift_mean_mm << endl;
+	}
+}
+
+static void writeJson(ostream &out, const vector<BenchmarkResult> &results)
+{
+	out << "{" << endl;
+	out << "\t\"physx_version\": \"" << physxVersion() << "\"," << endl;
+	out << "\t\"build\": \"" << buildConfiguration() << "\"," << endl;
+	out << "\t\"results\": [" << endl;
+	for (size_t i = 0; i != results.size(); i++) {
+		const BenchmarkResult &r = results[i];
+		out << fixed << setprecision(4)
+			<< "\t\t{\"scene\": \"" << r.scene << "\", \"profile\": \"" << r.profile
+			<< "\", \"threads\": " << r.thread_cnt
+			<< ", \"warmup_steps\": " << r.warmup_steps << ", \"steps\": " << r.steps
+			<< ", \"total_ms\": " << r.total_ms << ", \"mean_ms\": " << r.mean_ms
+			<< ", \"p50_ms\": " << r.p50_ms << ", \"p95_ms\": " << r.p95_ms
+			<< ", \"p99_ms\": " << r.p99_ms << ", \"max_ms\": " << r.max_ms
+			<< ", \"dynamic_actors\": " << r.dynamic_actor_cnt
+			<< ", \"active_actors\": " << r.active_actor_cnt
+			<< ", \"sleeping_actors\": " << r.sleeping_actor_cnt
+			<< ", \"joints\": " << r.joint_cnt
+			<< ", \"joint_drift_max_mm\": " << r.joint_drift_max_mm
+			<< ", \"joint_drift_mean_mm\": " << r.joint_drift_mean_mm << "}"
+			<< (i + 1 != results.size() ? "," : "") << endl;
+	}
+	out << "\t]" << endl;
+	out << "}" << endl;
+}
+
+static void writeCsv(ostream &out, const vector<BenchmarkResult> &results)
+{
+	out << "physx_version,build,scene,profile,threads,warmup_steps,steps,total_ms,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,"
+		"dynamic_actors,active_actors,sleeping_actors,joints,joint_drift_max_mm,joint_drift_mean_mm" << endl;
+	for (size_t i = 0; i != results.size(); i++) {
+		const BenchmarkResult &r = results[i];
+		out << physxVersion() << "," << buildConfiguration() << "," << r.scene << "," << r.profile << ","
+			<< r.thread_cnt << "," << r.warmup_steps << "," << r.steps << ","
+			<< fixed << setprecision(4) << r.total_ms << "," << r.mean_ms << ","
+			<< r.p50_ms << "," << r.p95_ms << "," << r.p99_ms << "," << r.max_ms << ","
+			<< r.dynamic_actor_cnt << "," << r.active_actor_cnt << "," << r.sleeping_actor_cnt << ","
+			<< r.joint_cnt << "," << r.joint_drift_max_mm << "," << r.joint_drift_mean_mm << endl;
+	}
+}
+
+void writeBenchmarkReport(ostream &out, const vector<BenchmarkResult> &results, ReportFormat::Enum format)
+{
+	switch (format) {
+	case ReportFormat::eJSON:
+		writeJson(out, results);
+		break;
+	case ReportFormat::eCSV:
+		writeCsv(out, results);
+		break;
+	default:
+		writeText(out, results);
+		break;
+	}
+}
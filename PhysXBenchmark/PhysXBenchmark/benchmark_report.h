@@ -0,0 +1,51 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <string>
+#include <ostream>
+
+using namespace std;
+using namespace physx;
+
+// 1つのシーンの計測結果
+struct BenchmarkResult {
+	string scene;
+	string profile;  // ソルバーのプロファイル(solver_profile.h)
+	PxU32 thread_cnt;
+	PxU32 warmup_steps;
+	PxU32 steps;
+
+	// ステップ時間(ms)
+	double total_ms;
+	double mean_ms;
+	double p50_ms;
+	double p95_ms;
+	double p99_ms;
+	double max_ms;
+
+	// 計測終了時の動的アクター数
+	PxU32 dynamic_actor_cnt;
+	PxU32 active_actor_cnt;
+	PxU32 sleeping_actor_cnt;
+
+	// 安定性の指標: 計測中の各ステップのjointのずれ(mm)。jointが無いシーンは0
+	PxU32 joint_cnt;
+	double joint_drift_max_mm;
+	double joint_drift_mean_mm;
+
+	// step_times: 各ステップの時間(秒)からtotal/mean/パーセンタイルを求める
+	void setStepTimes(const vector<double> &step_times);
+};
+
+// 結果の出力形式
+struct ReportFormat {
+	enum Enum {
+		eTEXT,  // 表形式(人が読む用)
+		eJSON,
+		eCSV    // 1行目はヘッダ
+	};
+};
+
+// 計測結果を書き出す
+// JSON/CSVにはPhysXのバージョンとビルド設定も含め、バージョンや設定を変えた結果と比較できるようにする
+void writeBenchmarkReport(ostream &out, const vector<BenchmarkResult> &results, ReportFormat::Enum format);
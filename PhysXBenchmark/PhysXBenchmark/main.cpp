@@ -0,0 +1,254 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include "PxPhysicsAPI.h"
+#include "benchmark_report.h"
+#include "../../PhysXHelloWorld/PhysXHelloWorld/hello_world_scene.h"
+#include "../../PhysXJoint/PhysXJoint/joint_scene.h"
+#include "../../PhysXPitagora/PhysXPitagora/pitagora_scene.h"
+#include "../../PhysXPitagora/PhysXPitagora/scene_builder.h"
+#include "../../PhysXPitagora/PhysXPitagora/solver_profile.h"
+
+using namespace std;
+using namespace physx;
+
+PxDefaultAllocator      gAllocator;
+PxDefaultErrorCallback  gErrorCallback;
+PxFoundation*           gFoundation = NULL;
+PxPhysics*              gPhysics = NULL;
+
+// 各ステップのシミュレーション前に呼ぶシーンの更新処理
+typedef function<void(PxU32 step)> SceneUpdate;
+
+// 計測対象のシーン
+// 各サンプルのシーン作成関数でシーンを組み立て、更新処理を返す
+struct BenchmarkScene {
+	const char* name;
+	PxReal gravity;
+	SceneUpdate (*setup)(PxPhysics &physics, PxScene &scene);
+};
+
+SceneUpdate setupHelloWorld(PxPhysics &physics, PxScene &scene)
+{
+	createHelloWorldScene(physics, scene);
+	return SceneUpdate();
+}
+
+SceneUpdate setupJoint(PxPhysics &physics, PxScene &scene)
+{
+	createJointScene(physics, scene);
+	return SceneUpdate();
+}
+
+SceneUpdate setupPitagora(PxPhysics &physics, PxScene &scene)
+{
+	vector<PxRigidDynamic*> pushers = createPitagoraScene(physics, scene);
+	return [pushers](PxU32 step) { updatePitagoraScene(pushers, step); };
+}
+
+// 振り子をarticulationで作ったピタゴラ装置
+SceneUpdate setupPitagoraArticulation(PxPhysics &physics, PxScene &scene)
+{
+	PitagoraSceneDesc desc;
+	desc.chain_type = ChainType::eARTICULATION;
+	desc.chain_position_iterations = 4;
+	vector<PxRigidDynamic*> pushers = createPitagoraScene(physics, scene, desc);
+	return [pushers](PxU32 step) { updatePitagoraScene(pushers, step); };
+}
+
+const BenchmarkScene kScenes[] = {
+	{ "helloworld", -9.8f, setupHelloWorld },
+	{ "joint", -9.81f, setupJoint },
+	{ "pitagora", -9.8f, setupPitagora },
+	{ "pitagora-articulation", -9.8f, setupPitagoraArticulation },
+};
+const size_t kSceneCnt = sizeof(kScenes) / sizeof(kScenes[0]);
+
+// 計測条件
+struct BenchmarkOptions {
+	PxU32 warmup_steps;
+	PxU32 steps;
+	PxU32 thread_cnt;
+};
+
+// PhysXの初期化(PVDは使わない)
+void initPhysics()
+{
+	gFoundation = PxCreateFoundation(PX_PHYSICS_VERSION, gAllocator, gErrorCallback);
+	gPhysics = PxCreatePhysics(PX_PHYSICS_VERSION, *gFoundation, PxTolerancesScale());
+	PxInitExtensions(*gPhysics, NULL);
+}
+
+// PhysXの終了処理
+void cleanupPhysics()
+{
+	PxCloseExtensions();
+	gPhysics->release();
+	gFoundation->release();
+}
+
+// シーンをprofileの設定で新しく作成し、warmup_steps進めた後のsteps回のステップ時間を計測する
+// 安定性の指標として、計測する各ステップの後にjointのずれも測る(ステップ時間には含めない)
+BenchmarkResult runBenchmark(const BenchmarkScene &bench_scene, const SolverProfile &profile,
+	const BenchmarkOptions &options)
+{
+	PxDefaultCpuDispatcher* dispatcher = PxDefaultCpuDispatcherCreate(options.thread_cnt);
+	PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
+	sceneDesc.gravity = PxVec3(0.0f, bench_scene.gravity, 0.0f);
+	sceneDesc.cpuDispatcher = dispatcher;
+	sceneDesc.filterShader = PxDefaultSimulationFilterShader;
+	applySolverProfile(profile, sceneDesc);
+	PxScene* scene = gPhysics->createScene(sceneDesc);
+
+	SceneUpdate update = bench_scene.setup(*gPhysics, *scene);
+	applySolverProfile(profile, *scene);
+
+	JointDrift initial_drift;
+	measureJointDrift(*scene, initial_drift);
+	JointDrift drift;
+
+	const PxReal kElapsedTime = 1.0f / 60.0f; // 60Hz
+	vector<double> step_times;
+	step_times.reserve(options.steps);
+	for (PxU32 step = 0; step != options.warmup_steps + options.steps; step++) {
+		if (update)
+			update(step);
+
+		const chrono::steady_clock::time_point kStart = chrono::steady_clock::now();
+		scene->simulate(kElapsedTime);
+		scene->fetchResults(true);
+		if (step >= options.warmup_steps) {
+			step_times.push_back(chrono::duration<double>(chrono::steady_clock::now() - kStart).count());
+			measureJointDrift(*scene, drift);
+		}
+	}
+
+	BenchmarkResult result;
+	result.scene = bench_scene.name;
+	result.profile = profile.name;
+	result.thread_cnt = options.thread_cnt;
+	result.warmup_steps = options.warmup_steps;
+	result.steps = options.steps;
+	result.setStepTimes(step_times);
+
+	// 動的アクターのうち、起きているものと眠っているものを数える
+	const PxU32 kDynamicCnt = scene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+	vector<PxActor*> actors(kDynamicCnt);
+	scene->getActors(PxActorTypeFlag::eRIGID_DYNAMIC, actors.data(), kDynamicCnt);
+	result.dynamic_actor_cnt = kDynamicCnt;
+	result.sleeping_actor_cnt = 0;
+	for (PxU32 i = 0; i != kDynamicCnt; i++) {
+		if (static_cast<PxRigidDynamic*>(actors[i])->isSleeping())
+			result.sleeping_actor_cnt++;
+	}
+	result.active_actor_cnt = kDynamicCnt - result.sleeping_actor_cnt;
+	result.joint_cnt = initial_drift.sample_cnt;
+	result.joint_drift_max_mm = drift.max_error * 1000.0;
+	result.joint_drift_mean_mm = drift.getMeanError() * 1000.0;
+
+	releaseScene(*scene);
+	dispatcher->release();
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	// コマンドライン引数
+	//  --scene <name>   : 計測するシーン(helloworld, joint, pitagora, pitagora-articulation)。複数指定可、省略時は全て
+	//  --steps <n>      : 計測するステップ数(省略時は1000)
+	//  --warmup <n>     : 計測前に進めるステップ数(省略時は100)
+	//  --threads <n>    : PhysXのワーカースレッド数(省略時はハードウェアのスレッド数)
+	//  --profile <name> : ソルバーのプロファイル(default, pgs, tgs, tgs-stable, tgs-mbp, all)
+	//                     複数指定可、省略時はdefault。allを指定するとシーンとプロファイルの全ての組み合わせを計測する
+	//  --format <type>  : 出力形式(text, json, csv)
+	//  --output <path>  : 結果をファイルに書き出す(省略時は標準出力)
+	BenchmarkOptions options;
+	options.warmup_steps = 100;
+	options.steps = 1000;
+	options.thread_cnt = PxMax(thread::hardware_concurrency(), 1u);
+	ReportFormat::Enum format = ReportFormat::eTEXT;
+	const char* output_path = NULL;
+	vector<const BenchmarkScene*> scenes;
+	vector<const SolverProfile*> profiles;
+
+	for (int i = 1; i < argc; i++) {
+		const string kArg = argv[i];
+		if (kArg == "--scene" && i + 1 < argc) {
+			const string kName = argv[++i];
+			size_t s = 0;
+			while (s != kSceneCnt && kName != kScenes[s].name)
+				s++;
+			if (s == kSceneCnt) {
+				cerr << "Unknown scene: " << kName << endl;
+				return 1;
+			}
+			scenes.push_back(&kScenes[s]);
+		}
+		else if (kArg == "--profile" && i + 1 < argc) {
+			const string kName = argv[++i];
+			if (kName == "all") {
+				const vector<SolverProfile> &all_profiles = getSolverProfiles();
+				for (size_t p = 0; p != all_profiles.size(); p++)
+					profiles.push_back(&all_profiles[p]);
+				continue;
+			}
+			const SolverProfile* profile = findSolverProfile(kName);
+			if (!profile) {
+				cerr << "Unknown profile: " << kName << endl;
+				return 1;
+			}
+			profiles.push_back(profile);
+		}
+		else if (kArg == "--steps" && i + 1 < argc) {
+			options.steps = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--warmup" && i + 1 < argc) {
+			options.warmup_steps = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--threads" && i + 1 < argc) {
+			options.thread_cnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--format" && i + 1 < argc) {
+			const string kFormat = argv[++i];
+			format = kFormat == "json" ? ReportFormat::eJSON
+				: kFormat == "csv" ? ReportFormat::eCSV : ReportFormat::eTEXT;
+		}
+		else if (kArg == "--output" && i + 1 < argc) {
+			output_path = argv[++i];
+		}
+	}
+	if (scenes.empty()) {
+		for (size_t s = 0; s != kSceneCnt; s++)
+			scenes.push_back(&kScenes[s]);
+	}
+	if (profiles.empty())
+		profiles.push_back(findSolverProfile("default"));
+
+	initPhysics();
+
+	vector<BenchmarkResult> results;
+	for (size_t s = 0; s != scenes.size(); s++) {
+		for (size_t p = 0; p != profiles.size(); p++) {
+			cerr << "Running " << scenes[s]->name << " (" << profiles[p]->name << ")..." << endl;
+			results.push_back(runBenchmark(*scenes[s], *profiles[p], options));
+		}
+	}
+
+	cleanupPhysics();
+
+	if (output_path) {
+		ofstream file(output_path);
+		if (!file) {
+			cerr << "Failed to open " << output_path << endl;
+			return 1;
+		}
+		writeBenchmarkReport(file, results, format);
+	}
+	else {
+		writeBenchmarkReport(cout, results, format);
+	}
+	return 0;
+}
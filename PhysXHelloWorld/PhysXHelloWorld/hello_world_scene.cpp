@@ -0,0 +1,26 @@
+#include "hello_world_scene.h"
+
+// Dynamic Rigidbodyの作成
+static PxRigidDynamic* createDynamic(PxPhysics &physics, PxScene &scene, const PxTransform& t,
+	const PxGeometry& geometry, PxMaterial& material, PxReal density = 10.0f)
+{
+	PxRigidDynamic* rigid_dynamic
+		= PxCreateDynamic(physics, t, geometry, material, density);
+	scene.addActor(*rigid_dynamic);
+	return rigid_dynamic;
+}
+
+PxRigidDynamic* createHelloWorldScene(PxPhysics &physics, PxScene &scene)
+{
+	// 静摩擦係数、動摩擦係数、反発係数の順
+	PxMaterial* const kMaterial = physics.createMaterial(0.5f, 0.5f, 0.6f);
+
+	// 半径1mの球を高さ10mから落とす
+	PxRigidDynamic* sphere = createDynamic(physics, scene,
+		PxTransform((PxVec3(0.0f, 10.0f, 0.0f))),
+		PxSphereGeometry(1.0f), *kMaterial);
+
+	// materialはshapeが参照しているので、アクターを解放すると一緒に解放されるようにする
+	kMaterial->release();
+	return sphere;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+
+using namespace physx;
+
+// 半径1mの球を高さ10mから落とすシーンを作成し、球を返す
+PxRigidDynamic* createHelloWorldScene(PxPhysics &physics, PxScene &scene);
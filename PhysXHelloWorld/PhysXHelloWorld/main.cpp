@@ -1,5 +1,12 @@
 #include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <sstream>
 #include "PxPhysicsAPI.h"
+#include "hello_world_scene.h"
+#include "../../Common/telemetry_log.h"
 
 using namespace std;
 using namespace physx;
@@ -12,83 +19,229 @@ PxDefaultCpuDispatcher* gDispatcher = NULL;
 PxScene*                gScene = NULL;
 PxPvd*                  gPvd = NULL;
 
-// PhysX̏
+// PhysXのワーカースレッド数(--threadsで変更する)
+PxU32 gWorkerThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
+
+// PVDの接続方法(コマンドライン引数で変更する)
+struct PvdMode {
+	enum Enum {
+		eNONE,    // PVDを使わない(ヘッドレス実行)
+		eSOCKET,  // 起動中のPVDへソケットで送る
+		eFILE     // ファイルに書き出し、後からPVDで開く
+	};
+};
+PvdMode::Enum gPvdMode = PvdMode::eSOCKET;
+string gPvdFilePath;
+
+// ステップごとの球の状態の記録(--telemetryで有効にする)
+TelemetryLog gTelemetry;
+
+// PVDへ送る情報
+PxPvdInstrumentationFlags gPvdFlags = PxPvdInstrumentationFlag::eALL;
+PxPvdSceneFlags gPvdSceneFlags = PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS
+	| PxPvdSceneFlag::eTRANSMIT_CONTACTS | PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES;
+
+// カンマ区切りの名前からPVDへ送る情報を設定する
+//  debug, profile, memory        : PxPvdInstrumentationFlag
+//  contacts, constraints, queries: PxPvdSceneFlag(debugも必要)
+void parsePvdFlags(const string &names)
+{
+	gPvdFlags = PxPvdInstrumentationFlags();
+	gPvdSceneFlags = PxPvdSceneFlags();
+
+	stringstream stream(names);
+	string name;
+	while (getline(stream, name, ',')) {
+		if (name == "debug")
+			gPvdFlags |= PxPvdInstrumentationFlag::eDEBUG;
+		else if (name == "profile")
+			gPvdFlags |= PxPvdInstrumentationFlag::ePROFILE;
+		else if (name == "memory")
+			gPvdFlags |= PxPvdInstrumentationFlag::eMEMORY;
+		else if (name == "contacts")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_CONTACTS;
+		else if (name == "constraints")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS;
+		else if (name == "queries")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES;
+		else
+			cerr << "Unknown PVD flag: " << name << endl;
+	}
+}
+
+// PhysXの初期化
 void initPhysics()
 {
 	gFoundation
 		= PxCreateFoundation(PX_PHYSICS_VERSION, gAllocator, gErrorCallback);
 
-	// PVD̐ݒ
-	gPvd = PxCreatePvd(*gFoundation);
-	PxPvdTransport* transport
-		= PxDefaultPvdSocketTransportCreate("127.0.0.1", 5425, 10);
-	gPvd->connect(*transport, PxPvdInstrumentationFlag::eALL);
+	// PVDの設定(ヘッドレス実行では作成しない)
+	PxPvdTransport* transport = NULL;
+	if (gPvdMode == PvdMode::eSOCKET)
+		transport = PxDefaultPvdSocketTransportCreate("127.0.0.1", 5425, 10);
+	else if (gPvdMode == PvdMode::eFILE)
+		transport = PxDefaultPvdFileTransportCreate(gPvdFilePath.c_str());
+	if (transport) {
+		gPvd = PxCreatePvd(*gFoundation);
+		gPvd->connect(*transport, gPvdFlags);
+	}
 
 	gPhysics = PxCreatePhysics(
 		PX_PHYSICS_VERSION, *gFoundation, PxTolerancesScale(), true, gPvd);
 	PxInitExtensions(*gPhysics, gPvd);
 
-	// Scene̍쐬
+	// Sceneの作成
 	PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
 	sceneDesc.gravity = PxVec3(0.0f, -9.8f, 0.0f);
-	gDispatcher = PxDefaultCpuDispatcherCreate(0);
+	gDispatcher = PxDefaultCpuDispatcherCreate(gWorkerThreadCnt);
 	sceneDesc.cpuDispatcher = gDispatcher;
 	sceneDesc.filterShader = PxDefaultSimulationFilterShader;
+	sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS;  // 動いたアクターを取得する
 	gScene = gPhysics->createScene(sceneDesc);
 
-	// PVD̐ݒ
+	// PVDの設定
 	PxPvdSceneClient* pvdClient = gScene->getScenePvdClient();
 	if (pvdClient)
 	{
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS, true);
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONTACTS, true);
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES, true);
+		pvdClient->setScenePvdFlags(gPvdSceneFlags);
 	}
 }
 
-// Dynamic Rigidbody̍쐬
-PxRigidDynamic* createDynamic(const PxTransform& t,
-	const PxGeometry& geometry, PxMaterial& material, PxReal density = 10.0f)
+// PhysXの終了処理
+// PVDをファイルに書き出している場合は、transportの解放で書き出しが完了する
+void cleanupPhysics()
 {
-	PxRigidDynamic* rigid_dynamic
-		= PxCreateDynamic(*gPhysics, t, geometry, material, density);
-	gScene->addActor(*rigid_dynamic);
-	return rigid_dynamic;
+	gScene->release();
+	gDispatcher->release();
+	PxCloseExtensions();
+	gPhysics->release();
+	if (gPvd) {
+		PxPvdTransport* transport = gPvd->getTransport();
+		gPvd->release();
+		transport->release();
+	}
+	gFoundation->release();
 }
 
-// V~[VXebvi߂
-void stepPhysics()
+// シミュレーションステップを開始する(完了を待たずに戻る)
+// endStepPhysicsまでの間、アクターの読み出しはステップ開始前の状態を返す
+void beginStepPhysics()
 {
 	const PxReal kElapsedTime = 1.0f / 60.0f; // 60Hz
 	gScene->simulate(kElapsedTime);
+}
+
+// シミュレーションステップの完了をポーリングして待つ
+void endStepPhysics()
+{
+	while (!gScene->fetchResults(false))
+		this_thread::yield();
+}
+
+// シミュレーションステップを進める
+void stepPhysics()
+{
+	beginStepPhysics();
 	gScene->fetchResults(true);
 }
 
-int main(void)
+// ステップstepを進めた後の球の位置を表示する
+void printPosition(PxU32 step, const PxVec3 &p)
 {
+	cout << "Step: " << step <<
+		", Position: (" << p.x << ", " << p.y << ", " << p.z << ")\n";
+}
+
+int main(int argc, char* argv[])
+{
+	// コマンドライン引数
+	//  --threads <n>       : PhysXのワーカースレッド数(省略時はハードウェアのスレッド数)
+	//  --headless          : PVDを使わずに実行し、終了時に入力を待たない
+	//  --pvd-file <path>   : PVDのデータをファイルに書き出す
+	//  --pvd-flags <names> : PVDへ送る情報(debug,profile,memory,contacts,constraints,queries)
+	//  --telemetry <path>  : ステップごとの位置を表示せず、姿勢と速度をログに書き出す(.csvならCSV、それ以外はバイナリ)
+	const char* telemetry_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		const string kArg = argv[i];
+		if (kArg == "--threads" && i + 1 < argc) {
+			gWorkerThreadCnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--headless") {
+			gPvdMode = PvdMode::eNONE;
+		}
+		else if (kArg == "--pvd-file" && i + 1 < argc) {
+			gPvdMode = PvdMode::eFILE;
+			gPvdFilePath = argv[++i];
+		}
+		else if (kArg == "--pvd-flags" && i + 1 < argc) {
+			parsePvdFlags(argv[++i]);
+		}
+		else if (kArg == "--telemetry" && i + 1 < argc) {
+			telemetry_path = argv[++i];
+		}
+	}
+
 	initPhysics();
+	if (telemetry_path) {
+		const string kPath = telemetry_path;
+		const bool kCsv = kPath.size() >= 4 && kPath.compare(kPath.size() - 4, 4, ".csv") == 0;
+		if (!gTelemetry.open(kPath, kCsv ? TelemetryFormat::eCSV : TelemetryFormat::eBINARY))
+			cerr << "Failed to open " << kPath << endl;
+	}
 	cout << "PhysXHelloWorld" << endl;
 	cout << "Start simulation" << endl;
 
 	const PxU32 kMaxSimulationStep = 100;
 
-	// ÖCWACWAW̏
-	PxMaterial* const kMaterial = gPhysics->createMaterial(0.5f, 0.5f, 0.6f);
-
-	// a1m̋10m痎Ƃ
-	PxRigidDynamic* sphere = createDynamic(
-		PxTransform((PxVec3(0.0f, 10.0f, 0.0f))),
-		PxSphereGeometry(1.0f), *kMaterial);
+	// 半径1mの球を高さ10mから落とす
+	PxRigidDynamic* sphere = createHelloWorldScene(*gPhysics, *gScene);
 
+	// 位置の表示は次のステップのシミュレーションと並行して行う
+	// テレメトリと同じく、ステップiを進めた後の位置を"Step: i"として表示する
+	// 位置はそのステップで球が動いた場合のみ読み出し、眠った後は表示しない
+	// 表示はステップごとにflushせず、--telemetryではログの書き出しスレッドに任せる
+	bool moved = false;
+	PxVec3 p(0.0f);
+	const chrono::steady_clock::time_point kLoopStart = chrono::steady_clock::now();
 	for (PxU32 i = 0; i != kMaxSimulationStep; i++) {
-		PxVec3 p = sphere->getGlobalPose().p;
-		cout << "Step: " << i <<
-			", Position: (" << p.x << ", " << p.y << ", " << p.z << ")" << endl;
-		stepPhysics();
+		beginStepPhysics();
+		if (moved && !gTelemetry.isOpen())
+			printPosition(i - 1, p);
+		endStepPhysics();
+
+		// 全てのアクターを調べずに、このステップで動いたアクターのみを調べる
+		PxU32 active_cnt = 0;
+		PxActor** active_actors = gScene->getActiveActors(active_cnt);
+		moved = false;
+		for (PxU32 a = 0; a != active_cnt; a++) {
+			if (active_actors[a] == sphere) {
+				moved = true;
+				p = sphere->getGlobalPose().p;
+				if (gTelemetry.isOpen())
+					gTelemetry.push(i, 0, *sphere);
+			}
+		}
 	}
+	if (moved && !gTelemetry.isOpen())
+		printPosition(kMaxSimulationStep - 1, p);
+	const double kLoopTime
+		= chrono::duration<double>(chrono::steady_clock::now() - kLoopStart).count();
 
 	cout << "End simulation" << endl;
-	int tmp;
-	cin >> tmp;
+	if (gTelemetry.isOpen()) {
+		gTelemetry.close();
+		cout << "Telemetry: " << gTelemetry.getWrittenCount() << " records (" << gTelemetry.getDroppedCount()
+			<< " dropped), written to " << telemetry_path << endl;
+	}
+	const char* kPvdModeNames[] = { "none", "socket", "file" };
+	cout << "Average step time: " << kLoopTime * 1000.0 / kMaxSimulationStep << " ms"
+		<< " (PVD: " << kPvdModeNames[gPvdMode] << ")" << endl;
+	cleanupPhysics();
+
+	// ヘッドレス実行では入力を待たずに終了する
+	if (gPvdMode != PvdMode::eNONE) {
+		int tmp;
+		cin >> tmp;
+	}
 	return 0;
 }
\ No newline at end of file
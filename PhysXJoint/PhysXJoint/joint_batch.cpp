@@ -0,0 +1,118 @@
+#include "joint_batch.h"
+#include "scene_context.h"
+#include <fstream>
+#include <thread>
+#include <atomic>
+
+
+using namespace std;
+
+vector<JointVariant> createJointVariants(PxU32 variant_cnt)
+{
+	const PxReal kBreakForces[] = { 25.0f, 50.0f, 100.0f, 200.0f, 400.0f, 800.0f };
+	const PxReal kBreakTorques[] = { 25.0f, 50.0f, 100.0f, 200.0f, 400.0f, 800.0f };
+	const PxReal kFrictions[] = { 0.2f, 0.5f, 0.8f };
+	const PxReal kRestitutions[] = { 0.2f, 0.6f, 0.9f };
+	const PxReal kHeights[] = { 1.0f, 2.0f, 3.0f, 5.0f, 8.0f };
+
+	vector<JointVariant> variants(variant_cnt);
+	for (PxU32 i = 0; i != variant_cnt; i++) {
+		// iを各パラメータの添字に分解する(破断力が最も速く変わる)
+		PxU32 index = i;
+		JointVariant &variant = variants[i];
+		variant.id = i;
+		variant.desc.break_force = kBreakForces[index % 6];
+		index /= 6;
+		variant.desc.break_torque = kBreakTorques[index % 6];
+		index /= 6;
+		variant.desc.static_friction = variant.desc.dynamic_friction = kFrictions[index % 3];
+		index /= 3;
+		variant.desc.restitution = kRestitutions[index % 3];
+		index /= 3;
+		variant.desc.height = kHeights[index % 5];
+	}
+	return variants;
+}
+
+vector<JointResult> runJointBatch(PxPhysics &physics, const vector<JointVariant> &variants,
+	PxU32 thread_cnt, PxU32 step_cnt)
+{
+	const PxU32 kEventCapacity = 16;  // 記録するのは1つのjointの破断のみ
+
+	// ワーカースレッドを持たないディスパッチャを共有する(タスクはsimulateを呼んだスレッドで実行される)
+	PxDefaultCpuDispatcher* dispatcher = PxDefaultCpuDispatcherCreate(0);
+
+	vector<JointResult> results(variants.size());
+	atomic<size_t> next_variant(0);
+	auto work = [&]() {
+		while (true) {
+			const size_t kIndex = next_variant++;
+			if (kIndex >= variants.size())
+				break;
+
+			// 破断はイベントで受け取る(jointごとのフラグを毎ステップ読まない)
+			SimulationEventRecorder recorder(kEventCapacity);
+			SceneContext context(physics, *dispatcher, PxPvdSceneFlags(), &recorder);
+			PxFixedJoint* joint = createJointScene(physics, context.getScene(), variants[kIndex].desc);
+			PxRigidActor *actor0, *actor1;
+			joint->getActors(actor0, actor1);
+
+			JointResult &result = results[kIndex];
+			result.break_step = JointResult::kNotBroken;
+			for (PxU32 step = 0; step != step_cnt; step++) {
+				recorder.setStep(step);
+				context.step();
+			}
+			SimulationEvent event;
+			while (result.break_step == JointResult::kNotBroken && recorder.pop(event)) {
+				if (event.type == SimulationEventType::eCONSTRAINT_BREAK && event.joint == joint)
+					result.break_step = (PxI32)event.step;
+			}
+			result.poses[0] = actor0->getGlobalPose();
+			result.poses[1] = actor1->getGlobalPose();
+
+			// 次のバリエーションのためにjointを解放する(アクターはcontextが解放する)
+			joint->release();
+		}
+	};
+
+	vector<thread> threads;
+	for (PxU32 i = 1; i < thread_cnt; i++)
+		threads.push_back(thread(work));
+	work();  // 呼び出したスレッドも1つのワーカーとして使う
+	for (size_t i = 0; i != threads.size(); i++)
+		threads[i].join();
+
+	dispatcher->release();
+	return results;
+}
+
+bool writeJointResults(const string &file_path, const vector<JointVariant> &variants,
+	const vector<JointResult> &results)
+{
+	ofstream file(file_path);
+	if (!file)
+		return false;
+
+	file << "id,break_force,break_torque,static_friction,dynamic_friction,restitution,height,break_step";
+	for (int i = 0; i != 2; i++) {
+		file << ",box" << i << "_px,box" << i << "_py,box" << i << "_pz"
+			<< ",box" << i << "_qx,box" << i << "_qy,box" << i << "_qz,box" << i << "_qw";
+	}
+	file << "\n";
+
+	for (size_t i = 0; i != variants.size() && i != results.size(); i++) {
+		const JointSceneDesc &desc = variants[i].desc;
+		const JointResult &result = results[i];
+		file << variants[i].id << "," << desc.break_force << "," << desc.break_torque << ","
+			<< desc.static_friction << "," << desc.dynamic_friction << "," << desc.restitution << ","
+			<< desc.height << "," << result.break_step;
+		for (int p = 0; p != 2; p++) {
+			const PxTransform &pose = result.poses[p];
+			file << "," << pose.p.x << "," << pose.p.y << "," << pose.p.z
+				<< "," << pose.q.x << "," << pose.q.y << "," << pose.q.z << "," << pose.q.w;
+		}
+		file << "\n";
+	}
+	return (bool)file;
+}
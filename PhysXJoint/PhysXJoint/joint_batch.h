@@ -0,0 +1,36 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "joint_scene.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace physx;
+
+// バッチ実行する1つのバリエーション
+struct JointVariant {
+	PxU32 id;
+	JointSceneDesc desc;
+};
+
+// 1つのバリエーションの実行結果
+struct JointResult {
+	static const PxI32 kNotBroken = -1;
+
+	PxI32 break_step;      // ジョイントが破断したステップ(破断しなかった場合はkNotBroken)
+	PxTransform poses[2];  // 最後のステップの後の2つの箱の姿勢
+};
+
+// 破断力・破断トルク・material・高さの組み合わせを格子状に並べたバリエーションをvariant_cnt個作る
+// 組み合わせの数より多い場合は先頭から繰り返す
+vector<JointVariant> createJointVariants(PxU32 variant_cnt);
+
+// バリエーションごとにPxSceneを作成してstep_cntステップ進め、結果をvariantsと同じ順に返す
+// 全てのシーンは同じPxPhysicsの下に作り、thread_cnt個のスレッドが空いたものから順に受け持つ
+// シーンのタスクは受け持ったスレッドで実行する(スレッド間の負荷はシーン単位で分散する)
+vector<JointResult> runJointBatch(PxPhysics &physics, const vector<JointVariant> &variants,
+	PxU32 thread_cnt, PxU32 step_cnt);
+
+// 結果を1つのCSVファイルに書き出す
+bool writeJointResults(const string &file_path, const vector<JointVariant> &variants,
+	const vector<JointResult> &results);
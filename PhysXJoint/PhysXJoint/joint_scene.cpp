@@ -0,0 +1,69 @@
+#include "joint_scene.h"
+
+// Dynamic Rigidbodyの作成
+static PxRigidDynamic* createDynamic(PxPhysics &physics, PxScene &scene, const PxTransform& t,
+	const PxGeometry& geometry, PxMaterial& material)
+{
+	const PxReal kDensity = 10.0f;
+	PxRigidDynamic* dynamic
+		= PxCreateDynamic(physics, t, geometry, material, kDensity);
+	scene.addActor(*dynamic);
+	return dynamic;
+}
+
+// Static Rigidbodyの作成
+static PxRigidStatic* createStatic(PxPhysics &physics, PxScene &scene, const PxTransform& t,
+	const PxGeometry& geometry, PxMaterial& material)
+{
+	PxRigidStatic* static_actor = PxCreateStatic(physics, t, geometry, material);
+	scene.addActor(*static_actor);
+	return static_actor;
+}
+
+PxFixedJoint* createJointScene(PxPhysics &physics, PxScene &scene, const JointSceneDesc &desc)
+{
+	// 静摩擦係数、動摩擦係数、反発係数の順
+	PxMaterial* material = physics.createMaterial(desc.static_friction, desc.dynamic_friction, desc.restitution);
+
+	// base plate(12m x 0.2m x 10m)
+	const PxVec3 kPlateHalfExtents(6.0f, 0.1f, 5.0f);
+	createStatic(physics, scene,
+		PxTransform(PxVec3(0.0f, 0.0f, 0.0f)),
+		PxBoxGeometry(kPlateHalfExtents.x, kPlateHalfExtents.y, kPlateHalfExtents.z),
+		*material);
+
+
+	// 2つの剛体を作成
+	const PxReal kHeight = desc.height;
+	PxBoxGeometry box0(PxVec3(1.0f, 0.1f, 0.2f));
+	PxBoxGeometry box1(PxVec3(0.1f, 0.4f, 0.2f));
+
+	PxRigidDynamic* actor0 =
+		createDynamic(physics, scene,
+			PxTransform((PxVec3(0.0f, kHeight, 0.0f))),
+			box0,
+			*material);
+	PxRigidDynamic* actor1 =
+		createDynamic(physics, scene,
+			PxTransform((PxVec3(0.9f, kHeight + 0.5f, 0.0f))),
+			box1,
+			*material);
+
+	// ジョイントにより剛体を連結
+	PxVec3 jointPos = PxVec3(0.9f, kHeight + 0.1f, 0.0f);
+
+	PxFixedJoint* joint = 
+		PxFixedJointCreate(physics,
+		actor0,
+		PxTransform(jointPos - actor0->getGlobalPose().p),
+		actor1,
+		PxTransform(jointPos - actor1->getGlobalPose().p)
+	);
+
+	// ジョイントの破断設定
+	joint->setBreakForce(desc.break_force, desc.break_torque);
+
+	// materialはshapeが参照しているので、アクターを解放すると一緒に解放されるようにする
+	material->release();
+	return joint;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+
+using namespace physx;
+
+// シーンのパラメータ(既定値は元のサンプルと同じ)
+struct JointSceneDesc {
+	PxReal break_force;       // ジョイントが破断する力
+	PxReal break_torque;      // ジョイントが破断するトルク
+	PxReal static_friction;   // 静摩擦係数
+	PxReal dynamic_friction;  // 動摩擦係数
+	PxReal restitution;       // 反発係数
+	PxReal height;            // 箱を落とす高さ
+
+	JointSceneDesc()
+		: break_force(100.0f), break_torque(100.0f),
+		static_friction(0.5f), dynamic_friction(0.5f), restitution(0.6f), height(5.0f) {}
+};
+
+// 床の上に、破断するFixed Jointで連結した2つの箱を落とすシーンを作成する
+// 連結された2つの箱はjointのgetActorsで取得できる
+PxFixedJoint* createJointScene(PxPhysics &physics, PxScene &scene, const JointSceneDesc &desc = JointSceneDesc());
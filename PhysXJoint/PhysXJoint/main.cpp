@@ -1,5 +1,16 @@
 #include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
 #include "PxPhysicsAPI.h"
+#include "joint_scene.h"
+#include "scene_context.h"
+#include "joint_batch.h"
+#include "../../Common/telemetry_log.h"
 
 using namespace std;
 using namespace physx;
@@ -9,133 +20,264 @@ PxDefaultErrorCallback  gErrorCallback;
 PxFoundation*           gFoundation = NULL;
 PxPhysics*              gPhysics = NULL;
 PxDefaultCpuDispatcher* gDispatcher = NULL;
-PxScene*                gScene = NULL;
+SceneContext*           gSceneContext = NULL;
 PxPvd*                  gPvd = NULL;
 
-// PhysX̏
+// gSceneContextのjointの破断の記録
+SimulationEventRecorder gEventRecorder(16);
+
+// ステップごとの動的アクターの状態の記録(--telemetryで有効にする)
+TelemetryLog gTelemetry;
+
+// PhysXのワーカースレッド数(--threadsで変更する)
+PxU32 gWorkerThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
+
+// PVDの接続方法(コマンドライン引数で変更する)
+struct PvdMode {
+	enum Enum {
+		eNONE,    // PVDを使わない(ヘッドレス実行)
+		eSOCKET,  // 起動中のPVDへソケットで送る
+		eFILE     // ファイルに書き出し、後からPVDで開く
+	};
+};
+PvdMode::Enum gPvdMode = PvdMode::eSOCKET;
+string gPvdFilePath;
+
+// PVDへ送る情報
+PxPvdInstrumentationFlags gPvdFlags = PxPvdInstrumentationFlag::eALL;
+PxPvdSceneFlags gPvdSceneFlags = PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS
+	| PxPvdSceneFlag::eTRANSMIT_CONTACTS | PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES;
+
+// カンマ区切りの名前からPVDへ送る情報を設定する
+//  debug, profile, memory        : PxPvdInstrumentationFlag
+//  contacts, constraints, queries: PxPvdSceneFlag(debugも必要)
+void parsePvdFlags(const string &names)
+{
+	gPvdFlags = PxPvdInstrumentationFlags();
+	gPvdSceneFlags = PxPvdSceneFlags();
+
+	stringstream stream(names);
+	string name;
+	while (getline(stream, name, ',')) {
+		if (name == "debug")
+			gPvdFlags |= PxPvdInstrumentationFlag::eDEBUG;
+		else if (name == "profile")
+			gPvdFlags |= PxPvdInstrumentationFlag::ePROFILE;
+		else if (name == "memory")
+			gPvdFlags |= PxPvdInstrumentationFlag::eMEMORY;
+		else if (name == "contacts")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_CONTACTS;
+		else if (name == "constraints")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS;
+		else if (name == "queries")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES;
+		else
+			cerr << "Unknown PVD flag: " << name << endl;
+	}
+}
+
+// PhysXの初期化
 void initPhysics()
 {
 	gFoundation =
 		PxCreateFoundation(PX_PHYSICS_VERSION, gAllocator, gErrorCallback);
 
-	// PVD̐ݒ
-	gPvd = PxCreatePvd(*gFoundation);
-	PxPvdTransport* transport =
-		PxDefaultPvdSocketTransportCreate("127.0.0.1", 5425, 10);
-	gPvd->connect(*transport, PxPvdInstrumentationFlag::eALL);
+	// PVDの設定(ヘッドレス実行では作成しない)
+	PxPvdTransport* transport = NULL;
+	if (gPvdMode == PvdMode::eSOCKET)
+		transport = PxDefaultPvdSocketTransportCreate("127.0.0.1", 5425, 10);
+	else if (gPvdMode == PvdMode::eFILE)
+		transport = PxDefaultPvdFileTransportCreate(gPvdFilePath.c_str());
+	if (transport) {
+		gPvd = PxCreatePvd(*gFoundation);
+		gPvd->connect(*transport, gPvdFlags);
+	}
 
 	gPhysics = PxCreatePhysics(
 		PX_PHYSICS_VERSION, *gFoundation, PxTolerancesScale(), true, gPvd);
 
-	// Scene̍쐬
-	PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
-	sceneDesc.gravity = PxVec3(0.0f, -9.81f, 0.0f);
-	gDispatcher = PxDefaultCpuDispatcherCreate(1);
-	sceneDesc.cpuDispatcher = gDispatcher;
-	sceneDesc.filterShader = PxDefaultSimulationFilterShader;
-	gScene = gPhysics->createScene(sceneDesc);
-
-	// PVD̐ݒ
-	PxPvdSceneClient* pvdClient = gScene->getScenePvdClient();
-	if (pvdClient)
-	{
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS, true);
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONTACTS, true);
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES, true);
-	}
+	// Sceneの作成
+	gDispatcher = PxDefaultCpuDispatcherCreate(gWorkerThreadCnt);
+	gSceneContext = new SceneContext(*gPhysics, *gDispatcher, gPvdSceneFlags, &gEventRecorder);
 	PxInitExtensions(*gPhysics, gPvd);
 }
 
-// Dynamic Rigidbody̍쐬
-PxRigidDynamic* createDynamic(const PxTransform& t,
-	const PxGeometry& geometry, PxMaterial& material)
+// PhysXの終了処理
+// PVDをファイルに書き出している場合は、transportの解放で書き出しが完了する
+void cleanupPhysics()
 {
-	const PxReal kDensity = 10.0f;
-	PxRigidDynamic* dynamic
-		= PxCreateDynamic(*gPhysics, t, geometry, material, kDensity);
-	gScene->addActor(*dynamic);
-	return dynamic;
+	delete gSceneContext;
+	gDispatcher->release();
+	PxCloseExtensions();
+	gPhysics->release();
+	if (gPvd) {
+		PxPvdTransport* transport = gPvd->getTransport();
+		gPvd->release();
+		transport->release();
+	}
+	gFoundation->release();
 }
 
-// Static Rigidbody̍쐬
-PxRigidStatic* createStatic(const PxTransform& t, const PxGeometry& geometry, PxMaterial& material)
+// variant_cnt個のバリエーションをスレッド数を変えながらバッチ実行し、スループットを計測する
+void benchmarkBatch(PxU32 variant_cnt, PxU32 step_cnt)
 {
-	PxRigidStatic* static_actor = PxCreateStatic(*gPhysics, t, geometry, material);
-	gScene->addActor(*static_actor);
-	return static_actor;
-}
+	const vector<JointVariant> kVariants = createJointVariants(variant_cnt);
+	const PxU32 kMaxThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
 
+	cout << "Batch benchmark (" << variant_cnt << " scenes, " << step_cnt << " steps)" << endl;
+	cout << "threads\ttime[s]\tscenes/s\tspeedup" << endl;
+	double base_rate = 0.0;
+	for (PxU32 thread_cnt = 1; ; thread_cnt = PxMin(thread_cnt * 2, kMaxThreadCnt)) {
+		const chrono::steady_clock::time_point kStart = chrono::steady_clock::now();
+		runJointBatch(*gPhysics, kVariants, thread_cnt, step_cnt);
+		const double kSeconds = chrono::duration<double>(chrono::steady_clock::now() - kStart).count();
+		const double kRate = variant_cnt / kSeconds;
+		if (thread_cnt == 1)
+			base_rate = kRate;
 
-// V~[VXebvi߂
-void stepPhysics()
-{
-	const PxReal kElapsedTime = 1.0f / 60.0f; // 60Hz
-	gScene->simulate(kElapsedTime);
-	gScene->fetchResults(true);
+		cout << thread_cnt << "\t" << fixed << setprecision(3) << kSeconds << "\t"
+			<< setprecision(1) << kRate << "\t" << setprecision(2) << kRate / base_rate << endl;
+		if (thread_cnt == kMaxThreadCnt)
+			break;
+	}
 }
 
-int main(void)
+int main(int argc, char* argv[])
 {
-	initPhysics();
-	cout << "PhysXHelloWorld" << endl;
-	cout << "Start simulation" << endl;
-
-	const PxU32 kMaxSimulationStep = 100;
-
-	// ÖCWACWAW̏
-	PxMaterial* material = gPhysics->createMaterial(0.5f, 0.5f, 0.6f);
-
-	// base plate(12m x 0.2m x 10m)
-	const PxVec3 kPlateHalfExtents(6.0f, 0.1f, 5.0f);
-	createStatic(
-		PxTransform(PxVec3(0.0f, 0.0f, 0.0f)),
-		PxBoxGeometry(kPlateHalfExtents.x, kPlateHalfExtents.y, kPlateHalfExtents.z),
-		*material);
-
+	// コマンドライン引数
+	//  --threads <n>       : PhysXのワーカースレッド数(省略時はハードウェアのスレッド数)
+	//  --headless          : PVDを使わずに実行し、終了時に入力を待たない
+	//  --pvd-file <path>   : PVDのデータをファイルに書き出す
+	//  --pvd-flags <names> : PVDへ送る情報(debug,profile,memory,contacts,constraints,queries)
+	//  --batch <n>         : 破断力などを変えたn個のシーンを--threadsのスレッド数で並行して実行し、結果をCSVに書き出す
+	//  --csv <path>        : --batchの結果の書き出し先(省略時はjoint_batch.csv)
+	//  --bench-batch <n>   : n個のシーンのバッチ実行のスループットをスレッド数ごとに計測する
+	//  --batch, --bench-batchではPVDを使わない
+	//  --telemetry <path>  : 動的アクターの姿勢と速度をステップごとにログに書き出す(.csvならCSV、それ以外はバイナリ)
+	const char* telemetry_path = NULL;
+	PxU32 batch_variant_cnt = 0;
+	PxU32 batch_bench_variant_cnt = 0;
+	string batch_csv_path = "joint_batch.csv";
+	for (int i = 1; i < argc; i++) {
+		const string kArg = argv[i];
+		if (kArg == "--threads" && i + 1 < argc) {
+			gWorkerThreadCnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--headless") {
+			gPvdMode = PvdMode::eNONE;
+		}
+		else if (kArg == "--pvd-file" && i + 1 < argc) {
+			gPvdMode = PvdMode::eFILE;
+			gPvdFilePath = argv[++i];
+		}
+		else if (kArg == "--pvd-flags" && i + 1 < argc) {
+			parsePvdFlags(argv[++i]);
+		}
+		else if (kArg == "--batch" && i + 1 < argc) {
+			batch_variant_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--csv" && i + 1 < argc) {
+			batch_csv_path = argv[++i];
+		}
+		else if (kArg == "--bench-batch" && i + 1 < argc) {
+			batch_bench_variant_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--telemetry" && i + 1 < argc) {
+			telemetry_path = argv[++i];
+		}
+	}
 
-	// 2̍̂쐬
-	const PxReal kHeight = 5.0f;
-	PxBoxGeometry box0(PxVec3(1.0f, 0.1f, 0.2f));
-	PxBoxGeometry box1(PxVec3(0.1f, 0.4f, 0.2f));
+	const PxU32 kMaxSimulationStep = 500;
 
-	PxRigidDynamic* actor0 =
-		createDynamic(
-			PxTransform((PxVec3(0.0f, kHeight, 0.0f))),
-			box0,
-			*material);
-	PxRigidDynamic* actor1 =
-		createDynamic(
-			PxTransform((PxVec3(0.9f, kHeight + 0.5f, 0.0f))),
-			box1,
-			*material);
+	// バッチ実行
+	if (batch_variant_cnt || batch_bench_variant_cnt) {
+		gPvdMode = PvdMode::eNONE;
+		initPhysics();
+		if (batch_bench_variant_cnt) {
+			benchmarkBatch(batch_bench_variant_cnt, kMaxSimulationStep);
+		}
+		else {
+			const vector<JointVariant> kVariants = createJointVariants(batch_variant_cnt);
+			const PxU32 kThreadCnt = PxMax(gWorkerThreadCnt, 1u);
+			const chrono::steady_clock::time_point kStart = chrono::steady_clock::now();
+			const vector<JointResult> kResults = runJointBatch(*gPhysics, kVariants, kThreadCnt, kMaxSimulationStep);
+			const double kSeconds = chrono::duration<double>(chrono::steady_clock::now() - kStart).count();
 
-	// WCgɂ荄̂A
-	PxVec3 jointPos = PxVec3(0.9f, kHeight + 0.1f, 0.0f);
+			size_t broken_cnt = 0;
+			for (size_t i = 0; i != kResults.size(); i++) {
+				if (kResults[i].break_step != JointResult::kNotBroken)
+					broken_cnt++;
+			}
+			cout << kVariants.size() << " scenes, " << broken_cnt << " broken, " << kThreadCnt << " threads, "
+				<< kSeconds << " s (" << kVariants.size() / kSeconds << " scenes/s)" << endl;
+			if (!writeJointResults(batch_csv_path, kVariants, kResults))
+				cerr << "Failed to write " << batch_csv_path << endl;
+		}
+		cleanupPhysics();
+		return 0;
+	}
 
-	PxFixedJoint* joint = 
-		PxFixedJointCreate(*gPhysics,
-		actor0,
-		PxTransform(jointPos - actor0->getGlobalPose().p),
-		actor1,
-		PxTransform(jointPos - actor1->getGlobalPose().p)
-	);
+	initPhysics();
+	cout << "PhysXHelloWorld" << endl;
+	cout << "Start simulation" << endl;
 
-	// WCg̔jfݒ
-	const PxReal kBreakForce = 100.0f;
-	const PxReal kBreakTorque = 100.0f;
-	joint->setBreakForce(kBreakForce, kBreakTorque);
+	// 連結した2つの箱を落とす
+	createJointScene(*gPhysics, gSceneContext->getScene());
 
+	// ログのアクターの番号は、シーンの動的アクターの順番
+	vector<PxRigidDynamic*> dynamic_actors;
+	if (telemetry_path) {
+		const string kPath = telemetry_path;
+		const bool kCsv = kPath.size() >= 4 && kPath.compare(kPath.size() - 4, 4, ".csv") == 0;
+		if (gTelemetry.open(kPath, kCsv ? TelemetryFormat::eCSV : TelemetryFormat::eBINARY)) {
+			PxScene &scene = gSceneContext->getScene();
+			vector<PxActor*> actors(scene.getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC));
+			scene.getActors(PxActorTypeFlag::eRIGID_DYNAMIC, actors.data(), (PxU32)actors.size());
+			for (size_t a = 0; a != actors.size(); a++)
+				dynamic_actors.push_back(actors[a]->is<PxRigidDynamic>());
+		}
+		else {
+			cerr << "Failed to open " << kPath << endl;
+		}
+	}
 
 	// simulation loop
-	for (PxU32 i = 0; i != 500; i++)
+	// 進捗とjointの破断の表示はステップごとにflushしない
+	const chrono::steady_clock::time_point kLoopStart = chrono::steady_clock::now();
+	for (PxU32 i = 0; i != kMaxSimulationStep; i++)
 	{
+		gEventRecorder.setStep(i);
+		gSceneContext->beginStep();
 		if (i % 100 == 0)
-			cout << "Simulation step: " << i << endl;
-		stepPhysics();
+			cout << "Simulation step: " << i << "\n";
+		gSceneContext->endStep();
+		for (size_t a = 0; a != dynamic_actors.size(); a++)
+			gTelemetry.push(i, (PxU32)a, *dynamic_actors[a]);
+
+		SimulationEvent event;
+		while (gEventRecorder.pop(event)) {
+			if (event.type == SimulationEventType::eCONSTRAINT_BREAK)
+				cout << "Joint broken: step " << event.step << "\n";
+		}
 	}
+	const double kLoopTime
+		= chrono::duration<double>(chrono::steady_clock::now() - kLoopStart).count();
 
 	cout << "End simulation" << endl;
-	int tmp;
-	cin >> tmp;
+	if (gTelemetry.isOpen()) {
+		gTelemetry.close();
+		cout << "Telemetry: " << gTelemetry.getWrittenCount() << " records (" << gTelemetry.getDroppedCount()
+			<< " dropped), written to " << telemetry_path << endl;
+	}
+	const char* kPvdModeNames[] = { "none", "socket", "file" };
+	cout << "Average step time: " << kLoopTime * 1000.0 / kMaxSimulationStep << " ms"
+		<< " (PVD: " << kPvdModeNames[gPvdMode] << ")" << endl;
+	cleanupPhysics();
+
+	// ヘッドレス実行では入力を待たずに終了する
+	if (gPvdMode != PvdMode::eNONE) {
+		int tmp;
+		cin >> tmp;
+	}
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "scene_context.h"
+#include <thread>
+#include <vector>
+
+
+using namespace std;
+
+const PxReal SceneContext::kElapsedTime = 1.0f / 60.0f;
+
+SceneContext::SceneContext(PxPhysics &physics, PxCpuDispatcher &dispatcher, PxPvdSceneFlags pvd_scene_flags,
+	PxSimulationEventCallback* event_callback)
+	: scene_(NULL), step_cnt_(0)
+{
+	PxSceneDesc sceneDesc(physics.getTolerancesScale());
+	sceneDesc.gravity = PxVec3(0.0f, -9.81f, 0.0f);
+	sceneDesc.cpuDispatcher = &dispatcher;
+	sceneDesc.filterShader = contactReportFilterShader;  // 購読したペアのみ接触を報告する
+	sceneDesc.simulationEventCallback = event_callback;
+	scene_ = physics.createScene(sceneDesc);
+
+	// PVDの設定
+	PxPvdSceneClient* pvdClient = scene_->getScenePvdClient();
+	if (pvdClient)
+	{
+		pvdClient->setScenePvdFlags(pvd_scene_flags);
+	}
+}
+
+// jointは解放しないので、必要なら呼び出し側で先に解放する
+SceneContext::~SceneContext()
+{
+	const PxActorTypeFlags kTypes = PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
+	vector<PxActor*> actors(scene_->getNbActors(kTypes));
+	if (!actors.empty())
+		scene_->getActors(kTypes, actors.data(), (PxU32)actors.size());
+	for (size_t i = 0; i != actors.size(); i++)
+		actors[i]->release();
+	scene_->release();
+}
+
+void SceneContext::beginStep()
+{
+	scene_->simulate(kElapsedTime);
+}
+
+void SceneContext::endStep()
+{
+	while (!scene_->fetchResults(false))
+		this_thread::yield();
+	step_cnt_++;
+}
+
+void SceneContext::step()
+{
+	scene_->simulate(kElapsedTime);
+	scene_->fetchResults(true);
+	step_cnt_++;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "../../Common/simulation_events.h"
+
+using namespace physx;
+
+// 1つのPxSceneと、そのシミュレーションの進め方
+// 1つのPxPhysicsの下に複数作成でき、それぞれ別のスレッドから並行してステップを進められる
+class SceneContext {
+public:
+	// dispatcher: 複数のSceneContextで共有してよい
+	// pvd_scene_flags: PVDに接続している場合に送る情報
+	// event_callback: jointの破断などを受け取るコールバック(fetchResultsを呼んだスレッドで呼ばれる)
+	SceneContext(PxPhysics &physics, PxCpuDispatcher &dispatcher, PxPvdSceneFlags pvd_scene_flags = PxPvdSceneFlags(),
+		PxSimulationEventCallback* event_callback = NULL);
+	~SceneContext();  // シーンに残っているアクターも解放する(jointは解放しない)
+
+	SceneContext(const SceneContext&) = delete;
+	SceneContext& operator=(const SceneContext&) = delete;
+
+	PxScene& getScene() { return *scene_; }
+	PxU32 getStepCount() const { return step_cnt_; }
+
+	// シミュレーションステップを開始する(完了を待たずに戻る)
+	// endStepまでの間、アクターの読み出しはステップ開始前の状態を返す
+	void beginStep();
+
+	// シミュレーションステップの完了をポーリングして待つ
+	void endStep();
+
+	// シミュレーションステップを進める
+	void step();
+
+private:
+	static const PxReal kElapsedTime;  // 1ステップの時間(60Hz)
+
+	PxScene* scene_;
+	PxU32 step_cnt_;
+};
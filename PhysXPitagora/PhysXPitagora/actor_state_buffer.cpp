@@ -0,0 +1,173 @@
+#include "actor_state_buffer.h"
+
+
+using namespace std;
+
+ActorStateBuffer::ActorStateBuffer()
+	: scene_(NULL)
+{
+}
+
+ActorStateBuffer::~ActorStateBuffer()
+{
+	end();
+}
+
+void ActorStateBuffer::begin(PxScene &scene)
+{
+	end();
+	scene_ = &scene;
+
+	const PxU32 kActorCnt = scene.getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+	vector<PxActor*> actors(kActorCnt);
+	if (kActorCnt)
+		scene.getActors(PxActorTypeFlag::eRIGID_DYNAMIC, actors.data(), kActorCnt);
+
+	// userDataには添字+1を入れる(NULLは登録していないアクター)
+	actors_.resize(kActorCnt);
+	for (PxU32 i = 0; i != kActorCnt; i++) {
+		actors_[i] = static_cast<PxRigidDynamic*>(actors[i]);
+		actors_[i]->userData = reinterpret_cast<void*>(size_t(i) + 1);
+	}
+
+	data_.resize(kActorCnt * PoseComponent::eCOUNT);
+	changed_indices_.reserve(kActorCnt);
+	updateAll();
+	previous_data_ = data_;
+}
+
+void ActorStateBuffer::addActors(PxRigidDynamic* const* actors, PxU32 actor_cnt)
+{
+	if (!scene_ || !actor_cnt)
+		return;
+
+	// 成分ごとの配列の長さが変わるので、新しい並びに移してから追加する
+	const size_t kStride = actors_.size() + actor_cnt;
+	resizeComponents(data_, kStride);
+	resizeComponents(previous_data_, kStride);
+	changed_indices_.reserve(kStride);
+
+	for (PxU32 i = 0; i != actor_cnt; i++) {
+		const PxU32 kIndex = (PxU32)actors_.size();
+		actors_.push_back(actors[i]);
+		actors[i]->userData = reinterpret_cast<void*>(size_t(kIndex) + 1);
+	}
+	for (PxU32 i = (PxU32)(kStride - actor_cnt); i != (PxU32)kStride; i++) {
+		writePose(i, actors_[i]->getGlobalPose());
+		for (PxU32 c = 0; c != PoseComponent::eCOUNT; c++)
+			previous_data_[c * kStride + i] = data_[c * kStride + i];
+	}
+}
+
+// 成分ごとの配列の長さをstrideに変える(既存のアクターの値は保つ)
+void ActorStateBuffer::resizeComponents(vector<PxReal> &data, size_t stride) const
+{
+	const size_t kOldStride = data.size() / PoseComponent::eCOUNT;
+	vector<PxReal> resized(stride * PoseComponent::eCOUNT, 0.0f);
+	for (PxU32 c = 0; c != PoseComponent::eCOUNT; c++) {
+		for (size_t i = 0; i != kOldStride; i++)
+			resized[c * stride + i] = data[c * kOldStride + i];
+	}
+	data.swap(resized);
+}
+
+void ActorStateBuffer::end()
+{
+	for (size_t i = 0; i != actors_.size(); i++)
+		actors_[i]->userData = NULL;
+	actors_.clear();
+	data_.clear();
+	previous_data_.clear();
+	changed_indices_.clear();
+	scene_ = NULL;
+}
+
+PxU32 ActorStateBuffer::update()
+{
+	// 前のupdateで動いたアクターの前の姿勢を揃える(動いていないアクターは揃っている)
+	const size_t kStride = actors_.size();
+	for (size_t i = 0; i != changed_indices_.size(); i++) {
+		for (PxU32 c = 0; c != PoseComponent::eCOUNT; c++)
+			previous_data_[c * kStride + changed_indices_[i]] = data_[c * kStride + changed_indices_[i]];
+	}
+	changed_indices_.clear();
+	if (!scene_)
+		return 0;
+
+	PxU32 active_cnt = 0;
+	PxActor** active_actors = scene_->getActiveActors(active_cnt);
+	for (PxU32 i = 0; i != active_cnt; i++) {
+		// articulation linkや登録後に追加したアクターは記録しない
+		PxActor* actor = active_actors[i];
+		if (actor->getType() != PxActorType::eRIGID_DYNAMIC || !actor->userData)
+			continue;
+
+		const PxU32 kIndex = (PxU32)(reinterpret_cast<size_t>(actor->userData) - 1);
+		writePose(kIndex, actors_[kIndex]->getGlobalPose());
+	}
+	return (PxU32)changed_indices_.size();
+}
+
+PxU32 ActorStateBuffer::updateAll()
+{
+	previous_data_ = data_;
+	changed_indices_.clear();
+	for (PxU32 i = 0; i != (PxU32)actors_.size(); i++)
+		writePose(i, actors_[i]->getGlobalPose());
+	return (PxU32)changed_indices_.size();
+}
+
+PxI32 ActorStateBuffer::getIndex(const PxActor &actor) const
+{
+	const size_t kIndex = reinterpret_cast<size_t>(actor.userData) - 1;
+	if (!actor.userData || kIndex >= actors_.size() || actors_[kIndex] != &actor)
+		return -1;
+	return (PxI32)kIndex;
+}
+
+PxTransform ActorStateBuffer::getPose(PxU32 index) const
+{
+	return readPose(data_, index);
+}
+
+PxTransform ActorStateBuffer::getPreviousPose(PxU32 index) const
+{
+	return readPose(previous_data_, index);
+}
+
+PxTransform ActorStateBuffer::getInterpolatedPose(PxU32 index, PxReal alpha) const
+{
+	const PxTransform kPrevious = readPose(previous_data_, index);
+	const PxTransform kCurrent = readPose(data_, index);
+
+	// 1ステップの間の回転は小さいので、正規化した線形補間で十分
+	// 同じ回転を表す逆符号のクォータニオンの場合は短い方を補間する
+	const PxQuat kTo = kPrevious.q.dot(kCurrent.q) < 0.0f ? -kCurrent.q : kCurrent.q;
+	const PxQuat kQ = kPrevious.q * (1.0f - alpha) + kTo * alpha;
+	return PxTransform(kPrevious.p + (kCurrent.p - kPrevious.p) * alpha, kQ.getNormalized());
+}
+
+PxTransform ActorStateBuffer::readPose(const vector<PxReal> &data, PxU32 index) const
+{
+	const size_t kStride = actors_.size();
+	const PxReal* component = data.data() + index;
+	return PxTransform(
+		PxVec3(component[PoseComponent::ePX * kStride], component[PoseComponent::ePY * kStride],
+			component[PoseComponent::ePZ * kStride]),
+		PxQuat(component[PoseComponent::eQX * kStride], component[PoseComponent::eQY * kStride],
+			component[PoseComponent::eQZ * kStride], component[PoseComponent::eQW * kStride]));
+}
+
+void ActorStateBuffer::writePose(PxU32 index, const PxTransform &pose)
+{
+	const size_t kStride = actors_.size();
+	PxReal* component = data_.data() + index;
+	component[PoseComponent::ePX * kStride] = pose.p.x;
+	component[PoseComponent::ePY * kStride] = pose.p.y;
+	component[PoseComponent::ePZ * kStride] = pose.p.z;
+	component[PoseComponent::eQX * kStride] = pose.q.x;
+	component[PoseComponent::eQY * kStride] = pose.q.y;
+	component[PoseComponent::eQZ * kStride] = pose.q.z;
+	component[PoseComponent::eQW * kStride] = pose.q.w;
+	changed_indices_.push_back(index);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// 姿勢の成分(ActorStateBufferの各配列)
+struct PoseComponent {
+	enum Enum {
+		ePX, ePY, ePZ,       // 位置
+		eQX, eQY, eQZ, eQW,  // 回転
+		eCOUNT
+	};
+};
+
+// シーンの動的アクターの姿勢を成分ごとの配列(SoA)に並べた1つの連続したバッファに保持する
+// updateはPxScene::getActiveActorsで前のステップに動いたアクターのみを読み出すので、
+// 眠っているアクターが多いシーンでは全てのアクターを走査するより速い
+// 書き出し・ログ・通信などは、getChangedIndicesの添字の姿勢のみを読めばよい
+//
+// シーンにPxSceneFlag::eENABLE_ACTIVE_ACTORSを設定しておくこと
+// アクターの添字はPxActor::userDataに保存するので、記録中は他の用途にuserDataを使わないこと
+class ActorStateBuffer {
+public:
+	ActorStateBuffer();
+	~ActorStateBuffer();
+
+	ActorStateBuffer(const ActorStateBuffer&) = delete;
+	ActorStateBuffer& operator=(const ActorStateBuffer&) = delete;
+
+	// シーンの全ての動的アクターを登録し、現在の姿勢で初期化する
+	// 以降にシーンへ追加したアクターは、addActorsで登録するまで記録しない
+	void begin(PxScene &scene);
+
+	// beginの後にシーンへ追加した動的アクターを登録し、現在の姿勢で初期化する(FractureCompoundの破片など)
+	// 登録済みのアクターの添字は変わらない。fetchResultsの後、次のsimulateの前に呼ぶ
+	void addActors(PxRigidDynamic* const* actors, PxU32 actor_cnt);
+
+	// 登録を解除する(userDataを戻す)。アクターを解放する前に呼ぶこと
+	void end();
+
+	// fetchResultsの後、次のsimulateの前に呼ぶ
+	// 前のステップで動いたアクターの姿勢のみを書き込み、書き込んだ数を返す
+	PxU32 update();
+
+	// 登録した全てのアクターの姿勢を書き込む(比較用)
+	PxU32 updateAll();
+
+	PxU32 getActorCount() const { return (PxU32)actors_.size(); }
+	PxRigidDynamic* getActor(PxU32 index) const { return actors_[index]; }
+
+	// actorの添字。登録していないアクターは-1
+	PxI32 getIndex(const PxActor &actor) const;
+
+	// 成分の配列(getActorCount個)
+	const PxReal* getComponent(PoseComponent::Enum component) const
+	{
+		return data_.data() + component * actors_.size();
+	}
+
+	PxTransform getPose(PxU32 index) const;
+
+	// 直前のupdateの前の姿勢(updateで動かなかったアクターはgetPoseと同じ)
+	PxTransform getPreviousPose(PxU32 index) const;
+
+	// 直前のupdateの前の姿勢(alpha = 0)と後の姿勢(alpha = 1)を補間する
+	// 固定ステップの間の時刻の姿勢を表示などに使う
+	PxTransform getInterpolatedPose(PxU32 index, PxReal alpha) const;
+
+	// 直前のupdate(updateAll)で書き込んだアクターの添字
+	const vector<PxU32>& getChangedIndices() const { return changed_indices_; }
+
+private:
+	PxScene* scene_;
+	vector<PxRigidDynamic*> actors_;
+	vector<PxReal> data_;           // 成分ごとにgetActorCount個ずつ並べる
+	vector<PxReal> previous_data_;  // 直前のupdateの前の姿勢(dataと同じ並び)
+	vector<PxU32> changed_indices_;
+
+	void writePose(PxU32 index, const PxTransform &pose);
+	void resizeComponents(vector<PxReal> &data, size_t stride) const;
+	PxTransform readPose(const vector<PxReal> &data, PxU32 index) const;
+};
@@ -0,0 +1,127 @@
+#include "chain_builder.h"
+
+
+using namespace std;
+
+// jointの位置posと向きq(ワールド座標)をactorのローカル座標にする
+static PxTransform toLocalFrame(const PxRigidActor &actor, const PxVec3 &pos, const PxQuat &q)
+{
+	const PxTransform kPose = actor.getGlobalPose();
+	return PxTransform(kPose.q.rotateInv(pos - kPose.p), kPose.q.getConjugate() * q);
+}
+
+static PxSphericalJoint* createSphericalJoint(PxPhysics &physics, PxRigidActor &actor0, PxRigidActor &actor1,
+	const PxVec3 &pos, const PxQuat &q)
+{
+	return PxSphericalJointCreate(physics,
+		&actor0, toLocalFrame(actor0, pos, q),
+		&actor1, toLocalFrame(actor1, pos, q));
+}
+
+Chain createChain(PxPhysics &physics, SceneBuilder &builder, const ChainDesc &desc, PxMaterial &material)
+{
+	// 要素のx軸をanchorの方向へ向ける(jointの向きも同じにする)
+	const PxQuat kRotation = PxShortestRotation(PxVec3(-1.0f, 0.0f, 0.0f), desc.direction);
+	const PxU32 kLinkCnt = desc.link_cnt;
+
+	// i番目のjointと要素の位置
+	auto joint_pos = [&](PxU32 i) { return desc.anchor + desc.direction * (desc.link_r * 2 * i); };
+	auto link_pos = [&](PxU32 i) {
+		const PxReal kDistance = i + 1 < kLinkCnt
+			? desc.link_r + desc.link_r * 2 * i
+			: desc.link_r * 2 * i + desc.last_link_r;
+		return desc.anchor + desc.direction * kDistance;
+	};
+	auto link_geometry = [&](PxU32 i) {
+		return PxSphereGeometry(i + 1 < kLinkCnt ? desc.link_r : desc.last_link_r);
+	};
+
+	Chain chain;
+	chain.links.reserve(kLinkCnt);
+
+	if (desc.type == ChainType::eJOINT) {
+		chain.hook = builder.createStatic(desc.hook_pose, desc.hook_geometry, material);
+		PxRigidActor* actor0 = chain.hook;
+		for (PxU32 i = 0; i != kLinkCnt; i++) {
+			PxRigidDynamic* element = builder.createDynamic(
+				PxTransform(link_pos(i), kRotation), link_geometry(i), material, desc.density);
+			element->setSolverIterationCounts(desc.position_iterations, desc.velocity_iterations);
+			if (desc.sleep)
+				builder.putToSleep(*element);
+
+			chain.joints.push_back(createSphericalJoint(physics, *actor0, *element, joint_pos(i), kRotation));
+			chain.links.push_back(element);
+			actor0 = element;
+		}
+		return chain;
+	}
+
+	// kMaxArticulationLinkCnt個ずつのarticulationに分ける
+	PxArticulationLink* last_link = NULL;
+	PxU32 i = 0;
+	while (i != kLinkCnt) {
+		PxArticulationReducedCoordinate* articulation = physics.createArticulationReducedCoordinate();
+		articulation->setSolverIterationCounts(desc.position_iterations, desc.velocity_iterations);
+
+		// 先頭のarticulationは、フックを固定したルートのリンクにして始める
+		PxArticulationLink* parent = NULL;
+		PxU32 segment_cnt = kMaxArticulationLinkCnt;
+		if (i == 0) {
+			articulation->setArticulationFlag(PxArticulationFlag::eFIX_BASE, true);
+			parent = builder.createLink(*articulation, NULL, desc.hook_pose, desc.hook_geometry, material,
+				desc.density);
+			chain.hook = parent;
+			segment_cnt--;
+		}
+
+		const PxU32 kEnd = PxMin(i + segment_cnt, kLinkCnt);
+		for (; i != kEnd; i++) {
+			PxArticulationLink* link = builder.createLink(*articulation, parent,
+				PxTransform(link_pos(i), kRotation), link_geometry(i), material, desc.density);
+
+			if (parent) {
+				// 3軸とも回転を制限しない関節
+				PxArticulationJointReducedCoordinate* joint
+					= static_cast<PxArticulationJointReducedCoordinate*>(link->getInboundJoint());
+				joint->setJointType(PxArticulationJointType::eSPHERICAL);
+				joint->setMotion(PxArticulationAxis::eTWIST, PxArticulationMotion::eFREE);
+				joint->setMotion(PxArticulationAxis::eSWING1, PxArticulationMotion::eFREE);
+				joint->setMotion(PxArticulationAxis::eSWING2, PxArticulationMotion::eFREE);
+				joint->setParentPose(toLocalFrame(*parent, joint_pos(i), kRotation));
+				joint->setChildPose(toLocalFrame(*link, joint_pos(i), kRotation));
+			}
+			else {
+				// 2つ目以降のarticulationのルートは、前のarticulationの最後のリンクとjointでつなぐ
+				chain.joints.push_back(createSphericalJoint(physics, *last_link, *link, joint_pos(i), kRotation));
+			}
+			chain.links.push_back(link);
+			parent = link;
+			last_link = link;
+		}
+
+		builder.addArticulation(*articulation, desc.sleep);
+		chain.articulations.push_back(articulation);
+	}
+	return chain;
+}
+
+vector<PxActor*> getSceneActors(PxScene &scene, PxActorTypeFlags types)
+{
+	vector<PxActor*> actors(scene.getNbActors(types));
+	if (!actors.empty())
+		scene.getActors(types, actors.data(), (PxU32)actors.size());
+	if (!(types & PxActorTypeFlag::eRIGID_DYNAMIC))
+		return actors;
+
+	const PxU32 kArticulationCnt = scene.getNbArticulations();
+	vector<PxArticulationBase*> articulations(kArticulationCnt);
+	if (kArticulationCnt)
+		scene.getArticulations(articulations.data(), kArticulationCnt);
+	vector<PxArticulationLink*> links;
+	for (PxU32 i = 0; i != kArticulationCnt; i++) {
+		links.resize(articulations[i]->getNbLinks());
+		articulations[i]->getLinks(links.data(), (PxU32)links.size());
+		actors.insert(actors.end(), links.begin(), links.end());
+	}
+	return actors;
+}
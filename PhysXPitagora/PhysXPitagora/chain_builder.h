@@ -0,0 +1,63 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "scene_builder.h"
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// 鎖(振り子やロープ)の作り方
+struct ChainType {
+	enum Enum {
+		eJOINT,        // 要素ごとのPxRigidDynamicをPxSphericalJointでつなぐ(maximal coordinate)
+		eARTICULATION  // 要素をPxArticulationReducedCoordinateのリンクにし、sphericalの関節でつなぐ
+	};
+};
+
+// 鎖の形と設定
+// 鎖はhook_poseに置いたフック(箱)から吊るす
+// 要素は半径link_rの球で、anchorからdirectionの方向へ接するように並べる
+// 最初のjointはanchorの位置、i番目のjointはi-1番目とi番目の要素の接点
+struct ChainDesc {
+	ChainType::Enum type;
+	PxTransform hook_pose;
+	PxBoxGeometry hook_geometry;
+	PxVec3 anchor;       // 鎖を吊るす点(フックの表面)
+	PxVec3 direction;    // anchorから鎖の先端へ向かう単位ベクトル
+	PxU32 link_cnt;      // 要素の数
+	PxReal link_r;       // 要素の半径
+	PxReal last_link_r;  // 最後の要素(おもり)の半径
+	PxReal density;
+	PxU32 position_iterations;
+	PxU32 velocity_iterations;
+	bool sleep;          // シーンに追加した後にスリープさせる
+
+	ChainDesc()
+		: type(ChainType::eJOINT), hook_pose(PxIdentity), hook_geometry(0.5f, 0.1f, 0.1f), anchor(0.0f),
+		direction(0.0f, -1.0f, 0.0f), link_cnt(18), link_r(0.15f), last_link_r(0.15f), density(1.0f),
+		position_iterations(4), velocity_iterations(1), sleep(false) {}
+};
+
+// 作成した鎖
+struct Chain {
+	PxRigidActor* hook;          // フック(PxRigidStaticまたは固定したルートのPxArticulationLink)
+	vector<PxRigidBody*> links;  // 先頭から順の要素(PxRigidDynamicまたはPxArticulationLink)
+	vector<PxArticulationReducedCoordinate*> articulations;  // eARTICULATIONの場合のarticulation
+	vector<PxJoint*> joints;     // PxSphericalJoint(eARTICULATIONの場合はarticulationの間のみ)
+};
+
+// 鎖を作成し、builderでシーンに追加する
+// eJOINTではフックをstatic actorにし、最初の要素とPxSphericalJointでつなぐ
+// eARTICULATIONではフックを固定したルートのリンクにする(関節でつながったリンク同士は衝突しないので、
+// フックに接する最初の要素がフックと衝突しない)
+//
+// 1つのarticulationのリンク数には上限(kMaxArticulationLinkCnt)があるので、長い鎖は複数の
+// articulationに分け、間をPxSphericalJointでつなぐ(先頭のarticulationのみルートを固定する)
+Chain createChain(PxPhysics &physics, SceneBuilder &builder, const ChainDesc &desc, PxMaterial &material);
+
+// 1つのarticulationのリンク数の上限(PhysX 4.1)
+const PxU32 kMaxArticulationLinkCnt = 64;
+
+// シーンのアクターを取得する
+// PxScene::getActorsはarticulationのリンクを返さないので、typesにeRIGID_DYNAMICを含む場合はリンクも加える
+vector<PxActor*> getSceneActors(PxScene &scene, PxActorTypeFlags types);
@@ -0,0 +1,203 @@
+#include "fracture_compound.h"
+
+
+using namespace std;
+
+FractureCompound::FractureCompound(PxRigidDynamic &actor, PxReal density, PxReal impulse_threshold,
+	PxReal radius, PxReal step_time)
+	: actor_(actor), density_(density), impulse_threshold_(impulse_threshold), radius_(radius),
+	piece_cnt_(actor.getNbShapes())
+{
+	// 接触し始めた時だけでなく、押され続けている間も報告させる
+	actor_.setContactReportThreshold(impulse_threshold / step_time);
+
+	const PxTransform kPose = actor_.getGlobalPose();
+	shapes_.resize(piece_cnt_);
+	actor_.getShapes(shapes_.data(), piece_cnt_);
+	piece_actors_.assign(piece_cnt_, &actor_);
+	initial_positions_.resize(piece_cnt_);
+	for (PxU32 i = 0; i != piece_cnt_; i++)
+		initial_positions_[i] = kPose.transform(shapes_[i]->getLocalPose().p);
+
+	// 破片の上下と、隣り合う破片の距離(最も近い破片同士の距離に少し余裕を持たせる)
+	up_ = kPose.q.rotateInv(PxVec3(0.0f, 1.0f, 0.0f));
+	bottom_height_ = PX_MAX_F32;
+	PxReal min_distance = PX_MAX_F32;
+	for (PxU32 i = 0; i != piece_cnt_; i++) {
+		const PxVec3 kPosition = shapes_[i]->getLocalPose().p;
+		bottom_height_ = PxMin(bottom_height_, kPosition.dot(up_));
+		for (PxU32 j = i + 1; j != piece_cnt_; j++)
+			min_distance = PxMin(min_distance, (shapes_[j]->getLocalPose().p - kPosition).magnitude());
+	}
+	link_distance_ = piece_cnt_ > 1 ? min_distance * 1.05f : 0.0f;
+}
+
+bool FractureCompound::onContact(const SimulationEvent &event)
+{
+	if (event.type != SimulationEventType::eCONTACT && event.type != SimulationEventType::eCONTACT_FORCE)
+		return false;
+	if (event.actors[0] != &actor_ && event.actors[1] != &actor_)
+		return false;
+
+	if (event.impulse >= impulse_threshold_)
+		impact_positions_.push_back(event.position);
+	return true;
+}
+
+PxU32 FractureCompound::update(PxPhysics &physics, PxScene &scene)
+{
+	if (impact_positions_.empty())
+		return 0;
+
+	const PxTransform kPose = actor_.getGlobalPose();
+	const PxVec3 kCenter = kPose.transform(actor_.getCMassLocalPose().p);
+	const PxVec3 kLinearVelocity = actor_.getLinearVelocity();
+	const PxVec3 kAngularVelocity = actor_.getAngularVelocity();
+
+	// 接触点の近くの破片を分ける
+	vector<char> split(piece_cnt_, 0);
+	bool hit_any = false;
+	for (PxU32 i = 0; i != piece_cnt_; i++) {
+		if (!shapes_[i])
+			continue;
+		const PxVec3 kPosition = kPose.transform(shapes_[i]->getLocalPose().p);
+		for (size_t p = 0; p != impact_positions_.size() && !split[i]; p++)
+			split[i] = (kPosition - impact_positions_[p]).magnitudeSquared() <= radius_ * radius_;
+		hit_any = hit_any || split[i];
+	}
+	impact_positions_.clear();
+	if (!hit_any)
+		return 0;
+
+	// 支えを失った破片も分ける。全て分ける場合は最初の破片をアクターに残す
+	markUnsupportedPieces(split);
+	PxU32 remaining_cnt = 0;
+	for (PxU32 i = 0; i != piece_cnt_; i++)
+		remaining_cnt += shapes_[i] && !split[i];
+	for (PxU32 i = 0; i != piece_cnt_ && remaining_cnt == 0; i++) {
+		if (shapes_[i]) {
+			split[i] = 0;
+			remaining_cnt = 1;
+		}
+	}
+
+	PxU32 split_cnt = 0;
+	for (PxU32 i = 0; i != piece_cnt_; i++) {
+		if (shapes_[i] && split[i]) {
+			splitPiece(physics, scene, i, kPose, kCenter, kLinearVelocity, kAngularVelocity);
+			split_cnt++;
+		}
+	}
+
+	// 残った破片で質量と慣性を求め直す
+	if (split_cnt)
+		PxRigidBodyExt::updateMassAndInertia(actor_, density_);
+	return split_cnt;
+}
+
+// 残る破片(shapes_[i]が有り、split[i]が0)のうち、最も低い破片から下の破片に載ってたどれないものと、
+// たどれる破片のうち最大のまとまりに隣り合ってつながっていないものをsplitに加える
+void FractureCompound::markUnsupportedPieces(vector<char> &split) const
+{
+	vector<PxU32> remaining;
+	for (PxU32 i = 0; i != piece_cnt_; i++) {
+		if (shapes_[i] && !split[i])
+			remaining.push_back(i);
+	}
+	const PxU32 kCnt = (PxU32)remaining.size();
+	vector<PxVec3> positions(kCnt);
+	for (PxU32 i = 0; i != kCnt; i++)
+		positions[i] = shapes_[remaining[i]]->getLocalPose().p;
+
+	const PxReal kLinkDistance2 = link_distance_ * link_distance_;
+	const PxReal kHalfLink = link_distance_ * 0.5f;
+
+	// 最も低い破片から、真上に載っている破片をたどる
+	vector<char> supported(kCnt, 0);
+	vector<PxU32> queue;
+	for (PxU32 i = 0; i != kCnt; i++) {
+		if (positions[i].dot(up_) <= bottom_height_ + kHalfLink) {
+			supported[i] = 1;
+			queue.push_back(i);
+		}
+	}
+	for (size_t q = 0; q != queue.size(); q++) {
+		const PxVec3 &kBelow = positions[queue[q]];
+		for (PxU32 i = 0; i != kCnt; i++) {
+			const PxVec3 kOffset = positions[i] - kBelow;
+			if (!supported[i] && kOffset.magnitudeSquared() <= kLinkDistance2 && kOffset.dot(up_) > kHalfLink) {
+				supported[i] = 1;
+				queue.push_back(i);
+			}
+		}
+	}
+
+	// 支えられている破片を隣り合うまとまりに分け、最大のまとまりを残す
+	vector<PxU32> component(kCnt, 0);  // 0はまとまりに入っていない
+	PxU32 component_cnt = 0, largest = 0, largest_size = 0;
+	for (PxU32 start = 0; start != kCnt; start++) {
+		if (!supported[start] || component[start])
+			continue;
+		component[start] = ++component_cnt;
+		queue.assign(1, start);
+		for (size_t q = 0; q != queue.size(); q++) {
+			for (PxU32 i = 0; i != kCnt; i++) {
+				if (supported[i] && !component[i]
+					&& (positions[i] - positions[queue[q]]).magnitudeSquared() <= kLinkDistance2) {
+					component[i] = component_cnt;
+					queue.push_back(i);
+				}
+			}
+		}
+		if (queue.size() > largest_size) {
+			largest = component_cnt;
+			largest_size = (PxU32)queue.size();
+		}
+	}
+
+	for (PxU32 i = 0; i != kCnt; i++) {
+		if (component[i] != largest || !largest)
+			split[remaining[i]] = 1;
+	}
+}
+
+// index番目の破片を、同じ形、材質、フィルタデータのshapeを持つアクターにしてシーンに追加する
+// 分けた破片は、元のアクターのその位置の速度を引き継ぐ
+void FractureCompound::splitPiece(PxPhysics &physics, PxScene &scene, PxU32 index, const PxTransform &pose,
+	const PxVec3 &center, const PxVec3 &linear_velocity, const PxVec3 &angular_velocity)
+{
+	PxShape &shape = *shapes_[index];
+	const PxTransform kShapePose = pose * shape.getLocalPose();
+
+	PxMaterial* material;
+	shape.getMaterials(&material, 1);
+	PxRigidDynamic* piece = physics.createRigidDynamic(kShapePose);
+	PxShape* piece_shape = PxRigidActorExt::createExclusiveShape(
+		*piece, shape.getGeometry().any(), *material, shape.getFlags());
+	// 分けた破片同士の接触は報告させない(残ったアクターとの接触はアクター側の購読で報告される)
+	PxFilterData filter_data = shape.getSimulationFilterData();
+	filter_data.word1 &= ~filter_data.word0;
+	piece_shape->setSimulationFilterData(filter_data);
+	PxRigidBodyExt::updateMassAndInertia(*piece, density_);
+	piece->setLinearVelocity(linear_velocity + angular_velocity.cross(kShapePose.p - center));
+	piece->setAngularVelocity(angular_velocity);
+	scene.addActor(*piece);
+
+	shapes_[index] = NULL;
+	piece_actors_[index] = piece;
+	actor_.detachShape(shape);
+	split_actors_.push_back(piece);
+}
+
+PxU32 FractureCompound::getMovedPieceCount(PxReal distance) const
+{
+	const PxTransform kPose = actor_.getGlobalPose();
+	PxU32 moved_cnt = 0;
+	for (PxU32 i = 0; i != piece_cnt_; i++) {
+		const PxVec3 kPosition = shapes_[i]
+			? kPose.transform(shapes_[i]->getLocalPose().p) : piece_actors_[i]->getGlobalPose().p;
+		if ((kPosition - initial_positions_[i]).magnitudeSquared() > distance * distance)
+			moved_cnt++;
+	}
+	return moved_cnt;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "../../Common/simulation_events.h"
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// 複数のshape(破片)を持つ1つのdynamic actorを、衝撃を受けた破片だけ別のアクターに分けていく
+// 壊れるまではシーンの中で1つのアクターなので、broadphaseとアイランドの管理のコストも1つ分で済む
+//
+// 衝撃はSimulationEventRecorderが記録した接触(eCONTACT, eCONTACT_FORCE)で受け取るので、破片のshapeには
+// makeContactReportFilterDataで衝撃を受ける相手のグループを購読させておく
+// 自分のグループも購読させれば、分けた破片が当たった場合や、崩れて押し合っている場合にも分ける
+// (分けた破片同士の接触は報告させない)
+// シーンへのアクターの追加はsimulate中にはできないので、fetchResultsの後にupdateでまとめて行う
+//
+// 破片を分けた後は、残った破片のうち下の破片に支えられていないものと、
+// 支えられている破片の最大のまとまりにつながっていないものも分ける(宙に浮いたまま残らないようにする)
+// 上下は作成したときのアクターの向きで、最も低い破片を地面に置かれているものとする
+//
+// 最後に残った1つの破片はアクター自身とする(アクターは解放しない)
+class FractureCompound {
+public:
+	// actor: SceneBuilder::createCompoundで作成したアクター
+	// density: 破片の密度
+	// impulse_threshold: 破片を分ける接触の力積の大きさ(N・s)
+	// radius: 接触点からこの距離以内に中心がある破片を分ける
+	// step_time: 1ステップの時間。接触が続いている間は、力積がimpulse_thresholdを超える力で報告させる
+	FractureCompound(PxRigidDynamic &actor, PxReal density, PxReal impulse_threshold, PxReal radius,
+		PxReal step_time);
+
+	// 接触イベントを渡し、このアクターへの接触ならtrueを返す
+	// 力積がimpulse_threshold以上の場合は、接触点を次のupdateで破片を分ける位置とする
+	bool onContact(const SimulationEvent &event);
+
+	// 溜めた接触点の近くの破片と、それにより支えを失った破片を別のアクターにしてシーンに追加し、
+	// 分けた破片の数を返す
+	// 分けた破片は、元のアクターのその位置の速度を引き継ぐ
+	PxU32 update(PxPhysics &physics, PxScene &scene);
+
+	PxRigidDynamic& getActor() const { return actor_; }
+
+	// 破片の数(分ける前のshapeの数)
+	PxU32 getPieceCount() const { return piece_cnt_; }
+
+	// 分けた破片のアクター
+	const vector<PxRigidDynamic*>& getSplitActors() const { return split_actors_; }
+
+	// 作成したときの位置からdistanceより離れた破片の数(分けていない破片を含む)
+	PxU32 getMovedPieceCount(PxReal distance) const;
+
+private:
+	PxRigidDynamic &actor_;
+	PxReal density_;
+	PxReal impulse_threshold_;
+	PxReal radius_;
+	PxU32 piece_cnt_;
+
+	vector<PxVec3> impact_positions_;  // 次のupdateで破片を分ける接触点
+	vector<PxRigidDynamic*> split_actors_;
+
+	// 破片ごとの状態(作成したときのshapeの順)
+	vector<PxShape*> shapes_;             // 分けていない破片のshape(分けた破片はNULL)
+	vector<PxRigidDynamic*> piece_actors_;  // 破片が属するアクター
+	vector<PxVec3> initial_positions_;    // 作成したときの破片の位置
+	PxVec3 up_;                           // アクター座標系での上向き(作成したときの重力の逆向き)
+	PxReal bottom_height_;                // 最も低い破片の高さ(up_方向)
+	PxReal link_distance_;                // 中心がこの距離以内の破片同士を接しているとする
+
+	void markUnsupportedPieces(vector<char> &split) const;
+	void splitPiece(PxPhysics &physics, PxScene &scene, PxU32 index, const PxTransform &pose,
+		const PxVec3 &center, const PxVec3 &linear_velocity, const PxVec3 &angular_velocity);
+};
@@ -0,0 +1,196 @@
+#include "frame_recorder.h"
+#include "trace_profiler.h"
+#include "chain_builder.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+
+using namespace std;
+
+FrameRecorder::FrameRecorder()
+	: format_(FrameRecordFormat::ePOSE_FILE), recording_(false), bytes_written_(0),
+	stopping_(false), recorded_frame_cnt_(0)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	end();
+}
+
+// output_path: 出力先ディレクトリ
+// format: 動的アクターの記録形式
+bool FrameRecorder::begin(PxScene &scene, const string &output_path, FrameRecordFormat::Enum format)
+{
+	end();
+	format_ = format;
+	output_path_ = output_path;
+	bytes_written_ = 0;
+	recorded_frame_cnt_ = 0;
+	stopping_ = false;
+
+	// 静的アクターの形状を1度だけ書き出す
+	PxU32 static_cnt = scene.getNbActors(PxActorTypeFlag::eRIGID_STATIC);
+	vector<PxActor*> static_actors(static_cnt);
+	scene.getActors(PxActorTypeFlag::eRIGID_STATIC, static_actors.data(), static_cnt);
+
+	vector<StlShape> static_shapes;
+	vector<PxTransform> static_poses;
+	for (PxU32 i = 0; i < static_cnt; i++) {
+		PxRigidActor* actor = (PxRigidActor*)static_actors[i];
+		StlShape shape;
+		if (StlShape::fromActor(*actor, shape)) {
+			static_shapes.push_back(shape);
+			static_poses.push_back(actor->getGlobalPose());
+		}
+	}
+	stl_output_.outputShapes(output_path_ + "static.stl",
+		static_shapes.data(), static_poses.data(), (PxU32)static_shapes.size(), StlFormat::eBINARY);
+
+	// 動的アクター(articulationのリンクを含む)の一覧と形状を記録する
+	const vector<PxActor*> kActors = getSceneActors(scene, PxActorTypeFlag::eRIGID_DYNAMIC);
+	const PxU32 dynamic_cnt = (PxU32)kActors.size();
+
+	dynamic_actors_.clear();
+	dynamic_shapes_.clear();
+	for (PxU32 i = 0; i < dynamic_cnt; i++) {
+		PxRigidActor* actor = (PxRigidActor*)kActors[i];
+		StlShape shape;
+		if (StlShape::fromActor(*actor, shape)) {
+			dynamic_actors_.push_back(actor);
+			dynamic_shapes_.push_back(shape);
+		}
+	}
+
+	if (format_ == FrameRecordFormat::ePOSE_FILE) {
+		static_assert(sizeof(PxTransform) == sizeof(float) * 7, "PxTransform must be 7 packed floats");
+
+		pose_stream_.open(output_path_ + "frames.bin", ios::out | ios::binary);
+		if (!pose_stream_) {
+			cout << "frames.binを開けません: " << output_path_ << endl;
+			return false;
+		}
+
+		const PxU32 kHeader[] = { 0x52465850 /* "PXFR" */, kFileVersion, (PxU32)dynamic_shapes_.size() };
+		pose_stream_.write((const char*)kHeader, sizeof(kHeader));
+		for (size_t i = 0; i != dynamic_shapes_.size(); i++) {
+			const StlShape &shape = dynamic_shapes_[i];
+			const PxU32 kType = (PxU32)shape.type;
+			const PxVec3 kSize = shape.type == PxGeometryType::eSPHERE
+				? PxVec3(shape.radius, 0.0f, 0.0f) : shape.half_extents;
+			pose_stream_.write((const char*)&kType, sizeof(kType));
+			pose_stream_.write((const char*)&kSize, sizeof(kSize));
+			pose_stream_.write((const char*)&shape.local_pose, sizeof(PxTransform));
+		}
+		bytes_written_ += (size_t)pose_stream_.tellp();
+	}
+
+	// 書き出し待ちのフレームをあらかじめ確保しておく
+	for (size_t i = frames_.size(); i < kInitialFrameCnt; i++)
+		frames_.push_back(unique_ptr<Frame>(new Frame));
+	free_frames_.clear();
+	free_frames_.reserve(frames_.size());
+	for (size_t i = 0; i != frames_.size(); i++) {
+		frames_[i]->poses.resize(dynamic_actors_.size());
+		free_frames_.push_back(frames_[i].get());
+	}
+
+	writer_thread_ = thread(&FrameRecorder::writerLoop, this);
+	recording_ = true;
+	return true;
+}
+
+void FrameRecorder::recordFrame(PxU32 step)
+{
+	if (!recording_)
+		return;
+
+	Frame* frame = acquireFrame();
+	frame->step = step;
+	for (size_t i = 0; i != dynamic_actors_.size(); i++)
+		frame->poses[i] = dynamic_actors_[i]->getGlobalPose();
+
+	{
+		lock_guard<mutex> lock(mutex_);
+		pending_frames_.push_back(frame);
+	}
+	cv_.notify_one();
+	recorded_frame_cnt_++;
+}
+
+// 空いているフレームを取り出す
+// 書き出しが追いついておらず空きが無い場合は、待たずに新しいフレームを確保する
+FrameRecorder::Frame* FrameRecorder::acquireFrame()
+{
+	{
+		lock_guard<mutex> lock(mutex_);
+		if (!free_frames_.empty()) {
+			Frame* frame = free_frames_.back();
+			free_frames_.pop_back();
+			return frame;
+		}
+	}
+
+	frames_.push_back(unique_ptr<Frame>(new Frame));
+	frames_.back()->poses.resize(dynamic_actors_.size());
+	return frames_.back().get();
+}
+
+void FrameRecorder::end()
+{
+	if (!recording_)
+		return;
+
+	{
+		lock_guard<mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	cv_.notify_one();
+	writer_thread_.join();
+	pose_stream_.close();
+	recording_ = false;
+
+	cout << "Recorded frames: " << recorded_frame_cnt_
+		<< ", bytes: " << bytes_written_
+		<< ", frame buffers: " << frames_.size() << endl;
+}
+
+// 書き出しスレッド
+// stopping_が立っても、書き出し待ちのフレームを全て書き出してから終了する
+void FrameRecorder::writerLoop()
+{
+	for (;;) {
+		Frame* frame;
+		{
+			unique_lock<mutex> lock(mutex_);
+			cv_.wait(lock, [this] { return stopping_ || !pending_frames_.empty(); });
+			if (pending_frames_.empty())
+				return;
+			frame = pending_frames_.front();
+			pending_frames_.pop_front();
+		}
+
+		writeFrame(*frame);
+
+		lock_guard<mutex> lock(mutex_);
+		free_frames_.push_back(frame);
+	}
+}
+
+void FrameRecorder::writeFrame(const Frame &frame)
+{
+	TraceZone zone("Export.writeFrame");
+	if (format_ == FrameRecordFormat::ePOSE_FILE) {
+		pose_stream_.write((const char*)&frame.step, sizeof(PxU32));
+		pose_stream_.write((const char*)frame.poses.data(), frame.poses.size() * sizeof(PxTransform));
+		bytes_written_ += sizeof(PxU32) + frame.poses.size() * sizeof(PxTransform);
+	}
+	else {
+		stringstream file_name;
+		file_name << "frame_" << setw(4) << setfill('0') << frame.step << ".stl";
+		StlOutputStats stats = stl_output_.outputShapes(output_path_ + file_name.str(),
+			dynamic_shapes_.data(), frame.poses.data(), (PxU32)frame.poses.size(), StlFormat::eBINARY);
+		bytes_written_ += stats.bytes_written;
+	}
+}
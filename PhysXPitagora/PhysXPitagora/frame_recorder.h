@@ -0,0 +1,83 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "stl_output.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+using namespace physx;
+
+// フレーム記録の出力形式
+struct FrameRecordFormat {
+	enum Enum {
+		ePOSE_FILE,    // 動的アクターの姿勢をframes.binに追記する
+		eSTL_SEQUENCE  // 動的アクターをフレームごとのバイナリSTL(frame_0000.stl, ...)に書き出す
+	};
+};
+
+// シミュレーションの各フレームを記録する
+// 静的アクターの形状は記録開始時にstatic.stlへ1度だけ書き出し、
+// フレームごとには動的アクター(articulationのリンクを含む)の姿勢のみを書き出しスレッドへ渡す
+//
+// frames.binの形式(リトルエンディアン)
+//  ヘッダ:   "PXFR", バージョン(uint32), 動的アクター数N(uint32)
+//  形状表:   N個の {形状の種類(uint32, PxGeometryType), 寸法(float x3, boxは半辺長/sphereは半径),
+//                   アクター座標系での姿勢(PxTransform)}
+//  フレーム: {ステップ番号(uint32), N個のアクターの姿勢(PxTransform)}
+//            ステップ番号はそれまでに進めたステップ数(0は初期状態)
+//  PxTransformはfloat x7(q.x, q.y, q.z, q.w, p.x, p.y, p.z)
+class FrameRecorder {
+public:
+	FrameRecorder();
+	~FrameRecorder();
+
+	// 記録を開始する。記録中にシーンへアクターを追加・削除してはならない
+	bool begin(PxScene &scene, const string &output_path, FrameRecordFormat::Enum format);
+
+	// stepステップ進めた時点の動的アクターの姿勢を取得して書き出しスレッドへ渡す
+	// ファイルへの書き込みは待たないので、fetchResultsの後に呼べばシミュレーションを止めない
+	// 最後のステップの後の状態も残すには、ステップを終えた後にもう1度呼ぶ
+	void recordFrame(PxU32 step);
+
+	// 書き出し待ちのフレームを全て書き出して記録を終了する
+	void end();
+
+private:
+	static const PxU32 kFileVersion = 1;
+	static const size_t kInitialFrameCnt = 8;  // 書き出し待ちにできるフレーム数の初期値
+
+	struct Frame {
+		PxU32 step;
+		vector<PxTransform> poses;
+	};
+
+	FrameRecordFormat::Enum format_;
+	string output_path_;
+	bool recording_;
+	vector<PxRigidActor*> dynamic_actors_;
+	vector<StlShape> dynamic_shapes_;
+
+	// 以下は書き出しスレッドのみが使う
+	ofstream pose_stream_;
+	StlOutput stl_output_;
+	size_t bytes_written_;
+
+	// フレームの受け渡し
+	thread writer_thread_;
+	mutex mutex_;
+	condition_variable cv_;
+	vector<unique_ptr<Frame> > frames_;  // 確保したフレーム(シミュレーションスレッドのみが触る)
+	vector<Frame*> free_frames_;
+	deque<Frame*> pending_frames_;
+	bool stopping_;
+	size_t recorded_frame_cnt_;
+
+	Frame* acquireFrame();
+	void writerLoop();
+	void writeFrame(const Frame &frame);
+};
@@ -1,72 +1,237 @@
 #include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <random>
+#include <fstream>
+#include <algorithm>
 #include "PxPhysicsAPI.h"
 #include "stl_output.h"
+#include "frame_recorder.h"
+#include "work_stealing_dispatcher.h"
+#include "pitagora_scene.h"
+#include "tracking_allocator.h"
+#include "scene_snapshot.h"
+#include "scene_checkpoint.h"
+#include "../../Common/simulation_events.h"
+#include "actor_state_buffer.h"
+#include "scene_query_batch.h"
+#include "step_controller.h"
+#include "solver_profile.h"
+#include "chain_builder.h"
+#include "fracture_compound.h"
+#include "trace_profiler.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace physx;
 
-PxDefaultAllocator      gAllocator;
+TrackingAllocator       gAllocator;
 PxDefaultErrorCallback  gErrorCallback;
 PxFoundation*           gFoundation = NULL;
 PxPhysics*              gPhysics = NULL;
-PxDefaultCpuDispatcher* gDispatcher = NULL;
+PxCpuDispatcher*        gDispatcher = NULL;
 PxScene*                gScene = NULL;
 PxPvd*                  gPvd = NULL;
 
-PxRigidDynamic* gPusher = NULL;
+vector<PxRigidDynamic*> gPushers;  // 各装置の球を押すkinematic actor
+
+// 装置の規模(コマンドライン引数で変更する)
+PitagoraSceneDesc gSceneDesc;
+
+// PhysXのプロファイルゾーンの記録(--trace)
+TraceProfiler gProfiler;
+string gTracePath;
+
+// 通常の実行で使うソルバーのプロファイル(NULLの場合はPhysXの既定値とgSceneDescの反復回数)
+const SolverProfile* gSolverProfile = NULL;
+
+// --load-snapshotで読み込んだシーン
+SceneSnapshot gSnapshot;
+
+// gSceneのjointの破断、スリープ・起床、購読した接触の記録
+SimulationEventRecorder gEventRecorder;
+
+// ディスパッチャの設定(コマンドライン引数で変更する)
+DispatcherType::Enum gDispatcherType = DispatcherType::eDEFAULT;
+PxU32 gWorkerThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
+bool gPinWorkerThreads = false;
+
+// PVDの接続方法(コマンドライン引数で変更する)
+struct PvdMode {
+	enum Enum {
+		eNONE,    // PVDを使わない(ヘッドレス実行)
+		eSOCKET,  // 起動中のPVDへソケットで送る
+		eFILE     // ファイルに書き出し、後からPVDで開く
+	};
+};
+PvdMode::Enum gPvdMode = PvdMode::eSOCKET;
+string gPvdFilePath;
+
+// PVDへ送る情報
+PxPvdInstrumentationFlags gPvdFlags = PxPvdInstrumentationFlag::eALL;
+PxPvdSceneFlags gPvdSceneFlags = PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS
+	| PxPvdSceneFlag::eTRANSMIT_CONTACTS | PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES;
+
+// カンマ区切りの名前からPVDへ送る情報を設定する
+//  debug, profile, memory        : PxPvdInstrumentationFlag
+//  contacts, constraints, queries: PxPvdSceneFlag(debugも必要)
+void parsePvdFlags(const string &names)
+{
+	gPvdFlags = PxPvdInstrumentationFlags();
+	gPvdSceneFlags = PxPvdSceneFlags();
+
+	stringstream stream(names);
+	string name;
+	while (getline(stream, name, ',')) {
+		if (name == "debug")
+			gPvdFlags |= PxPvdInstrumentationFlag::eDEBUG;
+		else if (name == "profile")
+			gPvdFlags |= PxPvdInstrumentationFlag::ePROFILE;
+		else if (name == "memory")
+			gPvdFlags |= PxPvdInstrumentationFlag::eMEMORY;
+		else if (name == "contacts")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_CONTACTS;
+		else if (name == "constraints")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS;
+		else if (name == "queries")
+			gPvdSceneFlags |= PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES;
+		else
+			cerr << "Unknown PVD flag: " << name << endl;
+	}
+}
+
+// シミュレーションステップの進め方
+struct StepMode {
+	enum Enum {
+		eBLOCKING,   // simulateの直後にfetchResults(true)で完了を待つ
+		ePIPELINED,  // simulateの後にフレーム処理を行い、fetchResults(false)で完了をポーリングする
+		eSPLIT       // collide/advanceに分けて実行し、advance中にフレーム処理を行う
+	};
+};
+StepMode::Enum gStepMode = StepMode::eBLOCKING;
+
+// Sceneの作成
+// event_callback: NULLの場合はイベントを受け取らない
+// profile: NULLでない場合はソルバー、接触生成、ブロードフェーズをprofileに合わせる
+//          (反復回数とMBPの領域は、アクターを追加した後にapplySolverProfileで設定する)
+PxScene* createScene(PxCpuDispatcher* dispatcher, PxSimulationEventCallback* event_callback = NULL,
+	const SolverProfile* profile = NULL)
+{
+	PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
+	sceneDesc.gravity = PxVec3(0.0f, -9.8f, 0.0f);          // Right-hand coordinate system, Y-UP.
+	sceneDesc.cpuDispatcher = dispatcher;
+	sceneDesc.filterShader = contactReportFilterShader;     // 購読したペアのみ接触を報告する
+	sceneDesc.simulationEventCallback = event_callback;
+	sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS;  // ActorStateBufferで動いたアクターのみを読み出す
+	if (profile)
+		applySolverProfile(*profile, sceneDesc);
+	PxScene* scene = gPhysics->createScene(sceneDesc);
+
+	// PVDの設定
+	PxPvdSceneClient* pvdClient = scene->getScenePvdClient();
+	if (pvdClient)
+	{
+		pvdClient->setScenePvdFlags(gPvdSceneFlags);
+	}
+	return scene;
+}
 
 // PhysXの初期化
 void initPhysics()
 {
 	gFoundation = PxCreateFoundation(PX_PHYSICS_VERSION, gAllocator, gErrorCallback);
+	gFoundation->setReportAllocationNames(true);  // リリースビルドでも確保名を集計する
 
-	// PVDの設定
-	gPvd = PxCreatePvd(*gFoundation);
-	PxPvdTransport* transport = PxDefaultPvdSocketTransportCreate("localhost", 5425, 10);
-	gPvd->connect(*transport, PxPvdInstrumentationFlag::eALL);
+	// PVDの設定(ヘッドレス実行では作成しない)
+	PxPvdTransport* transport = NULL;
+	if (gPvdMode == PvdMode::eSOCKET)
+		transport = PxDefaultPvdSocketTransportCreate("localhost", 5425, 10);
+	else if (gPvdMode == PvdMode::eFILE)
+		transport = PxDefaultPvdFileTransportCreate(gPvdFilePath.c_str());
+	if (transport) {
+		gPvd = PxCreatePvd(*gFoundation);
+		gPvd->connect(*transport, gPvdFlags);
+	}
+
+	// PVDのプロファイルの後に登録し、PVDにもゾーンを渡す
+	if (!gTracePath.empty())
+		gProfiler.install();
 
 	gPhysics = PxCreatePhysics(PX_PHYSICS_VERSION, *gFoundation, PxTolerancesScale(), true, gPvd);
 	PxInitExtensions(*gPhysics, gPvd);
 
 	// Sceneの作成
-	PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
-	sceneDesc.gravity = PxVec3(0.0f, -9.8f, 0.0f);          // Right-hand coordinate system, Y-UP.
-	gDispatcher = PxDefaultCpuDispatcherCreate(0);         // The number of worker threads is one.
-	sceneDesc.cpuDispatcher = gDispatcher;
-	sceneDesc.filterShader = PxDefaultSimulationFilterShader;
-	gScene = gPhysics->createScene(sceneDesc);
+	// ワーカースレッド数が0の場合、タスクはsimulateを呼んだスレッドで実行される
+	gDispatcher = createCpuDispatcher(gDispatcherType, gWorkerThreadCnt, gPinWorkerThreads);
+	gAllocator.setPhase(AllocationPhase::eSCENE_BUILD);
+	gScene = createScene(gDispatcher, &gEventRecorder, gSolverProfile);
 
 	gScene->setVisualizationParameter(PxVisualizationParameter::eSCALE, 1.0f);
 
-	// PVDの設定
-	PxPvdSceneClient* pvdClient = gScene->getScenePvdClient();
-	if (pvdClient)
-	{
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS, true);
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONTACTS, true);
-		pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES, true);
-	}
 }
 
-// Dynamic Rigidbodyの作成
-PxRigidDynamic* createDynamic(const PxTransform& t,
-	const PxGeometry& geometry, PxMaterial& material, PxReal density = 10.0f)
+// PhysXの終了処理
+// PVDをファイルに書き出している場合は、transportの解放で書き出しが完了する
+void cleanupPhysics()
 {
-	PxRigidDynamic* rigid_dynamic
-		= PxCreateDynamic(*gPhysics, t, geometry, material, density);
-	gScene->addActor(*rigid_dynamic);
-	return rigid_dynamic;
+	gAllocator.setPhase(AllocationPhase::eSHUTDOWN);
+	gSnapshot.unload();  // スナップショットのメモリを閉じる前にオブジェクトを解放する
+	if (gScene) {
+		releaseScene(*gScene);
+		gScene = NULL;
+	}
+	releaseCpuDispatcher(gDispatcher, gDispatcherType);
+	PxCloseExtensions();
+	gPhysics->release();
+	if (!gTracePath.empty()) {
+		gProfiler.uninstall();
+		ofstream trace_file(gTracePath);
+		gProfiler.writeChromeTrace(trace_file);
+		cout << "Trace: " << gProfiler.getEventCount() << " events on " << gProfiler.getThreadCount()
+			<< " threads (" << gProfiler.getDroppedCount() << " dropped), written to " << gTracePath << endl;
+	}
+	if (gPvd) {
+		PxPvdTransport* transport = gPvd->getTransport();
+		gPvd->release();
+		transport->release();
+	}
+	gFoundation->release();
+
+	// 解放まで含めた確保の集計(全ての終了経路で表示する)
+	gAllocator.writeSummary(cout);
 }
 
-// Static Rigidbodyの作成
-PxRigidStatic* createStatic(const PxTransform& t,
-	const PxGeometry& geometry, PxMaterial& material)
+// シミュレーションステップを開始する(完了を待たずに戻る)
+// endStepPhysicsまでの間、アクターの読み出しはステップ開始前の状態を返す
+void beginStepPhysics()
 {
-	PxRigidStatic* rigid_static = PxCreateStatic(*gPhysics, t, geometry, material);
-	gScene->addActor(*rigid_static);
-	return rigid_static;
+	const PxReal kElapsedTime = 1.0f / 60.0f; // 60Hz
+	if (gStepMode == StepMode::eSPLIT) {
+		gScene->collide(kElapsedTime);
+		gScene->fetchCollision(true);
+		gScene->advance();
+	}
+	else {
+		gScene->simulate(kElapsedTime);
+	}
 }
 
+// シミュレーションステップの完了をポーリングして待つ
+void endStepPhysics()
+{
+	while (!gScene->fetchResults(false))
+		this_thread::yield();
+}
 
 // シミュレーションステップを進める
 void stepPhysics()
@@ -76,227 +241,1334 @@ void stepPhysics()
 	gScene->fetchResults(true);
 }
 
-void createPitagoraScene()
+// ディスパッチャの種類とワーカースレッド数ごとに、ピタゴラ装置を並べたシーンのステップ時間を計測する
+// scene_cnt: 並べる装置の数
+void benchmarkDispatcher(PxU32 scene_cnt)
+{
+	const PxU32 kStepCnt = 600;
+	const PxU32 kMaxThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
+	const DispatcherType::Enum kTypes[] = { DispatcherType::eDEFAULT, DispatcherType::eWORK_STEALING };
+	const char* kTypeNames[] = { "default", "stealing" };
+
+	cout << "Dispatcher benchmark (" << scene_cnt << " scenes, " << kStepCnt << " steps"
+		<< (gPinWorkerThreads ? ", pinned" : "") << ")" << endl;
+	cout << "dispatcher\tthreads\tstep[ms]\tspeedup\tstolen" << endl;
+	for (size_t t = 0; t != 2; t++) {
+		double base_ms = 0.0;
+		for (PxU32 thread_cnt = 0; ; thread_cnt = PxMin(PxMax(thread_cnt * 2, 1u), kMaxThreadCnt)) {
+			PxCpuDispatcher* dispatcher = createCpuDispatcher(kTypes[t], thread_cnt, gPinWorkerThreads);
+			gScene = createScene(dispatcher);
+
+			// 装置をz方向に並べる
+			PitagoraSceneDesc desc;
+			desc.tile_cnt_z = scene_cnt;
+			vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, desc);
+
+			const chrono::steady_clock::time_point kStart = chrono::steady_clock::now();
+			for (PxU32 step = 0; step != kStepCnt; step++) {
+				updatePitagoraScene(pushers, step);
+				stepPhysics();
+			}
+			const double kStepMs = chrono::duration<double>(chrono::steady_clock::now() - kStart).count()
+				* 1000.0 / kStepCnt;
+			if (thread_cnt == 0)
+				base_ms = kStepMs;
+
+			cout << kTypeNames[t] << "\t" << thread_cnt << "\t"
+				<< fixed << setprecision(3) << kStepMs << "\t"
+				<< setprecision(2) << base_ms / kStepMs << "\t";
+			if (kTypes[t] == DispatcherType::eWORK_STEALING)
+				cout << static_cast<WorkStealingDispatcher*>(dispatcher)->getStolenTaskCount();
+			else
+				cout << "-";
+			cout << endl;
+
+			releaseScene(*gScene);
+			releaseCpuDispatcher(dispatcher, kTypes[t]);
+			if (thread_cnt == kMaxThreadCnt)
+				break;
+		}
+	}
+	gScene = NULL;
+}
+
+// プロセスが確保しているメモリ量(byte)。取得できない環境では0
+size_t getProcessMemoryUsage()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS_EX counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters)))
+		return counters.PrivateUsage;
+	return 0;
+#elif defined(__linux__)
+	// /proc/self/statmの2番目の値(常駐ページ数)
+	ifstream statm("/proc/self/statm");
+	size_t total_pages = 0, resident_pages = 0;
+	statm >> total_pages >> resident_pages;
+	return resident_pages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+// 装置をn x n個並べたシーンを、nを1から倍にしながらmax_tile_cntまで作成し、
+// アクター数、シーン作成時間、ステップ時間、メモリ量を計測する
+// 装置1つの規模はgSceneDesc(--dominoes, --chains, --structure)に従う
+void benchmarkSceneScale(PxU32 max_tile_cnt)
+{
+	const PxU32 kStepCnt = 300;
+	typedef chrono::steady_clock Clock;
+
+	cout << "Scene scale benchmark (dominoes " << gSceneDesc.domino_cnt
+		<< ", chains " << gSceneDesc.chain_cnt
+		<< ", structure " << gSceneDesc.structure_cnt << "^3, "
+		<< kStepCnt << " steps, " << gDispatcher->getWorkerCount() << " threads)" << endl;
+	cout << "tiles\tdynamic\tstatic\tbuild[ms]\tstep[ms]\tmax[ms]\tphysx[MB]\tmemory[MB]" << endl;
+	for (PxU32 n = 1; n <= max_tile_cnt; n *= 2) {
+		const size_t kMemoryBefore = getProcessMemoryUsage();
+		const size_t kPhysxBefore = gAllocator.getLiveBytes();
+
+		const Clock::time_point kBuildStart = Clock::now();
+		gScene = createScene(gDispatcher);
+		PitagoraSceneDesc desc = gSceneDesc;
+		desc.tile_cnt_x = n;
+		desc.tile_cnt_z = n;
+		vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, desc);
+		const double kBuildMs = chrono::duration<double>(Clock::now() - kBuildStart).count() * 1000.0;
+
+		double total_ms = 0.0, max_ms = 0.0;
+		for (PxU32 step = 0; step != kStepCnt; step++) {
+			updatePitagoraScene(pushers, step);
+			const Clock::time_point kStart = Clock::now();
+			stepPhysics();
+			const double kMs = chrono::duration<double>(Clock::now() - kStart).count() * 1000.0;
+			total_ms += kMs;
+			max_ms = PxMax(max_ms, kMs);
+		}
+
+		// シーンの作成とシミュレーションで増えたメモリ量(physxはPhysXが確保している量)
+		const double kPhysxMb = (gAllocator.getLiveBytes() - kPhysxBefore) / (1024.0 * 1024.0);
+		const size_t kMemoryAfter = getProcessMemoryUsage();
+		const double kMemoryMb = (kMemoryAfter > kMemoryBefore ? kMemoryAfter - kMemoryBefore : 0)
+			/ (1024.0 * 1024.0);
+
+		cout << n << "x" << n << "\t"
+			<< gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC) << "\t"
+			<< gScene->getNbActors(PxActorTypeFlag::eRIGID_STATIC) << "\t"
+			<< fixed << setprecision(1) << kBuildMs << "\t"
+			<< setprecision(3) << total_ms / kStepCnt << "\t" << max_ms << "\t"
+			<< setprecision(1) << kPhysxMb << "\t" << kMemoryMb << endl;
+
+		releaseScene(*gScene);
+		gScene = NULL;
+	}
+}
+
+// 装置をn x n個並べたシーンを、nを1から倍にしながらmax_tile_cntまで作成し、
+// 各ステップの後に全ての動的アクターを走査して姿勢を読み出す場合と、
+// ActorStateBufferで動いたアクターのみを読み出す場合の時間を比較する
+// 最後のステップで2つの結果が一致するかも確認する
+void benchmarkStateExtraction(PxU32 max_tile_cnt)
+{
+	const PxU32 kStepCnt = 300;
+	typedef chrono::steady_clock Clock;
+
+	cout << "State extraction benchmark (" << kStepCnt << " steps)" << endl;
+	cout << "tiles\tdynamic\tactive\tfull[us]\tactive[us]\tspeedup\tmismatch" << endl;
+	for (PxU32 n = 1; n <= max_tile_cnt; n *= 2) {
+		gScene = createScene(gDispatcher);
+		PitagoraSceneDesc desc = gSceneDesc;
+		desc.tile_cnt_x = n;
+		desc.tile_cnt_z = n;
+		vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, desc);
+
+		ActorStateBuffer state_buffer;
+		state_buffer.begin(*gScene);
+
+		vector<PxActor*> actors;
+		vector<PxTransform> poses;
+		double full_us = 0.0, active_us = 0.0;
+		PxU64 active_cnt = 0;
+		for (PxU32 step = 0; step != kStepCnt; step++) {
+			updatePitagoraScene(pushers, step);
+			stepPhysics();
+
+			// 全ての動的アクターを走査する
+			const Clock::time_point kFullStart = Clock::now();
+			const PxU32 kActorCnt = gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+			actors.resize(kActorCnt);
+			poses.resize(kActorCnt);
+			gScene->getActors(PxActorTypeFlag::eRIGID_DYNAMIC, actors.data(), kActorCnt);
+			for (PxU32 i = 0; i != kActorCnt; i++)
+				poses[i] = static_cast<PxRigidActor*>(actors[i])->getGlobalPose();
+			const Clock::time_point kActiveStart = Clock::now();
+
+			// 動いたアクターのみを読み出す
+			active_cnt += state_buffer.update();
+			full_us += chrono::duration<double, micro>(kActiveStart - kFullStart).count();
+			active_us += chrono::duration<double, micro>(Clock::now() - kActiveStart).count();
+		}
+
+		// 動いたアクターのみを読み出し続けた結果が、全ての走査と一致するか
+		PxU32 mismatch_cnt = 0;
+		for (size_t i = 0; i != actors.size(); i++) {
+			const PxI32 kIndex = state_buffer.getIndex(*actors[i]);
+			const PxTransform kPose = kIndex < 0 ? PxTransform(PxIdentity) : state_buffer.getPose((PxU32)kIndex);
+			const PxQuat &q = poses[i].q;
+			if (kIndex < 0 || kPose.p != poses[i].p
+				|| kPose.q.x != q.x || kPose.q.y != q.y || kPose.q.z != q.z || kPose.q.w != q.w)
+				mismatch_cnt++;
+		}
+
+		cout << n << "x" << n << "\t" << actors.size() << "\t"
+			<< fixed << setprecision(1) << (double)active_cnt / kStepCnt << "\t"
+			<< setprecision(2) << full_us / kStepCnt << "\t" << active_us / kStepCnt << "\t"
+			<< (active_us > 0.0 ? full_us / active_us : 0.0) << "\t" << mismatch_cnt << endl;
+
+		state_buffer.end();
+		releaseScene(*gScene);
+		gScene = NULL;
+	}
+}
+
+// 装置をn x n個並べたシーンを、nを1から倍にしながらmax_tile_cntまで作成し、
+// SceneQueryBatchによるraycast, sweep, overlapの1秒あたりの数をワーカースレッド数ごとに計測する
+// クエリはシーンの範囲内のランダムな位置から、ランダムな向きに10m調べる
+// ワーカースレッドを使わない場合と結果が一致するかも確認する
+void benchmarkSceneQuery(PxU32 max_tile_cnt)
+{
+	const PxU32 kQueryCnt = 16384;
+	const PxU32 kRepeatCnt = 5;
+	const PxU32 kMaxOverlapHitCnt = 16;
+	const PxReal kDistance = 10.0f;
+	const PxU32 kMaxWorkerCnt = PxMax(thread::hardware_concurrency(), 1u);
+	typedef chrono::steady_clock Clock;
+
+	cout << "Scene query benchmark (" << kQueryCnt << " queries x " << kRepeatCnt << ")" << endl;
+	cout << "tiles\tactors\tworkers\trays/s\tsweeps/s\toverlaps/s\thit[%]\tmismatch" << endl;
+	for (PxU32 n = 1; n <= max_tile_cnt; n *= 2) {
+		gScene = createScene(gDispatcher);
+		PitagoraSceneDesc desc = gSceneDesc;
+		desc.tile_cnt_x = n;
+		desc.tile_cnt_z = n;
+		vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, desc);
+		for (PxU32 step = 0; step != 60; step++) {
+			updatePitagoraScene(pushers, step);
+			stepPhysics();
+		}
+
+		// シーンの範囲
+		const PxActorTypeFlags kTypes = PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
+		vector<PxActor*> actors(gScene->getNbActors(kTypes));
+		gScene->getActors(kTypes, actors.data(), (PxU32)actors.size());
+		PxBounds3 bounds = PxBounds3::empty();
+		for (size_t i = 0; i != actors.size(); i++)
+			bounds.include(actors[i]->getWorldBounds());
+
+		mt19937 random(1);
+		uniform_real_distribution<PxReal> unit(0.0f, 1.0f);
+		vector<RaycastQuery> rays(kQueryCnt);
+		vector<SweepQuery> sweeps(kQueryCnt);
+		vector<PxTransform> poses(kQueryCnt);
+		for (PxU32 i = 0; i != kQueryCnt; i++) {
+			const PxVec3 kOrigin = bounds.minimum + (bounds.maximum - bounds.minimum).multiply(
+				PxVec3(unit(random), unit(random), unit(random)));
+			const PxReal kTheta = unit(random) * PxTwoPi;
+			const PxReal kY = unit(random) * 2.0f - 1.0f;
+			const PxReal kR = PxSqrt(1.0f - kY * kY);
+			const PxVec3 kDir(kR * PxCos(kTheta), kY, kR * PxSin(kTheta));
+			rays[i].origin = kOrigin;
+			rays[i].unit_dir = kDir;
+			rays[i].distance = kDistance;
+			sweeps[i].pose = PxTransform(kOrigin);
+			sweeps[i].unit_dir = kDir;
+			sweeps[i].distance = kDistance;
+			poses[i] = PxTransform(kOrigin);
+		}
+		const PxSphereGeometry kSweepGeometry(0.1f);
+		const PxSphereGeometry kOverlapGeometry(0.5f);
+
+		vector<QueryHit> hits(kQueryCnt), reference_hits;
+		vector<PxOverlapHit> overlap_hits(kQueryCnt * kMaxOverlapHitCnt);
+		vector<PxU32> hit_cnts(kQueryCnt), reference_hit_cnts;
+		for (PxU32 worker_cnt = 0; ; worker_cnt = PxMin(PxMax(worker_cnt * 2, 1u), kMaxWorkerCnt)) {
+			PxCpuDispatcher* dispatcher = createCpuDispatcher(gDispatcherType, worker_cnt, gPinWorkerThreads);
+			double seconds[3] = {};
+			PxU32 ray_hit_cnt = 0;
+			{
+				SceneQueryBatch batch(*dispatcher);
+				for (PxU32 r = 0; r != kRepeatCnt; r++) {
+					const Clock::time_point kRayStart = Clock::now();
+					ray_hit_cnt = batch.raycast(*gScene, rays.data(), kQueryCnt, hits.data());
+					const Clock::time_point kSweepStart = Clock::now();
+					batch.sweep(*gScene, kSweepGeometry, sweeps.data(), kQueryCnt, hits.data());
+					const Clock::time_point kOverlapStart = Clock::now();
+					batch.overlap(*gScene, kOverlapGeometry, poses.data(), kQueryCnt,
+						overlap_hits.data(), kMaxOverlapHitCnt, hit_cnts.data());
+					const Clock::time_point kEnd = Clock::now();
+					seconds[0] += chrono::duration<double>(kSweepStart - kRayStart).count();
+					seconds[1] += chrono::duration<double>(kOverlapStart - kSweepStart).count();
+					seconds[2] += chrono::duration<double>(kEnd - kOverlapStart).count();
+				}
+			}
+			releaseCpuDispatcher(dispatcher, gDispatcherType);
+
+			// sweepとoverlapの結果をワーカーを使わない場合と比較する
+			PxU32 mismatch_cnt = 0;
+			if (worker_cnt == 0) {
+				reference_hits = hits;
+				reference_hit_cnts = hit_cnts;
+			}
+			for (PxU32 i = 0; i != kQueryCnt; i++) {
+				if (hits[i].actor != reference_hits[i].actor || hits[i].distance != reference_hits[i].distance
+					|| hit_cnts[i] != reference_hit_cnts[i])
+					mismatch_cnt++;
+			}
+
+			const double kQueryTotal = (double)kQueryCnt * kRepeatCnt;
+			cout << n << "x" << n << "\t" << actors.size() << "\t" << worker_cnt << "\t"
+				<< fixed << setprecision(0) << kQueryTotal / seconds[0] << "\t"
+				<< kQueryTotal / seconds[1] << "\t" << kQueryTotal / seconds[2] << "\t"
+				<< setprecision(1) << 100.0 * ray_hit_cnt / kQueryCnt << "\t" << mismatch_cnt << endl;
+			if (worker_cnt == kMaxWorkerCnt)
+				break;
+		}
+
+		releaseScene(*gScene);
+		gScene = NULL;
+	}
+}
+
+// 1フレーム(1/60秒)を分割するsubstep数と、振り子のposition iteration countの組み合わせごとに
+// 10秒間シミュレーションし、振り子のjointのずれとフレームあたりのCPU時間を比較する
+// 装置の規模と数はgSceneDescに従う
+void benchmarkSubsteps()
 {
-	// 静摩擦係数、動摩擦係数、反発係数の順
-	PxMaterial* material = gPhysics->createMaterial(0.5f, 0.5f, 0.6f);
-
-	////// ピタゴラ装置のフィールドを作成(static rigid body)
-	// base plate(12m x 0.2m x 10m)
-	const PxVec3 kPlateHalf(6.0f, 0.1f, 5.0f);
-	createStatic(PxTransform(PxVec3(kPlateHalf.x, 0.0f, kPlateHalf.z)),
-		PxBoxGeometry(kPlateHalf), *material);
-
-	// 段差0
-	const PxVec3 kStepHalf0(2.0f, 0.5f, 5.0f);
-	createStatic(PxTransform(
-		PxVec3(
-			kPlateHalf.x * 2 - kStepHalf0.x,
-			kPlateHalf.y + kStepHalf0.y,
-			kStepHalf0.z)
-	), PxBoxGeometry(kStepHalf0), *material);
-
-	// 段差1
-	const PxVec3 kStepHalf1(4.0f, 0.5f, 1.0f);
-	createStatic(PxTransform(
-		PxVec3(
-			kStepHalf1.x,
-			kPlateHalf.y + kStepHalf1.y,
-			kStepHalf1.z)
-	), PxBoxGeometry(kStepHalf1), *material);
-
-	// 段差2
-	const PxVec3 kStepHalf2(0.3f, 0.5f, 1.0f);
-	createStatic(PxTransform(
-		PxVec3(
-			kStepHalf2.x,
-			kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y,
-			kStepHalf2.z)
-	), PxBoxGeometry(kStepHalf2), *material);
-
-	// slope
-	const PxVec3 kSlopeHalf(3.7f, 0.1f, 1.0f);
-	const PxReal kSlopeAngle = -PxPi / 36.0f; // 5 degree
-	createStatic(PxTransform(
-		PxVec3(
-			kStepHalf2.x * 2 + kSlopeHalf.x,
-			kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y,
-			kSlopeHalf.z),
-		PxQuat(kSlopeAngle, PxVec3(0.0f, 0.0f, 1.0f))
-	), PxBoxGeometry(kSlopeHalf), *material);
-
-	////// 球を作成(dynamic rigid body)
-	const PxReal kSphereR = 0.25f;
-	PxRigidDynamic* sphere = createDynamic(
-		PxTransform(
-			PxVec3(
-				kSphereR,
-				kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y * 2 + kSphereR,
-				kStepHalf2.z)
-		), PxSphereGeometry(kSphereR), *material);
-
-	///// 球を押す剛体を作成(kinematic actor)
-	const PxVec3 kPusherHalf(0.5f, 0.05f, 0.2f);
-	gPusher = createDynamic(PxTransform(
-		PxVec3(
-			-kPusherHalf.x * 1.5,
-			kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y * 2 + kSphereR,
-			kStepHalf1.z)
-	), PxBoxGeometry(kPusherHalf), *material);
-	gPusher->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, true);
-
-	///// ドミノを作成
-	const PxU32 kDominoCnt = 20;
-	const PxBoxGeometry kDominoGeometry(0.05f, 0.5f, 0.2f);
-	const PxReal kCircleR = kStepHalf0.x * 1.5f;
-	const PxVec3 kCircleCenter(
-		kStepHalf1.x * 2 + kDominoGeometry.halfExtents.x,
-		kPlateHalf.y + kStepHalf0.y * 2 + kDominoGeometry.halfExtents.y,
-		kCircleR + kStepHalf1.z);
-	const PxReal kSplitAngle = PxPi / (kDominoCnt + 1);
-
-	for (PxU32 i = 0; i != kDominoCnt; i++) {
-		const PxVec3 dominoPos = kCircleCenter
-			+ kCircleR * PxVec3(PxSin(kSplitAngle*i), 0.0f, -PxCos(kSplitAngle*i));
-
-		createDynamic(
-			PxTransform(dominoPos, PxQuat(-kSplitAngle * i, PxVec3(0.0f, 1.0f, 0.0f))),
-			kDominoGeometry, *material);
-	}
-
-	///// 振り子を作成
-	const PxVec3 kChainCenter
-		= kCircleCenter + kCircleR * PxVec3(0.0f, 0.0f, 1.0f) + PxVec3(-3.0f, 0.0f, 0.0f);
-	const PxReal kChainLength = 5.0f;
-	const PxU32 kChainCnt = 18;
-	const PxReal kHookHalfHeight = 0.1f;
-	const PxReal kElementR = 0.15f;
-	const PxReal kLastElementR = kElementR * 3.0f;
-	const PxReal kChainAngle = PxPi / 6.0f; // 30 degree
-
-	// 振り子のフックを作成(static rigid body)
-	PxRigidActor* chain_hook = createStatic(
-		PxTransform(kChainCenter + PxVec3(0, kChainLength, 0)),
-		PxBoxGeometry(0.5f, kHookHalfHeight, 0.1f), *material);
-
-	PxRigidActor *actor0, *actor1;
-	actor0 = chain_hook;
-	for (PxU32 i = 0; i != kChainCnt; i++) {
-		PxReal elementPosFromHook;
-		PxSphereGeometry sphere;
-		if (i < kChainCnt - 1) {
-			elementPosFromHook = (kHookHalfHeight + kElementR) + (kElementR * 2)*i;
-			sphere = PxSphereGeometry(kElementR);
-		}
-		else { // 最後の要素の半径を大きく
-			elementPosFromHook = (kHookHalfHeight + kElementR)
-				+ (kElementR * 2) * (i - 1) + (kElementR + kLastElementR);
-			sphere = PxSphereGeometry(kLastElementR);
-		}
-
-		PxVec3 elementPos = kChainCenter
-			+ PxVec3(
-				elementPosFromHook * PxSin(kChainAngle),
-				kChainLength - elementPosFromHook * PxCos(kChainAngle),
-				0.0f);
-
-		PxRigidDynamic* element = createDynamic(PxTransform(
-			elementPos,
-			PxQuat(
-				PxHalfPi,
-				PxVec3(0.0f, 0.0f, 1.0f)) * PxQuat(kChainAngle, PxVec3(0.0f, 0.0f, 1.0f))
-		), sphere, *material, 1.0f);
-
-		//position iteration countの設定
-		element->setSolverIterationCounts(64, 1);
-		element->putToSleep();  // actorをスリープさせる
-		actor1 = element;
-
-		PxReal jointPosFromHook = kHookHalfHeight + (kElementR * 2) * i;
-		PxVec3 jointPos = kChainCenter
-			+ PxVec3(
-				jointPosFromHook * PxSin(kChainAngle),
-				kChainLength - jointPosFromHook * PxCos(kChainAngle),
-				0.0f);
-
-		PxSphericalJoint* joint = PxSphericalJointCreate(
-			*gPhysics,
-			actor0,
-			PxTransform(
-				actor0->getGlobalPose().q.rotateInv(
-					PxVec3(jointPos - actor0->getGlobalPose().p)
-				),
-				PxQuat(-PxHalfPi, PxVec3(0.0f, 0.0f, 1.0f))),
-			actor1,
-			PxTransform(
-				actor1->getGlobalPose().q.rotateInv(
-					PxVec3(jointPos - actor1->getGlobalPose().p)
-				),
-				PxQuat(-PxHalfPi, PxVec3(0.0f, 0.0f, 1.0f)))
-		);
-		actor0 = element;
-	}
-
-	///// 構造物を作成
-	const PxVec3 kStructureCenter
-		= PxVec3(kChainCenter.x, kPlateHalf.y, kChainCenter.z)
-		+ PxVec3(-3.0f, 0.0f, -1.25f);  // オフセット
-	const PxU32 kStructureCnt = 7;
-	const PxReal kStructureLength = 0.2f;
-
-	for (PxU32 x = 0; x != kStructureCnt; x++) {
-		for (PxU32 y = 0; y != kStructureCnt; y++) {
-			for (PxU32 z = 0; z != kStructureCnt; z++) {
-				const PxVec3 kElementPos = kStructureCenter
-					+ PxVec3(
-						kStructureLength * 2 * x,
-						kStructureLength + kStructureLength * 2 * y,
-						kStructureLength * 2 * z);
-
-				PxRigidDynamic* element = createDynamic(
-					PxTransform(kElementPos),
-					PxBoxGeometry(kStructureLength, kStructureLength, kStructureLength),
-					*material, 0.01f); // 壊れやすくするために軽くする
-
-				element->putToSleep();
+	const PxU32 kFrameCnt = 600;
+	const PxU32 kSubstepCnts[] = { 1, 2, 4, 8 };
+	const PxU32 kIterations[] = { 4, 16, 64 };
+
+	cout << "Substep benchmark (" << gSceneDesc.tile_cnt_x << "x" << gSceneDesc.tile_cnt_z << " tiles, "
+		<< kFrameCnt << " frames)" << endl;
+	cout << "substeps\titerations\tframe[ms]\tmax_error[mm]\tmean_error[mm]" << endl;
+	for (PxU32 s = 0; s != sizeof(kSubstepCnts) / sizeof(kSubstepCnts[0]); s++) {
+		for (PxU32 it = 0; it != sizeof(kIterations) / sizeof(kIterations[0]); it++) {
+			gScene = createScene(gDispatcher);
+			PitagoraSceneDesc desc = gSceneDesc;
+			desc.chain_position_iterations = kIterations[it];
+			const vector<PxRigidDynamic*> kPushers = createPitagoraScene(*gPhysics, *gScene, desc);
+
+			StepController controller(*gScene, 1.0f / 60.0f, kSubstepCnts[s], kSubstepCnts[s]);
+			controller.setPreStepCallback([&](double time, PxReal step_time) {
+				updatePitagoraScene(kPushers, time, step_time);
+			});
+
+			JointDrift drift;
+			for (PxU32 frame = 0; frame != kFrameCnt; frame++) {
+				controller.stepFrame();
+				measureJointDrift(*gScene, drift);
 			}
+
+			cout << kSubstepCnts[s] << "\t" << kIterations[it] << "\t"
+				<< fixed << setprecision(3) << controller.getStepCpuTime() * 1000.0 / kFrameCnt << "\t"
+				<< setprecision(2) << drift.max_error * 1000.0f << "\t" << drift.getMeanError() * 1000.0f << endl;
+
+			releaseScene(*gScene);
+			gScene = NULL;
 		}
 	}
 }
 
-int main(void)
+// 構造物を箱ごとのアクターで作った場合と、1つのアクターにしてFractureCompoundで分ける場合を比較する
+// 振り子が構造物に当たるまでと当たった後のステップ時間(箱を分ける時間を含む)、動的アクター数、分けた箱の数、
+// 最初の位置から動いた箱の数を表示する。動いた箱の数が近ければ、壊れ方も同じくらいと見なせる
+// 装置の規模と数はgSceneDescに従う
+void benchmarkFracture()
 {
+	const PxU32 kStepCnt = 1000;
+	const PxReal kMovedDistance = 0.05f;  // これより動いた箱を数える
+	const char* kModeNames[] = { "boxes", "compound" };
+
+	cout << "Fracture benchmark (" << gSceneDesc.tile_cnt_x << "x" << gSceneDesc.tile_cnt_z << " tiles, "
+		<< kStepCnt << " steps)" << endl;
+	cout << "structure\thit_step\tbefore[ms]\tafter[ms]\tdynamic_start\tdynamic_end\tsplit_pieces\tmoved" << endl;
+	for (PxU32 mode = 0; mode != 2; mode++) {
+		SimulationEventRecorder event_recorder;
+		gScene = createScene(gDispatcher, &event_recorder);
+		PitagoraSceneDesc desc = gSceneDesc;
+		desc.fracture_structure = mode == 1;
+		vector<PxRigidDynamic*> structures;
+		const vector<PxRigidDynamic*> kPushers = createPitagoraScene(*gPhysics, *gScene, desc, NULL, &structures);
+		vector<FractureCompound> fractures;
+		for (size_t i = 0; i != structures.size(); i++) {
+			fractures.push_back(FractureCompound(*structures[i], kStructureDensity,
+				kStructureFractureImpulse, kStructureFractureRadius, 1.0f / 60.0f));
+		}
+		const PxU32 kDynamicStartCnt = gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+
+		// 箱ごとのアクターの場合は、構造物のグループのアクターの最初の位置を覚えておく
+		vector<PxRigidActor*> boxes;
+		vector<PxVec3> box_positions;
+		if (!desc.fracture_structure) {
+			const vector<PxActor*> kActors = getSceneActors(*gScene, PxActorTypeFlag::eRIGID_DYNAMIC);
+			for (size_t i = 0; i != kActors.size(); i++) {
+				PxRigidActor* actor = static_cast<PxRigidActor*>(kActors[i]);
+				PxShape* shape;
+				if (actor->getShapes(&shape, 1) && shape->getSimulationFilterData().word0 == PitagoraGroup::eSTRUCTURE) {
+					boxes.push_back(actor);
+					box_positions.push_back(actor->getGlobalPose().p);
+				}
+			}
+		}
+
+		vector<SimulationEvent> events;
+		PxI32 hit_step = -1;  // 振り子が最初に構造物に当たったステップ
+		double time_before = 0.0, time_after = 0.0;
+		PxU32 split_cnt = 0;
+		for (PxU32 step = 0; step != kStepCnt; step++) {
+			updatePitagoraScene(kPushers, step);
+			event_recorder.setStep(step);
+
+			const chrono::steady_clock::time_point kStart = chrono::steady_clock::now();
+			stepPhysics();
+			events.clear();
+			event_recorder.drain(events);
+			for (size_t i = 0; i != events.size(); i++) {
+				for (size_t f = 0; f != fractures.size(); f++)
+					fractures[f].onContact(events[i]);
+				const PxU32 kGroups = events[i].groups[0] | events[i].groups[1];
+				if (hit_step < 0 && events[i].type == SimulationEventType::eCONTACT
+					&& kGroups == (PitagoraGroup::ePENDULUM | PitagoraGroup::eSTRUCTURE))
+					hit_step = (PxI32)step;
+			}
+			for (size_t f = 0; f != fractures.size(); f++)
+				split_cnt += fractures[f].update(*gPhysics, *gScene);
+			const double kTime = chrono::duration<double>(chrono::steady_clock::now() - kStart).count();
+			(hit_step < 0 ? time_before : time_after) += kTime;
+		}
+
+		PxU32 moved_cnt = 0;
+		for (size_t i = 0; i != boxes.size(); i++) {
+			if ((boxes[i]->getGlobalPose().p - box_positions[i]).magnitude() > kMovedDistance)
+				moved_cnt++;
+		}
+		for (size_t f = 0; f != fractures.size(); f++)
+			moved_cnt += fractures[f].getMovedPieceCount(kMovedDistance);
+
+		const PxU32 kBeforeCnt = hit_step < 0 ? kStepCnt : (PxU32)hit_step;
+		cout << kModeNames[mode] << "\t" << hit_step << "\t"
+			<< fixed << setprecision(3) << (kBeforeCnt ? time_before * 1000.0 / kBeforeCnt : 0.0) << "\t"
+			<< (kBeforeCnt != kStepCnt ? time_after * 1000.0 / (kStepCnt - kBeforeCnt) : 0.0) << "\t"
+			<< kDynamicStartCnt << "\t" << gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC) << "\t"
+			<< split_cnt << "\t" << moved_cnt << defaultfloat << endl;
+
+		releaseScene(*gScene);
+		gScene = NULL;
+	}
+}
+
+// 要素数の違う鎖を、jointでつないだもの(maximal coordinate)とarticulation(reduced coordinate)で作り、
+// 鉛直から60度傾けた位置から10秒間振らせて、フレームあたりのCPU時間とjointのずれを比較する
+// 64要素を超える鎖は複数のarticulationをjointでつないで作る
+void benchmarkChains()
+{
+	const PxU32 kFrameCnt = 600;
+	const PxU32 kLinkCnts[] = { 18, 64, 256 };
+	struct Variant {
+		const char* name;
+		ChainType::Enum type;
+		PxU32 position_iterations;
+	};
+	const Variant kVariants[] = {
+		{ "joint", ChainType::eJOINT, 64 },  // 元の振り子の設定
+		{ "joint", ChainType::eJOINT, 4 },
+		{ "articulation", ChainType::eARTICULATION, 4 },
+	};
+	const PxReal kChainAngle = PxPi / 3.0f;
+
+	cout << "Chain benchmark (" << kFrameCnt << " frames)" << endl;
+	cout << "links\ttype\titerations\tarticulations\tframe[ms]\tmax_error[mm]\tmean_error[mm]" << endl;
+	for (PxU32 l = 0; l != sizeof(kLinkCnts) / sizeof(kLinkCnts[0]); l++) {
+		for (PxU32 v = 0; v != sizeof(kVariants) / sizeof(kVariants[0]); v++) {
+			gScene = createScene(gDispatcher);
+			PxMaterial* material = gPhysics->createMaterial(0.5f, 0.5f, 0.6f);
+
+			ChainDesc desc;
+			desc.type = kVariants[v].type;
+			desc.link_cnt = kLinkCnts[l];
+			desc.last_link_r = desc.link_r * 3.0f;
+			desc.position_iterations = kVariants[v].position_iterations;
+			desc.hook_pose = PxTransform(PxVec3(0.0f, desc.link_r * 2 * desc.link_cnt + 1.0f, 0.0f));
+			desc.direction = PxVec3(PxSin(kChainAngle), -PxCos(kChainAngle), 0.0f);
+			desc.anchor = desc.hook_pose.p + desc.direction * desc.hook_geometry.halfExtents.y;
+			Chain chain;
+			{
+				SceneBuilder builder(*gPhysics, *gScene, true);
+				chain = createChain(*gPhysics, builder, desc, *material);
+			}
+
+			StepController controller(*gScene, 1.0f / 60.0f, 1, 1);
+			JointDrift drift;
+			for (PxU32 frame = 0; frame != kFrameCnt; frame++) {
+				controller.stepFrame();
+				measureJointDrift(*gScene, drift);
+			}
+
+			cout << kLinkCnts[l] << "\t" << kVariants[v].name << "\t" << kVariants[v].position_iterations << "\t"
+				<< chain.articulations.size() << "\t"
+				<< fixed << setprecision(3) << controller.getStepCpuTime() * 1000.0 / kFrameCnt << "\t"
+				<< setprecision(2) << drift.max_error * 1000.0f << "\t" << drift.getMeanError() * 1000.0f << endl;
+
+			releaseScene(*gScene);
+			gScene = NULL;
+			material->release();
+		}
+	}
+}
+
+// 実時間に合わせてseconds秒間シミュレーションする
+// 表示側のフレーム(約120Hz)ごとに経過時間をStepControllerに渡し、固定ステップの間の姿勢を補間する
+// 1秒ごとに表示側のフレーム数、ステップ数、補間した最初の装置の球の高さを表示する
+void runRealtime(PxReal seconds, PxU32 substep_cnt)
+{
+	typedef chrono::steady_clock Clock;
+
+	gScene = createScene(gDispatcher);
+	vector<PxRigidDynamic*> balls;
+	const vector<PxRigidDynamic*> kPushers = createPitagoraScene(*gPhysics, *gScene, gSceneDesc, &balls);
+
+	ActorStateBuffer state_buffer;
+	state_buffer.begin(*gScene);
+	const PxI32 kBallIndex = state_buffer.getIndex(*balls[0]);
+
+	// 追いつけない場合も、1回に進めるのは4フレーム分まで
+	StepController controller(*gScene, 1.0f / 60.0f, substep_cnt, 4 * substep_cnt, &state_buffer);
+	controller.setPreStepCallback([&](double time, PxReal step_time) {
+		updatePitagoraScene(kPushers, time, step_time);
+	});
+
+	cout << "Realtime (" << substep_cnt << " substeps, step " << controller.getStepTime() * 1000.0f << " ms)" << endl;
+	cout << "time[s]\tframes\tsteps\tball_y[m]" << endl;
+	const Clock::time_point kStart = Clock::now();
+	Clock::time_point last = kStart;
+	PxU32 frame_cnt = 0, reported_second = 0;
+	while (true) {
+		const Clock::time_point kNow = Clock::now();
+		const double kTime = chrono::duration<double>(kNow - kStart).count();
+		if (kTime >= seconds)
+			break;
+
+		controller.advance(chrono::duration<double>(kNow - last).count());
+		last = kNow;
+		frame_cnt++;
+
+		if ((PxU32)kTime != reported_second) {
+			reported_second = (PxU32)kTime;
+			const PxReal kBallY = kBallIndex < 0 ? 0.0f
+				: state_buffer.getInterpolatedPose((PxU32)kBallIndex, controller.getInterpolationAlpha()).p.y;
+			cout << reported_second << "\t" << frame_cnt << "\t" << controller.getStepCount() << "\t"
+				<< fixed << setprecision(3) << kBallY << defaultfloat << endl;
+		}
+		this_thread::sleep_for(chrono::microseconds(8333));
+	}
+
+	cout << "simulated " << controller.getSimulationTime() << " s in " << seconds << " s, "
+		<< "dropped " << controller.getDroppedTime() << " s, "
+		<< "step cpu " << controller.getStepCpuTime() * 1000.0 / PxMax(controller.getStepCount(), (PxU64)1) << " ms" << endl;
+
+	state_buffer.end();
+	releaseScene(*gScene);
+	gScene = NULL;
+}
+
+// sceneのアクター(articulationのリンクを含む)に付いているshapeの数(共有しているshapeは1つと数える)
+PxU32 countSceneShapes(PxScene &scene)
+{
+	const vector<PxActor*> kActors
+		= getSceneActors(scene, PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC);
+	vector<PxShape*> shapes;
+	vector<PxShape*> actor_shapes;
+	for (size_t i = 0; i != kActors.size(); i++) {
+		const PxRigidActor* actor = static_cast<const PxRigidActor*>(kActors[i]);
+		actor_shapes.resize(actor->getNbShapes());
+		actor->getShapes(actor_shapes.data(), (PxU32)actor_shapes.size());
+		shapes.insert(shapes.end(), actor_shapes.begin(), actor_shapes.end());
+	}
+	sort(shapes.begin(), shapes.end());
+	return (PxU32)(unique(shapes.begin(), shapes.end()) - shapes.begin());
+}
+
+// シーンの作成方法ごとに、shape数、シーンの作成時間、ステップ時間、PhysXのメモリ量を比較する
+//  per-actor: アクターを1つずつシーンに追加し、アクターごとにshapeを作成する
+//  batched  : アクターをまとめて追加し、振り子と構造物をPxAggregateにする
+//  shared   : batchedに加えて、同じ形のアクターでshapeを共有する
+// 装置の規模と数はgSceneDescに従う
+void benchmarkSceneBuild()
+{
+	const PxU32 kStepCnt = 300;
+	typedef chrono::steady_clock Clock;
+
+	cout << "Scene build benchmark (" << gSceneDesc.tile_cnt_x << "x" << gSceneDesc.tile_cnt_z << " tiles, "
+		<< kStepCnt << " steps, " << gDispatcher->getWorkerCount() << " threads)" << endl;
+	cout << "build\tactors\tshapes\taggregates\tbuild[ms]\tstep[ms]\tphysx[MB]" << endl;
+	const char* kModeNames[] = { "per-actor", "batched", "shared" };
+	for (int mode = 0; mode != 3; mode++) {
+		const size_t kPhysxBefore = gAllocator.getLiveBytes();
+		const Clock::time_point kBuildStart = Clock::now();
+		gScene = createScene(gDispatcher);
+		PitagoraSceneDesc desc = gSceneDesc;
+		desc.batched = mode != 0;
+		desc.shared_shapes = mode == 2;
+		vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, desc);
+		const double kBuildMs = chrono::duration<double>(Clock::now() - kBuildStart).count() * 1000.0;
+
+		const Clock::time_point kStepStart = Clock::now();
+		for (PxU32 step = 0; step != kStepCnt; step++) {
+			updatePitagoraScene(pushers, step);
+			stepPhysics();
+		}
+		const double kStepMs = chrono::duration<double>(Clock::now() - kStepStart).count() * 1000.0 / kStepCnt;
+		const double kPhysxMb = (gAllocator.getLiveBytes() - kPhysxBefore) / (1024.0 * 1024.0);
+
+		cout << kModeNames[mode] << "\t"
+			<< gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC) << "\t"
+			<< countSceneShapes(*gScene) << "\t"
+			<< gScene->getNbAggregates() << "\t"
+			<< fixed << setprecision(1) << kBuildMs << "\t"
+			<< setprecision(3) << kStepMs << "\t"
+			<< setprecision(1) << kPhysxMb << endl;
+
+		releaseScene(*gScene);
+		gScene = NULL;
+	}
+}
+
+// シーンを手続き的に作成する場合と、スナップショットから読み込む場合の起動時間を比較する
+// 装置の規模と数はgSceneDescに従う。スナップショットはfile_pathに書き出す
+void benchmarkSnapshot(const string &file_path)
+{
+	typedef chrono::steady_clock Clock;
+	cout << "Snapshot benchmark (" << gSceneDesc.tile_cnt_x << "x" << gSceneDesc.tile_cnt_z << " tiles)" << endl;
+
+	// 手続き的に作成して保存する
+	Clock::time_point start = Clock::now();
+	gScene = createScene(gDispatcher);
+	vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, gSceneDesc);
+	const double kBuildMs = chrono::duration<double>(Clock::now() - start).count() * 1000.0;
+	const PxU32 kActorCnt = gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC);
+	const PxU32 kConstraintCnt = gScene->getNbConstraints();
+
+	start = Clock::now();
+	if (!SceneSnapshot::save(*gPhysics, *gScene, pushers, file_path)) {
+		cerr << "Failed to save snapshot: " << file_path << endl;
+		releaseScene(*gScene);
+		gScene = NULL;
+		return;
+	}
+	const double kSaveMs = chrono::duration<double>(Clock::now() - start).count() * 1000.0;
+	releaseScene(*gScene);
+
+	cout << "source\tactors\tjoints\tpushers\ttime[ms]" << endl;
+	cout << "build\t" << kActorCnt << "\t" << kConstraintCnt << "\t" << pushers.size() << "\t"
+		<< fixed << setprecision(1) << kBuildMs << endl;
+
+	// メモリマップと、バッファへの読み込みで読み込む
+	const char* kLoadNames[] = { "buffer", "mapped" };
+	for (int mapped = 0; mapped != 2; mapped++) {
+		SceneSnapshot snapshot;
+		start = Clock::now();
+		gScene = createScene(gDispatcher);
+		const bool kLoaded = snapshot.load(*gPhysics, *gScene, file_path, pushers, mapped != 0);
+		const double kLoadMs = chrono::duration<double>(Clock::now() - start).count() * 1000.0;
+		if (kLoaded) {
+			cout << kLoadNames[mapped] << "\t"
+				<< gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC) << "\t"
+				<< gScene->getNbConstraints() << "\t" << pushers.size() << "\t" << kLoadMs << endl;
+		}
+		else {
+			cerr << "Failed to load snapshot: " << file_path << endl;
+		}
+		snapshot.unload();
+		releaseScene(*gScene);
+	}
+	gScene = NULL;
+	cout << "save: " << kSaveMs << " ms" << endl;
+}
+
+// チェックポイントから再開した実行が、連続した実行と許容誤差内で一致するかを確認する
+// 球を押す区間を含むkCheckpointStepで保存し、復元せずにそのままkResumeStepCntステップ進めた位置を基準とする
+// その後チェックポイントに戻して同じステップ数を進めることをkForkCnt回繰り返し、基準との差を調べる
+bool verifyCheckpoint()
+{
+	const PxU32 kCheckpointStep = 200;
+	const PxU32 kResumeStepCnt = 100;
+	const PxU32 kForkCnt = 3;
+	const PxReal kTolerance = 0.01f;  // 位置の許容誤差[m]
+
+	gScene = createScene(gDispatcher);
+	vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, gSceneDesc);
+	// articulationのリンク(--chain-type articulationの振り子)も比べる
+	const vector<PxActor*> kActors = getSceneActors(*gScene, PxActorTypeFlag::eRIGID_DYNAMIC);
+	const PxU32 kActorCnt = (PxU32)kActors.size();
+	auto get_positions = [&]() {
+		vector<PxVec3> positions(kActorCnt);
+		for (PxU32 i = 0; i != kActorCnt; i++)
+			positions[i] = static_cast<PxRigidActor*>(kActors[i])->getGlobalPose().p;
+		return positions;
+	};
+	auto run = [&](PxU32 begin, PxU32 end) {
+		for (PxU32 step = begin; step != end; step++) {
+			updatePitagoraScene(pushers, step);
+			stepPhysics();
+		}
+	};
+
+	// 連続した実行(保存するだけで復元しない)
+	run(0, kCheckpointStep);
+	SceneCheckpoint checkpoint;
+	checkpoint.capture(*gScene, kCheckpointStep);
+	run(checkpoint.getStep(), checkpoint.getStep() + kResumeStepCnt);
+	const vector<PxVec3> kReference = get_positions();
+
+	// 復元した直後の速度・スリープ状態・wake counterが保存した値と一致すること
+	bool restored = checkpoint.restore();
+	bool passed = checkpoint.matches();
+	cout << "Checkpoint at step " << kCheckpointStep << " (" << checkpoint.getActorCount() << " actors, "
+		<< checkpoint.getArticulationCount() << " articulations)" << endl;
+	cout << "\timmediate restore: " << (passed ? "identical" : "changed") << endl;
+
+	// チェックポイントから再開した実行(最初の実行は上で復元した状態から始める)
+	for (PxU32 fork = 0; fork != kForkCnt; fork++) {
+		if (fork != 0)
+			restored = checkpoint.restore();
+		run(checkpoint.getStep(), checkpoint.getStep() + kResumeStepCnt);
+		const vector<PxVec3> kPositions = get_positions();
+
+		PxReal max_error = 0.0f;
+		double total_error = 0.0;
+		for (PxU32 i = 0; i != kActorCnt; i++) {
+			const PxReal kError = (kPositions[i] - kReference[i]).magnitude();
+			max_error = PxMax(max_error, kError);
+			total_error += kError;
+		}
+		const bool kPassed = restored && max_error <= kTolerance;
+		passed = passed && kPassed;
+		cout << "\tfork " << fork << ": max error " << max_error << " m, mean error "
+			<< total_error / PxMax(kActorCnt, 1u) << " m after " << kResumeStepCnt << " steps"
+			<< (restored ? "" : " (broken joints)") << (kPassed ? "" : " FAILED") << endl;
+	}
+	cout << (passed ? "OK" : "FAILED") << " (tolerance " << kTolerance << " m)" << endl;
+
+	checkpoint.clear();
+	releaseScene(*gScene);
+	gScene = NULL;
+	return passed;
+}
+
+// "4x2"または"4"(4x4)の形式で装置を並べる数を指定する
+void parseTileCount(const string &text, PitagoraSceneDesc &desc)
+{
+	const size_t kSeparator = text.find('x');
+	desc.tile_cnt_x = PxMax(atoi(text.c_str()), 1);
+	desc.tile_cnt_z = kSeparator == string::npos
+		? desc.tile_cnt_x : PxMax(atoi(text.c_str() + kSeparator + 1), 1);
+}
+
+// STL書き出しのスレッド数によるスケーリングを計測する
+// シーン内のアクターを10000個以上になるまで複製し、1ファイルにまとめて書き出す
+// 計測したexportで作業領域を拡張していた場合は、計測に確保が含まれるのでfalseを返す
+bool benchmarkStlOutput(const string &output_path)
+{
+	PxActorTypeFlags desired_types
+		= PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
+	const vector<PxActor*> scene_actors = getSceneActors(*gScene, desired_types);
+
+	const size_t kMinActorCnt = 10000;
+	vector<PxActor*> actors;
+	while (actors.size() < kMinActorCnt)
+		actors.insert(actors.end(), scene_actors.begin(), scene_actors.end());
+
+	const PxU32 kMaxThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
+	const StlFormat::Enum kFormats[] = { StlFormat::eBINARY, StlFormat::eASCII };
+	vector<StlOutputStats> results;
+
+	StlOutput stl_output;
+	for (size_t f = 0; f != 2; f++) {
+		// 1周目はバッファ確保とスレッドの起動を含むので計測から除く
+		// シングルスレッドは1ファイル分のバッファ、並列ではチャンクのバッファを使うので、全てのスレッド数で1回ずつ書き出す
+		for (size_t pass = 0; pass != 2; pass++) {
+			for (PxU32 thread_cnt = 1; ; thread_cnt = PxMin(thread_cnt * 2, kMaxThreadCnt)) {
+				const StlOutputStats kStats = stl_output.outputStl(
+					output_path, actors.data(), (PxU32)actors.size(), false, kFormats[f], thread_cnt);
+				if (pass != 0)
+					results.push_back(kStats);
+				if (thread_cnt == kMaxThreadCnt)
+					break;
+			}
+		}
+	}
+
+	cout << "STL output benchmark (" << actors.size() << " actors)" << endl;
+	cout << "format\tthreads\ttime[ms]\tMB/s\tspeedup" << endl;
+	double base_seconds = 0.0;
+	for (size_t i = 0; i != results.size(); i++) {
+		const StlOutputStats &r = results[i];
+		if (r.thread_cnt == 1)
+			base_seconds = r.seconds;
+		cout << (i < results.size() / 2 ? "binary" : "ascii") << "\t" << r.thread_cnt << "\t"
+			<< fixed << setprecision(1) << r.seconds * 1000.0 << "\t"
+			<< r.bytes_written / (1024.0 * 1024.0) / r.seconds << "\t"
+			<< setprecision(2) << base_seconds / r.seconds << endl;
+	}
+
+	// 1周目の後は作業領域を使い回すので、計測したexportでは確保が起きてはいけない
+	bool passed = true;
+	for (size_t i = 0; i != results.size(); i++) {
+		const StlOutputStats &r = results[i];
+		if (r.buffer_growth_cnt != 0) {
+			cerr << "ERROR: STL output grew its buffers " << r.buffer_growth_cnt << " times after warm-up ("
+				<< (i < results.size() / 2 ? "binary" : "ascii") << ", " << r.thread_cnt << " threads)" << endl;
+			passed = false;
+		}
+	}
+	return passed;
+}
+
+// 同じアクターをバイナリ形式とASCII形式で書き出して読み込み、三角形が一致するかを確認する
+// 姿勢に回転を含むよう、シミュレーションをkStepCntステップ進めてから書き出す
+// ASCII形式は小数点以下3桁で書き出すので、丸め誤差(0.0005)にfloatの誤差を加えた値を許容誤差とする
+bool verifyStlFormats(const string &output_path)
+{
+	const PxU32 kStepCnt = 300;
+	const PxReal kTolerance = 0.0005f + 1e-4f;
+
+	gScene = createScene(gDispatcher);
+	vector<PxRigidDynamic*> pushers = createPitagoraScene(*gPhysics, *gScene, gSceneDesc);
+	for (PxU32 step = 0; step != kStepCnt; step++) {
+		updatePitagoraScene(pushers, step);
+		stepPhysics();
+	}
+
+	PxActorTypeFlags desired_types
+		= PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
+	vector<PxActor*> actors = getSceneActors(*gScene, desired_types);
+	const PxU32 kThreadCnt = PxMax(thread::hardware_concurrency(), 1u);
+
+	// 書き出し先のファイル名は同じなので、バイナリ形式は書き出した直後に読み込む
+	StlOutput stl_output;
+	vector<StlFacet> binary_facets, ascii_facets;
+	stl_output.outputStl(output_path, actors.data(), (PxU32)actors.size(), false, StlFormat::eBINARY, kThreadCnt);
+	const bool kBinaryRead = readStl(output_path + "output.stl", StlFormat::eBINARY, binary_facets);
+	stl_output.outputStl(output_path, actors.data(), (PxU32)actors.size(), false, StlFormat::eASCII, kThreadCnt);
+	const bool kAsciiRead = readStl(output_path + "output.stl", StlFormat::eASCII, ascii_facets);
+
+	releaseScene(*gScene);
+	gScene = NULL;
+
+	if (!kBinaryRead || !kAsciiRead) {
+		cerr << "STL format check: failed to read " << (kBinaryRead ? "ASCII" : "binary")
+			<< " file in " << output_path << endl;
+		return false;
+	}
+	if (binary_facets.size() != ascii_facets.size()) {
+		cerr << "STL format check: triangle count mismatch (binary " << binary_facets.size()
+			<< ", ascii " << ascii_facets.size() << ")" << endl;
+		return false;
+	}
+
+	PxReal max_normal_error = 0.0f;
+	PxReal max_vertex_error = 0.0f;
+	size_t mismatch_cnt = 0;
+	for (size_t i = 0; i != binary_facets.size(); i++) {
+		const StlFacet &b = binary_facets[i];
+		const StlFacet &a = ascii_facets[i];
+		const PxReal kNormalError = (b.normal - a.normal).abs().maxElement();
+		PxReal vertex_error = 0.0f;
+		for (size_t k = 0; k != 3; k++)
+			vertex_error = PxMax(vertex_error, (b.vertices[k] - a.vertices[k]).abs().maxElement());
+		if (kNormalError > kTolerance || vertex_error > kTolerance)
+			mismatch_cnt++;
+		max_normal_error = PxMax(max_normal_error, kNormalError);
+		max_vertex_error = PxMax(max_vertex_error, vertex_error);
+	}
+
+	const bool kPassed = mismatch_cnt == 0;
+	cout << "STL format check (" << actors.size() << " actors, " << binary_facets.size() << " triangles)" << endl;
+	cout << "	max normal error " << max_normal_error << ", max vertex error " << max_vertex_error << endl;
+	cout << (kPassed ? "OK" : "FAILED") << " (tolerance " << kTolerance << ", "
+		<< mismatch_cnt << " mismatched triangles)" << endl;
+	return kPassed;
+}
+
+int main(int argc, char* argv[])
+{
+	// コマンドライン引数
+	//  --verify-stl       : STL書き出しの頂点変換(SIMD版)がスカラー版と一致するか確認する
+	//  --verify-stl-format <dir> : 同じアクターをバイナリ形式とASCII形式で書き出し、読み込んだ三角形が一致するか確認する
+	//  --bench-stl <dir>  : シミュレーション後にSTL書き出しを計測する
+	//  --record <dir>     : 各フレームの動的アクターの姿勢をframes.binに記録する
+	//  --record-stl <dir> : 各フレームの動的アクターを連番のSTLファイルに記録する
+	//  --step <mode>      : ステップの進め方(blocking, pipelined, split。省略時はblocking)
+	//  --threads <n>      : PhysXのワーカースレッド数(省略時はハードウェアのスレッド数)
+	//  --dispatcher <type>: ディスパッチャの種類(default, stealing)
+	//  --pin              : ワーカースレッドをコアに固定する
+	//  --bench-dispatcher <n> : 装置をn個並べたシーンでディスパッチャを比較する
+	//  --headless         : PVDを使わずに実行し、終了時に入力を待たない
+	//  --pvd-file <path>  : PVDのデータをファイルに書き出す
+	//  --pvd-flags <names>: PVDへ送る情報(debug,profile,memory,contacts,constraints,queries)
+	//  --dominoes <n>     : 装置1つのドミノの数(既定は20)
+	//  --chains <n>       : 装置1つの振り子の本数(既定は1)
+	//  --structure <n>    : 装置1つの構造物の1辺の箱の数(既定は7、n^3個の箱)
+	//  --tiles <x>x<z>    : 装置を格子状に並べる数(既定は1x1)
+	//  --sweep <n>        : 装置を1x1からnxnまで並べて、規模ごとのステップ時間とメモリ量を計測する
+	//  --bench-extract <n>: 装置を1x1からnxnまで並べて、全アクターの走査と動いたアクターのみの読み出しを比較する
+	//  --bench-query <n>  : 装置を1x1からnxnまで並べて、raycast, sweep, overlapの速度をワーカースレッド数ごとに計測する
+	//  --chain-iterations <n> : 振り子の要素のposition iteration count(既定は64)
+	//  --profile <name>   : ソルバーのプロファイル(default, pgs, tgs, tgs-stable, tgs-mbp)
+	//  --chain-type <type>: 振り子の作り方(joint:PxSphericalJointでつなぐ / articulation:PxArticulationReducedCoordinate)
+	//  --fracture         : 構造物を1つのアクターにし、振り子が当たった箱のみ別のアクターに分ける
+	//  --bench-fracture   : 構造物を箱ごとのアクターにした場合と--fractureの場合のステップ時間を比較する
+	//  --bench-chain      : 要素数の違う鎖をjointとarticulationで作り、CPU時間とjointのずれを比較する
+	//  --bench-substep    : substep数と振り子のposition iteration countの組み合わせごとに、jointのずれとCPU時間を比較する
+	//  --realtime <s>     : 実時間に合わせてs秒間、固定ステップでシミュレーションする
+	//  --substeps <n>     : --realtimeで1/60秒を分割するステップ数(既定は1)
+	//  --build <mode>     : アクターのシーンへの追加方法(batched:まとめて追加 / per-actor:1つずつ追加)
+	//  --shapes <mode>    : shapeの作成方法(shared:同じ形のアクターで共有する / exclusive:アクターごとに作成する)
+	//  --bench-build      : シーンの作成方法ごとにshape数、作成時間、ステップ時間、メモリ量を比較する
+	//  --save-snapshot <path> : 作成したシーンをスナップショットとして書き出す
+	//  --load-snapshot <path> : シーンを作成せずにスナップショットから読み込む
+	//  --bench-snapshot <path>: シーンの作成とスナップショットの読み込みの時間を比較する
+	//  --verify-checkpoint    : チェックポイントから再開した実行が連続した実行と一致するかを確認する
+	//  --trace <path>     : PhysXのプロファイルゾーンを記録し、終了時にChromeのtrace event形式で書き出す
+	//  --alloc-pool       : PhysXの512byte以下の確保を固定サイズのプールから割り当てる
+	const char* stl_bench_path = NULL;
+	PxU32 dispatcher_bench_scene_cnt = 0;
+	PxU32 sweep_tile_cnt = 0;
+	PxU32 extract_bench_tile_cnt = 0;
+	PxU32 query_bench_tile_cnt = 0;
+	bool substep_bench = false;
+	bool chain_bench = false;
+	bool fracture_bench = false;
+	PxReal realtime_seconds = 0.0f;
+	PxU32 substep_cnt = 1;
+	bool build_bench = false;
+	const char* save_snapshot_path = NULL;
+	const char* load_snapshot_path = NULL;
+	const char* snapshot_bench_path = NULL;
+	bool checkpoint_verify = false;
+	const char* stl_format_verify_path = NULL;
+	const char* record_path = NULL;
+	FrameRecordFormat::Enum record_format = FrameRecordFormat::ePOSE_FILE;
+	for (int i = 1; i < argc; i++) {
+		const string kArg = argv[i];
+		if (kArg == "--verify-stl") {
+			return verifyTransformVertices() ? 0 : 1;
+		}
+		else if (kArg == "--verify-stl-format" && i + 1 < argc) {
+			stl_format_verify_path = argv[++i];
+		}
+		else if (kArg == "--bench-stl" && i + 1 < argc) {
+			stl_bench_path = argv[++i];
+		}
+		else if ((kArg == "--record" || kArg == "--record-stl") && i + 1 < argc) {
+			record_path = argv[++i];
+			record_format = kArg == "--record"
+				? FrameRecordFormat::ePOSE_FILE : FrameRecordFormat::eSTL_SEQUENCE;
+		}
+		else if (kArg == "--step" && i + 1 < argc) {
+			const string kMode = argv[++i];
+			if (kMode == "pipelined")
+				gStepMode = StepMode::ePIPELINED;
+			else if (kMode == "split")
+				gStepMode = StepMode::eSPLIT;
+			else
+				gStepMode = StepMode::eBLOCKING;
+		}
+		else if (kArg == "--threads" && i + 1 < argc) {
+			gWorkerThreadCnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--dispatcher" && i + 1 < argc) {
+			gDispatcherType = string(argv[++i]) == "stealing"
+				? DispatcherType::eWORK_STEALING : DispatcherType::eDEFAULT;
+		}
+		else if (kArg == "--pin") {
+			gPinWorkerThreads = true;
+		}
+		else if (kArg == "--bench-dispatcher" && i + 1 < argc) {
+			dispatcher_bench_scene_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--headless") {
+			gPvdMode = PvdMode::eNONE;
+		}
+		else if (kArg == "--pvd-file" && i + 1 < argc) {
+			gPvdMode = PvdMode::eFILE;
+			gPvdFilePath = argv[++i];
+		}
+		else if (kArg == "--pvd-flags" && i + 1 < argc) {
+			parsePvdFlags(argv[++i]);
+		}
+		else if (kArg == "--dominoes" && i + 1 < argc) {
+			gSceneDesc.domino_cnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--chains" && i + 1 < argc) {
+			gSceneDesc.chain_cnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--structure" && i + 1 < argc) {
+			gSceneDesc.structure_cnt = (PxU32)atoi(argv[++i]);
+		}
+		else if (kArg == "--tiles" && i + 1 < argc) {
+			parseTileCount(argv[++i], gSceneDesc);
+		}
+		else if (kArg == "--sweep" && i + 1 < argc) {
+			sweep_tile_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--bench-extract" && i + 1 < argc) {
+			extract_bench_tile_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--bench-query" && i + 1 < argc) {
+			query_bench_tile_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--chain-iterations" && i + 1 < argc) {
+			gSceneDesc.chain_position_iterations = PxClamp(atoi(argv[++i]), 1, 255);
+		}
+		else if (kArg == "--profile" && i + 1 < argc) {
+			gSolverProfile = findSolverProfile(argv[++i]);
+			if (!gSolverProfile)
+				cerr << "Unknown profile: " << argv[i] << endl;
+		}
+		else if (kArg == "--chain-type" && i + 1 < argc) {
+			const string kType = argv[++i];
+			gSceneDesc.chain_type = kType == "articulation" ? ChainType::eARTICULATION : ChainType::eJOINT;
+		}
+		else if (kArg == "--fracture") {
+			gSceneDesc.fracture_structure = true;
+		}
+		else if (kArg == "--bench-fracture") {
+			fracture_bench = true;
+		}
+		else if (kArg == "--bench-chain") {
+			chain_bench = true;
+		}
+		else if (kArg == "--bench-substep") {
+			substep_bench = true;
+		}
+		else if (kArg == "--realtime" && i + 1 < argc) {
+			realtime_seconds = (PxReal)atof(argv[++i]);
+		}
+		else if (kArg == "--substeps" && i + 1 < argc) {
+			substep_cnt = PxMax(atoi(argv[++i]), 1);
+		}
+		else if (kArg == "--build" && i + 1 < argc) {
+			gSceneDesc.batched = string(argv[++i]) != "per-actor";
+		}
+		else if (kArg == "--shapes" && i + 1 < argc) {
+			gSceneDesc.shared_shapes = string(argv[++i]) != "exclusive";
+		}
+		else if (kArg == "--bench-build") {
+			build_bench = true;
+		}
+		else if (kArg == "--save-snapshot" && i + 1 < argc) {
+			save_snapshot_path = argv[++i];
+		}
+		else if (kArg == "--load-snapshot" && i + 1 < argc) {
+			load_snapshot_path = argv[++i];
+		}
+		else if (kArg == "--bench-snapshot" && i + 1 < argc) {
+			snapshot_bench_path = argv[++i];
+		}
+		else if (kArg == "--verify-checkpoint") {
+			checkpoint_verify = true;
+		}
+		else if (kArg == "--trace" && i + 1 < argc) {
+			gTracePath = argv[++i];
+		}
+		else if (kArg == "--alloc-pool") {
+			gAllocator.setPoolEnabled(true);
+		}
+	}
+
 	initPhysics();
 	cout << "PhysXPitagora" << endl;
+
+	if (dispatcher_bench_scene_cnt) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkDispatcher(dispatcher_bench_scene_cnt);
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (sweep_tile_cnt) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkSceneScale(sweep_tile_cnt);
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (extract_bench_tile_cnt) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkStateExtraction(extract_bench_tile_cnt);
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (query_bench_tile_cnt) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkSceneQuery(query_bench_tile_cnt);
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (substep_bench) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkSubsteps();
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (chain_bench) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkChains();
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (fracture_bench) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkFracture();
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (realtime_seconds > 0.0f) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		runRealtime(realtime_seconds, substep_cnt);
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (build_bench) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkSceneBuild();
+		cleanupPhysics();
+		return 0;
+	}
+
+	if (checkpoint_verify) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		const bool kPassed = verifyCheckpoint();
+		cleanupPhysics();
+		return kPassed ? 0 : 1;
+	}
+
+	if (stl_format_verify_path) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		const bool kPassed = verifyStlFormats(stl_format_verify_path);
+		cleanupPhysics();
+		return kPassed ? 0 : 1;
+	}
+
+	if (snapshot_bench_path) {
+		releaseScene(*gScene);
+		gScene = NULL;
+		benchmarkSnapshot(snapshot_bench_path);
+		cleanupPhysics();
+		return 0;
+	}
+
+	cout << "Worker threads: " << gDispatcher->getWorkerCount() << endl;
 	cout << "Start simulation" << endl;
 
 	const PxU32 kMaxSimulationStep = 1000;
 
-	createPitagoraScene();
+	const chrono::steady_clock::time_point kBuildStart = chrono::steady_clock::now();
+	vector<PxRigidDynamic*> structures;
+	if (load_snapshot_path) {
+		TraceZone zone("Pitagora.loadSnapshot");
+		if (!gSnapshot.load(*gPhysics, *gScene, load_snapshot_path, gPushers)) {
+			cerr << "Failed to load snapshot: " << load_snapshot_path << endl;
+			cleanupPhysics();
+			return 1;
+		}
+	}
+	else {
+		TraceZone zone("Pitagora.buildScene");
+		// 記録中はアクターを追加できないので、箱を分けない
+		if (record_path && gSceneDesc.fracture_structure) {
+			cerr << "--fracture is ignored while recording" << endl;
+			gSceneDesc.fracture_structure = false;
+		}
+		gPushers = createPitagoraScene(*gPhysics, *gScene, gSceneDesc, NULL, &structures);
+	}
+	if (gSolverProfile)
+		applySolverProfile(*gSolverProfile, *gScene);
+	cout << (load_snapshot_path ? "Scene loaded: " : "Scene built: ")
+		<< chrono::duration<double>(chrono::steady_clock::now() - kBuildStart).count() * 1000.0 << " ms" << endl;
+	if (save_snapshot_path && !SceneSnapshot::save(*gPhysics, *gScene, gPushers, save_snapshot_path))
+		cerr << "Failed to save snapshot: " << save_snapshot_path << endl;
+	cout << "Actors: " << gScene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC) << " dynamic, "
+		<< gScene->getNbActors(PxActorTypeFlag::eRIGID_STATIC) << " static, "
+		<< gPhysics->getNbShapes() << " shapes ("
+		<< gPushers.size() << " tiles)" << endl;
+
+	// 各フレームの記録(ファイルへの書き込みは別スレッドで行う)
+	FrameRecorder recorder;
+	if (record_path)
+		recorder.begin(*gScene, record_path, record_format);
+
+	// フレーム処理(ステップ開始前の状態を使う)
+	// blocking以外ではシミュレーションと並行して実行される
+	auto frame_work = [&](PxU32 step) {
+		TraceZone zone("Pitagora.frameWork");
+		recorder.recordFrame(step);
+	};
+
+	// 各ステップの後に動いたアクターの姿勢のみを読み出す
+	ActorStateBuffer state_buffer;
+	state_buffer.begin(*gScene);
+	PxU64 changed_pose_cnt = 0;
+
+	// 振り子が当たった構造物の箱を分ける(--fracture)
+	vector<FractureCompound> fractures;
+	for (size_t i = 0; i != structures.size(); i++) {
+		fractures.push_back(FractureCompound(*structures[i], kStructureDensity,
+			kStructureFractureImpulse, kStructureFractureRadius, 1.0f / 60.0f));
+	}
+	PxU32 split_cnt = 0;
+
+	// シミュレーションイベント(各ステップの後に取り出す)
+	vector<SimulationEvent> events;
+	PxU32 event_cnts[SimulationEventType::eCOUNT] = {};
+	PxI32 ball_domino_step = -1;         // 球が最初にドミノに当たったステップ
+	PxI32 pendulum_structure_step = -1;  // 振り子が最初に構造物に当たったステップ
+
+	typedef chrono::steady_clock Clock;
+	double frame_work_time = 0.0;  // フレーム処理の時間
+	double wait_time = 0.0;        // メインスレッドがシミュレーションの完了を待っていた時間
+	const Clock::time_point kLoopStart = Clock::now();
 
 	for (PxU32 step = 0; step != kMaxSimulationStep; step++) {
-		if (step < 100) {
-			PxVec3 pusher_pos = gPusher->getGlobalPose().p;
-			gPusher->setKinematicTarget(
-				PxTransform(pusher_pos + PxVec3(0.01f, 0.0f, 0.0f)));
+		TraceZone step_zone("Pitagora.step");
+		gAllocator.setPhase(AllocationPhase::eSIMULATE);
+		updatePitagoraScene(gPushers, step);
+		gEventRecorder.setStep(step);
+
+		if (gStepMode == StepMode::eBLOCKING) {
+			const Clock::time_point kWorkStart = Clock::now();
+			frame_work(step);
+			const Clock::time_point kStepStart = Clock::now();
+			stepPhysics();
+			frame_work_time += chrono::duration<double>(kStepStart - kWorkStart).count();
+			wait_time += chrono::duration<double>(Clock::now() - kStepStart).count();
+		}
+		else {
+			beginStepPhysics();
+			const Clock::time_point kWorkStart = Clock::now();
+			frame_work(step);
+			const Clock::time_point kWaitStart = Clock::now();
+			endStepPhysics();
+			frame_work_time += chrono::duration<double>(kWaitStart - kWorkStart).count();
+			wait_time += chrono::duration<double>(Clock::now() - kWaitStart).count();
+		}
+
+		changed_pose_cnt += state_buffer.update();
+
+		events.clear();
+		gEventRecorder.drain(events);
+		for (size_t i = 0; i != events.size(); i++) {
+			const SimulationEvent &event = events[i];
+			event_cnts[event.type]++;
+			for (size_t f = 0; f != fractures.size(); f++)
+				fractures[f].onContact(event);
+			if (event.type != SimulationEventType::eCONTACT)
+				continue;
+
+			const PxU32 kGroups = event.groups[0] | event.groups[1];
+			if (ball_domino_step < 0 && kGroups == (PitagoraGroup::eBALL | PitagoraGroup::eDOMINO))
+				ball_domino_step = (PxI32)event.step;
+			if (pendulum_structure_step < 0 && kGroups == (PitagoraGroup::ePENDULUM | PitagoraGroup::eSTRUCTURE))
+				pendulum_structure_step = (PxI32)event.step;
+		}
+		// 分けた破片も以降のステップで姿勢を記録する
+		for (size_t f = 0; f != fractures.size(); f++) {
+			const size_t kSplitBefore = fractures[f].getSplitActors().size();
+			split_cnt += fractures[f].update(*gPhysics, *gScene);
+			const vector<PxRigidDynamic*> &kSplitActors = fractures[f].getSplitActors();
+			state_buffer.addActors(kSplitActors.data() + kSplitBefore, (PxU32)(kSplitActors.size() - kSplitBefore));
 		}
-		stepPhysics();
+	}
+	const double kLoopTime = chrono::duration<double>(Clock::now() - kLoopStart).count();
+	const PxU32 kStateActorCnt = state_buffer.getActorCount();
+	state_buffer.end();
+	gAllocator.setPhase(AllocationPhase::eEXPORT);
+	{
+		// フレーム処理ではステップ開始前の状態を記録するので、最後のステップの後の状態をここで記録する
+		TraceZone zone("Export.endRecording");
+		recorder.recordFrame(kMaxSimulationStep);
+		recorder.end();
 	}
 	cout << "End simulation" << endl;
 
+	// blockingではフレーム処理とシミュレーションが直列に実行される
+	// それ以外ではフレーム処理中もシミュレーションが進むので、その分だけ待ち時間が減る
+	const char* kStepModeNames[] = { "blocking", "pipelined", "split" };
+	const char* kPvdModeNames[] = { "none", "socket", "file" };
+	cout << "Step mode: " << kStepModeNames[gStepMode]
+		<< ", PVD: " << kPvdModeNames[gPvdMode] << endl;
+	cout << "\tframe:       " << kLoopTime * 1000.0 / kMaxSimulationStep << " ms" << endl;
+	cout << "\tframe work:  " << frame_work_time * 1000.0 / kMaxSimulationStep << " ms"
+		<< (gStepMode == StepMode::eBLOCKING ? "" : " (overlapped with simulation)") << endl;
+	cout << "\twait:        " << wait_time * 1000.0 / kMaxSimulationStep << " ms" << endl;
+	cout << "Memory: " << getProcessMemoryUsage() / (1024.0 * 1024.0) << " MB" << endl;
+	cout << "Active actors: " << fixed << setprecision(1) << (double)changed_pose_cnt / kMaxSimulationStep
+		<< " / " << kStateActorCnt << " per step" << defaultfloat << endl;
+	cout << "Events: " << event_cnts[SimulationEventType::eCONSTRAINT_BREAK] << " joint breaks, "
+		<< event_cnts[SimulationEventType::eWAKE] << " wakes, "
+		<< event_cnts[SimulationEventType::eSLEEP] << " sleeps, "
+		<< event_cnts[SimulationEventType::eCONTACT] << " contacts, "
+		<< event_cnts[SimulationEventType::eCONTACT_FORCE] << " contact forces, "
+		<< gEventRecorder.getDroppedCount() << " dropped" << endl;
+	cout << "\tball hits domino:        step " << ball_domino_step << endl;
+	cout << "\tpendulum hits structure: step " << pendulum_structure_step << endl;
+	if (!fractures.empty()) {
+		PxU32 piece_cnt = 0;
+		for (size_t f = 0; f != fractures.size(); f++)
+			piece_cnt += fractures[f].getPieceCount();
+		cout << "Fracture: " << split_cnt << " / " << piece_cnt << " pieces split" << endl;
+	}
+
+	if (stl_bench_path) {
+		const bool kPassed = benchmarkStlOutput(stl_bench_path);
+		cleanupPhysics();
+		return kPassed ? 0 : 1;
+	}
+
 	// STLファイルを書き出す
 	/*
 	PxActorTypeFlags desired_types
 		= PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
-	PxU32 actor_cnt = gScene->getNbActors(desired_types);
-	PxActor** actor_buffer = new PxActor*[actor_cnt];
-	gScene->getActors(desired_types, actor_buffer, actor_cnt);
+	vector<PxActor*> actor_buffer = getSceneActors(*gScene, desired_types);
 	
 	StlOutput stl_output;
-	stl_output.outputStl("F:/stl/", actor_buffer, actor_cnt, true);
+	stl_output.outputStl("F:/stl/", actor_buffer.data(), (PxU32)actor_buffer.size(), true);
 	*/
-	
-	int tmp;
-	cin >> tmp;
+
+	cleanupPhysics();
+
+	// ヘッドレス実行では入力を待たずに終了する
+	if (gPvdMode != PvdMode::eNONE) {
+		int tmp;
+		cin >> tmp;
+	}
 	return 0;
 }
@@ -0,0 +1,267 @@
+#include "pitagora_scene.h"
+#include "scene_builder.h"
+#include "../../Common/simulation_events.h"
+
+const PxReal PitagoraLayout::kChainSpacing = 1.0f;
+
+PitagoraLayout::PitagoraLayout(const PitagoraSceneDesc &desc)
+{
+	// ドミノの間隔が既定(20個で半径3m)より狭くならないよう円の半径を広げる
+	const PxReal kDefaultCircleR = 3.0f;
+	const PxReal kDominoSpacing = kDefaultCircleR * PxPi / 21.0f;
+	circle_r = PxMax(kDefaultCircleR, (desc.domino_cnt + 1) * kDominoSpacing / PxPi);
+
+	// 構造物は振り子が当たる面(+x側)の位置を固定し、-x側と+z側へ大きくする
+	const PxReal kStructureLength = 0.2f;
+	structure_corner = PxVec3(
+		2.05f - kStructureLength * 2 * (PxReal(desc.structure_cnt) - 7.0f),
+		0.0f,
+		circle_r * 2 - 0.25f);
+
+	// 振り子は+z方向へ1mずつ並べる
+	const PxReal kChainEndZ = circle_r * 2 + 1.0f + kChainSpacing * (PxMax(desc.chain_cnt, 1u) - 1);
+
+	// 構造物と振り子が載るようにフィールドを広げる(既定のサイズは12m x 10m)
+	const PxReal kStructureEnd = structure_corner.z + kStructureLength * (2 * desc.structure_cnt - 1);
+	field_min_x = PxMin(0.0f, structure_corner.x - kStructureLength - 1.0f);
+	field_max_x = 12.0f + (circle_r - kDefaultCircleR);
+	field_max_z = PxMax(circle_r * 2 + 4.0f, PxMax(kStructureEnd + 1.0f, kChainEndZ + 3.0f));
+}
+
+// 1つの装置を作成する
+// origin: 装置全体の平行移動量
+// balls: NULLでなければ球を追加する
+// structures: NULLでなければfracture_structureの場合の構造物を追加する
+static PxRigidDynamic* createPitagoraTile(PxPhysics &physics, SceneBuilder &builder,
+	const PitagoraSceneDesc &desc, const PitagoraLayout &layout, PxMaterial *material, const PxVec3 &origin,
+	vector<PxRigidDynamic*>* balls, vector<PxRigidDynamic*>* structures)
+{
+	////// ピタゴラ装置のフィールドを作成(static rigid body)
+	// base plate(既定は12m x 0.2m x 10m)
+	const PxVec3 kPlateHalf(
+		(layout.field_max_x - layout.field_min_x) * 0.5f, 0.1f, layout.field_max_z * 0.5f);
+	builder.createStatic(PxTransform(origin + PxVec3(layout.field_min_x + kPlateHalf.x, 0.0f, kPlateHalf.z)),
+		PxBoxGeometry(kPlateHalf), *material);
+
+	// 段差0(ドミノの円の半径に合わせて+x方向へ広げる)
+	const PxVec3 kStepHalf0(2.0f + (layout.circle_r - 3.0f) * 0.5f, 0.5f, kPlateHalf.z);
+	builder.createStatic(PxTransform(
+		origin + PxVec3(
+			layout.field_max_x - kStepHalf0.x,
+			kPlateHalf.y + kStepHalf0.y,
+			kStepHalf0.z)
+	), PxBoxGeometry(kStepHalf0), *material);
+
+	// 段差1
+	const PxVec3 kStepHalf1(4.0f, 0.5f, 1.0f);
+	builder.createStatic(PxTransform(
+		origin + PxVec3(
+			kStepHalf1.x,
+			kPlateHalf.y + kStepHalf1.y,
+			kStepHalf1.z)
+	), PxBoxGeometry(kStepHalf1), *material);
+
+	// 段差2
+	const PxVec3 kStepHalf2(0.3f, 0.5f, 1.0f);
+	builder.createStatic(PxTransform(
+		origin + PxVec3(
+			kStepHalf2.x,
+			kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y,
+			kStepHalf2.z)
+	), PxBoxGeometry(kStepHalf2), *material);
+
+	// slope
+	const PxVec3 kSlopeHalf(3.7f, 0.1f, 1.0f);
+	const PxReal kSlopeAngle = -PxPi / 36.0f; // 5 degree
+	builder.createStatic(PxTransform(
+		origin + PxVec3(
+			kStepHalf2.x * 2 + kSlopeHalf.x,
+			kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y,
+			kSlopeHalf.z),
+		PxQuat(kSlopeAngle, PxVec3(0.0f, 0.0f, 1.0f))
+	), PxBoxGeometry(kSlopeHalf), *material);
+
+	////// 球を作成(dynamic rigid body)
+	const PxReal kSphereR = 0.25f;
+	builder.setSimulationFilterData(makeContactReportFilterData(PitagoraGroup::eBALL, 0));
+	PxRigidDynamic* sphere = builder.createDynamic(
+		PxTransform(
+			origin + PxVec3(
+				kSphereR,
+				kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y * 2 + kSphereR,
+				kStepHalf2.z)
+		), PxSphereGeometry(kSphereR), *material);
+	sphere->setActorFlag(PxActorFlag::eSEND_SLEEP_NOTIFIES, true);
+	if (balls)
+		balls->push_back(sphere);
+
+	///// 球を押す剛体を作成(kinematic actor)
+	const PxVec3 kPusherHalf(0.5f, 0.05f, 0.2f);
+	builder.setSimulationFilterData(PxFilterData());
+	PxRigidDynamic* pusher = builder.createDynamic(PxTransform(
+		origin + PxVec3(
+			-kPusherHalf.x * 1.5,
+			kPlateHalf.y + kStepHalf1.y * 2 + kStepHalf2.y * 2 + kSphereR,
+			kStepHalf1.z)
+	), PxBoxGeometry(kPusherHalf), *material);
+	pusher->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, true);
+
+	///// ドミノを作成
+	const PxU32 kDominoCnt = desc.domino_cnt;
+	const PxBoxGeometry kDominoGeometry(0.05f, 0.5f, 0.2f);
+	const PxReal kCircleR = layout.circle_r;
+	const PxVec3 kCircleCenter = origin + PxVec3(
+		kStepHalf1.x * 2 + kDominoGeometry.halfExtents.x,
+		kPlateHalf.y + kStepHalf0.y * 2 + kDominoGeometry.halfExtents.y,
+		kCircleR + kStepHalf1.z);
+	const PxReal kSplitAngle = PxPi / (kDominoCnt + 1);
+	builder.setSimulationFilterData(makeContactReportFilterData(PitagoraGroup::eDOMINO, PitagoraGroup::eBALL));
+
+	for (PxU32 i = 0; i != kDominoCnt; i++) {
+		const PxVec3 dominoPos = kCircleCenter
+			+ kCircleR * PxVec3(PxSin(kSplitAngle*i), 0.0f, -PxCos(kSplitAngle*i));
+
+		PxRigidDynamic* domino = builder.createDynamic(
+			PxTransform(dominoPos, PxQuat(-kSplitAngle * i, PxVec3(0.0f, 1.0f, 0.0f))),
+			kDominoGeometry, *material);
+		domino->setActorFlag(PxActorFlag::eSEND_SLEEP_NOTIFIES, true);
+	}
+
+	///// 振り子を作成
+	const PxVec3 kChainOrigin
+		= kCircleCenter + kCircleR * PxVec3(0.0f, 0.0f, 1.0f) + PxVec3(-3.0f, 0.0f, 0.0f);
+	const PxReal kChainLength = 5.0f;
+	const PxU32 kChainCnt = 18;  // 1本の振り子の要素数
+	const PxReal kHookHalfHeight = 0.1f;
+	const PxReal kElementR = 0.15f;
+	const PxReal kLastElementR = kElementR * 3.0f;
+	const PxReal kChainAngle = PxPi / 6.0f; // 30 degree
+	builder.setSimulationFilterData(makeContactReportFilterData(PitagoraGroup::ePENDULUM, 0));
+
+	for (PxU32 c = 0; c != desc.chain_cnt; c++) {
+		const PxVec3 kChainCenter = kChainOrigin + PxVec3(0.0f, 0.0f, PitagoraLayout::kChainSpacing * c);
+		builder.beginAggregate(kChainCnt, true);
+
+		// 振り子のフック(static rigid body、articulationでは固定したルートのリンク)から吊るす
+		ChainDesc chain_desc;
+		chain_desc.type = desc.chain_type;
+		chain_desc.hook_pose = PxTransform(kChainCenter + PxVec3(0, kChainLength, 0));
+		chain_desc.hook_geometry = PxBoxGeometry(0.5f, kHookHalfHeight, 0.1f);
+		chain_desc.direction = PxVec3(PxSin(kChainAngle), -PxCos(kChainAngle), 0.0f);
+		chain_desc.anchor = chain_desc.hook_pose.p + chain_desc.direction * kHookHalfHeight;
+		chain_desc.link_cnt = kChainCnt;
+		chain_desc.link_r = kElementR;
+		chain_desc.last_link_r = kLastElementR;  // 最後の要素の半径を大きく
+		chain_desc.density = 1.0f;
+		chain_desc.position_iterations = desc.chain_position_iterations;
+		chain_desc.velocity_iterations = 1;
+		chain_desc.sleep = true;  // actorをスリープさせる
+		createChain(physics, builder, chain_desc, *material);
+		builder.endAggregate();
+	}
+
+	///// 構造物を作成
+	const PxVec3 kStructureCenter
+		= origin + layout.structure_corner + PxVec3(0.0f, kPlateHalf.y, 0.0f);
+	const PxU32 kStructureCnt = desc.structure_cnt;
+	const PxReal kStructureLength = 0.2f;
+
+	if (desc.fracture_structure) {
+		// 全ての箱を1つのアクターのshapeにし、振り子や分けた箱が当たった箱のみFractureCompoundで分ける
+		builder.setSimulationFilterData(makeContactReportFilterData(PitagoraGroup::eSTRUCTURE,
+			PitagoraGroup::ePENDULUM | PitagoraGroup::eSTRUCTURE));
+		vector<PxTransform> local_poses;
+		local_poses.reserve(kStructureCnt * kStructureCnt * kStructureCnt);
+		for (PxU32 x = 0; x != kStructureCnt; x++) {
+			for (PxU32 y = 0; y != kStructureCnt; y++) {
+				for (PxU32 z = 0; z != kStructureCnt; z++) {
+					local_poses.push_back(PxTransform(PxVec3(
+						kStructureLength * 2 * x,
+						kStructureLength + kStructureLength * 2 * y,
+						kStructureLength * 2 * z)));
+				}
+			}
+		}
+		PxRigidDynamic* structure = builder.createCompound(PxTransform(kStructureCenter),
+			PxBoxGeometry(kStructureLength, kStructureLength, kStructureLength),
+			local_poses, *material, kStructureDensity);
+		builder.putToSleep(*structure);
+		if (structures)
+			structures->push_back(structure);
+	}
+	else {
+		builder.setSimulationFilterData(makeContactReportFilterData(PitagoraGroup::eSTRUCTURE, PitagoraGroup::ePENDULUM));
+		builder.beginAggregate(kStructureCnt * kStructureCnt * kStructureCnt, true);
+		for (PxU32 x = 0; x != kStructureCnt; x++) {
+			for (PxU32 y = 0; y != kStructureCnt; y++) {
+				for (PxU32 z = 0; z != kStructureCnt; z++) {
+					const PxVec3 kElementPos = kStructureCenter
+						+ PxVec3(
+							kStructureLength * 2 * x,
+							kStructureLength + kStructureLength * 2 * y,
+							kStructureLength * 2 * z);
+
+					PxRigidDynamic* element = builder.createDynamic(
+						PxTransform(kElementPos),
+						PxBoxGeometry(kStructureLength, kStructureLength, kStructureLength),
+						*material, kStructureDensity);
+
+					builder.putToSleep(*element);
+				}
+			}
+		}
+		builder.endAggregate();
+	}
+	builder.setSimulationFilterData(PxFilterData());
+	return pusher;
+}
+
+vector<PxRigidDynamic*> createPitagoraScene(PxPhysics &physics, PxScene &scene, const PitagoraSceneDesc &desc,
+	vector<PxRigidDynamic*>* balls, vector<PxRigidDynamic*>* structures)
+{
+	// 静摩擦係数、動摩擦係数、反発係数の順
+	PxMaterial* material = physics.createMaterial(0.5f, 0.5f, 0.6f);
+
+	// 装置をフィールドの大きさ + 1mの間隔で格子状に並べる
+	const PitagoraLayout kLayout(desc);
+	const PxReal kTilePitchX = kLayout.field_max_x - kLayout.field_min_x + 1.0f;
+	const PxReal kTilePitchZ = kLayout.field_max_z + 1.0f;
+
+	// 全ての装置のアクターを作成してから、まとめてシーンに追加する
+	// shapeは全ての装置で共有する(キャッシュが解放されてもアクターに付いたshapeは残る)
+	ShapeCache shape_cache(physics);
+	SceneBuilder builder(physics, scene, desc.batched, desc.shared_shapes ? &shape_cache : NULL);
+	vector<PxRigidDynamic*> pushers;
+	for (PxU32 z = 0; z != desc.tile_cnt_z; z++) {
+		for (PxU32 x = 0; x != desc.tile_cnt_x; x++) {
+			pushers.push_back(createPitagoraTile(physics, builder, desc, kLayout, material,
+				PxVec3(kTilePitchX * x, 0.0f, kTilePitchZ * z), balls, structures));
+		}
+	}
+	builder.flush();
+
+	// materialはshapeが参照しているので、アクターを解放すると一緒に解放されるようにする
+	material->release();
+	return pushers;
+}
+
+void updatePitagoraScene(const vector<PxRigidDynamic*> &pushers, PxU32 step)
+{
+	const PxReal kFrameTime = 1.0f / 60.0f;
+	updatePitagoraScene(pushers, step * (double)kFrameTime, kFrameTime);
+}
+
+void updatePitagoraScene(const vector<PxRigidDynamic*> &pushers, double time, PxReal step_time)
+{
+	// 1/60秒あたり1cm押す
+	const PxReal kFrameTime = 1.0f / 60.0f;
+	const double kPushTime = 100 * (double)kFrameTime;
+	if (time < kPushTime) {
+		const PxReal kDistance = 0.01f * (step_time / kFrameTime);
+		for (size_t i = 0; i != pushers.size(); i++) {
+			PxVec3 pusher_pos = pushers[i]->getGlobalPose().p;
+			pushers[i]->setKinematicTarget(
+				PxTransform(pusher_pos + PxVec3(kDistance, 0.0f, 0.0f)));
+		}
+	}
+}
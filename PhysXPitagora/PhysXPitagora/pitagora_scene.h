@@ -0,0 +1,74 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "chain_builder.h"
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// ピタゴラ装置の規模
+// 既定値は元の装置(ドミノ20個、振り子1本、7x7x7の構造物を1つ)
+struct PitagoraSceneDesc {
+	PxU32 domino_cnt;     // ドミノの数
+	PxU32 chain_cnt;      // 振り子の本数
+	PxU32 structure_cnt;  // 構造物の1辺の箱の数(structure_cnt^3個の箱)
+	PxU32 tile_cnt_x;     // 装置をx方向に並べる数
+	PxU32 tile_cnt_z;     // 装置をz方向に並べる数
+	bool batched;         // アクターをまとめてシーンに追加し、振り子と構造物をPxAggregateにする
+	bool shared_shapes;   // 同じ形のアクターでshapeを共有する
+	PxU32 chain_position_iterations;  // 振り子の要素のposition iteration count
+	ChainType::Enum chain_type;       // 振り子の作り方(eARTICULATIONでは少ない反復回数でも伸びない)
+	bool fracture_structure;          // 構造物を全ての箱のshapeを持つ1つのアクターにする(FractureCompound用)
+
+	PitagoraSceneDesc()
+		: domino_cnt(20), chain_cnt(1), structure_cnt(7), tile_cnt_x(1), tile_cnt_z(1),
+		batched(true), shared_shapes(true), chain_position_iterations(64), chain_type(ChainType::eJOINT),
+		fracture_structure(false) {}
+
+	PxU32 getTileCount() const { return tile_cnt_x * tile_cnt_z; }
+};
+
+// shapeのシミュレーションのフィルタデータに設定するグループ(PxFilterData::word0)
+// ドミノは球との接触を、構造物は振り子との接触をcontactReportFilterShaderで報告させる
+// 球とドミノはスリープ・起床も報告させる(PxActorFlag::eSEND_SLEEP_NOTIFIES)
+struct PitagoraGroup {
+	enum Enum {
+		eBALL      = 1 << 0,
+		eDOMINO    = 1 << 1,
+		ePENDULUM  = 1 << 2,
+		eSTRUCTURE = 1 << 3
+	};
+};
+
+// 規模に応じた装置の配置
+// 既定の規模では元の装置と同じ配置になる
+struct PitagoraLayout {
+	PxReal circle_r;           // ドミノを並べる円の半径
+	PxVec3 structure_corner;   // 構造物の最初の箱の位置(床面からの高さは0)
+	PxReal field_min_x;        // フィールド(base plate)の範囲
+	PxReal field_max_x;
+	PxReal field_max_z;        // zの最小値は0
+	static const PxReal kChainSpacing;  // 振り子の間隔
+
+	explicit PitagoraLayout(const PitagoraSceneDesc &desc);
+};
+
+// ピタゴラ装置(球、ドミノ、振り子、構造物)をdescの数だけ格子状に並べて作成し、
+// 各装置の球を押すkinematic actorを返す
+// balls: NULLでなければ各装置の球を追加する
+// structures: NULLでなければfracture_structureの場合の各装置の構造物を追加する
+vector<PxRigidDynamic*> createPitagoraScene(PxPhysics &physics, PxScene &scene,
+	const PitagoraSceneDesc &desc = PitagoraSceneDesc(), vector<PxRigidDynamic*>* balls = NULL,
+	vector<PxRigidDynamic*>* structures = NULL);
+
+// fracture_structureで作った構造物の箱を分ける設定
+const PxReal kStructureDensity = 0.01f;            // 壊れやすくするために軽くする
+const PxReal kStructureFractureImpulse = 0.01f;    // 箱を分ける接触の力積(N・s)
+const PxReal kStructureFractureRadius = 0.6f;      // 接触点から箱1.5個分以内の箱を分ける
+
+// stepのシミュレーションの前に呼び、最初の100ステップで球を押す(1ステップは1/60秒)
+void updatePitagoraScene(const vector<PxRigidDynamic*> &pushers, PxU32 step);
+
+// 時刻timeからstep_time秒のシミュレーションの前に呼び、最初の100/60秒で球を押す
+// 1/60秒より短いステップ(substep)で進める場合に使う
+void updatePitagoraScene(const vector<PxRigidDynamic*> &pushers, double time, PxReal step_time);
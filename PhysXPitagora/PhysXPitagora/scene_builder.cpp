@@ -0,0 +1,198 @@
+#include "scene_builder.h"
+
+
+using namespace std;
+
+SceneBuilder::SceneBuilder(PxPhysics &physics, PxScene &scene, bool batched, ShapeCache* shape_cache)
+	: physics_(physics), scene_(scene), batched_(batched), shape_cache_(shape_cache),
+	in_aggregate_(false), self_collision_(false), aggregate_remaining_cnt_(0), aggregate_(NULL), aggregate_cnt_(0)
+{
+}
+
+SceneBuilder::~SceneBuilder()
+{
+	flush();
+}
+
+PxRigidDynamic* SceneBuilder::createDynamic(const PxTransform &t, const PxGeometry &geometry,
+	PxMaterial &material, PxReal density)
+{
+	PxShape* shape = getSharedShape(geometry, material);
+	PxRigidDynamic* rigid_dynamic = shape
+		? PxCreateDynamic(physics_, t, *shape, density)
+		: PxCreateDynamic(physics_, t, geometry, material, density);
+	addActor(*rigid_dynamic, true);
+	return rigid_dynamic;
+}
+
+PxRigidStatic* SceneBuilder::createStatic(const PxTransform &t, const PxGeometry &geometry, PxMaterial &material)
+{
+	PxShape* shape = getSharedShape(geometry, material);
+	PxRigidStatic* rigid_static = shape
+		? PxCreateStatic(physics_, t, *shape)
+		: PxCreateStatic(physics_, t, geometry, material);
+	addActor(*rigid_static, false);
+	return rigid_static;
+}
+
+PxRigidDynamic* SceneBuilder::createCompound(const PxTransform &t, const PxGeometry &geometry,
+	const vector<PxTransform> &local_poses, PxMaterial &material, PxReal density)
+{
+	PxRigidDynamic* compound = physics_.createRigidDynamic(t);
+	for (size_t i = 0; i != local_poses.size(); i++) {
+		PxShape* shape = PxRigidActorExt::createExclusiveShape(*compound, geometry, material);
+		shape->setLocalPose(local_poses[i]);
+		shape->setSimulationFilterData(filter_data_);
+	}
+	PxRigidBodyExt::updateMassAndInertia(*compound, density);
+	addActor(*compound, true);
+	return compound;
+}
+
+PxArticulationLink* SceneBuilder::createLink(PxArticulationReducedCoordinate &articulation,
+	PxArticulationLink* parent, const PxTransform &t, const PxGeometry &geometry, PxMaterial &material,
+	PxReal density)
+{
+	PxArticulationLink* link = articulation.createLink(parent, t);
+	PxShape* shape = getSharedShape(geometry, material);
+	if (shape)
+		link->attachShape(*shape);
+	else
+		PxRigidActorExt::createExclusiveShape(*link, geometry, material);
+	PxRigidBodyExt::updateMassAndInertia(*link, density);
+	setFilterData(*link);
+	return link;
+}
+
+void SceneBuilder::addArticulation(PxArticulationReducedCoordinate &articulation, bool sleep)
+{
+	if (!batched_) {
+		scene_.addArticulation(articulation);
+		if (sleep)
+			articulation.putToSleep();
+		return;
+	}
+
+	articulations_.push_back(&articulation);
+	if (sleep)
+		sleep_articulations_.push_back(&articulation);
+}
+
+void SceneBuilder::beginAggregate(PxU32 actor_cnt, bool self_collision)
+{
+	in_aggregate_ = true;
+	self_collision_ = self_collision;
+	aggregate_remaining_cnt_ = actor_cnt;
+	aggregate_ = NULL;
+}
+
+void SceneBuilder::endAggregate()
+{
+	in_aggregate_ = false;
+	aggregate_ = NULL;
+}
+
+void SceneBuilder::putToSleep(PxRigidDynamic &actor)
+{
+	if (batched_)
+		sleep_actors_.push_back(&actor);
+	else
+		actor.putToSleep();
+}
+
+void SceneBuilder::flush()
+{
+	if (!actors_.empty())
+		scene_.addActors(actors_.data(), (PxU32)actors_.size());
+	for (size_t i = 0; i != aggregates_.size(); i++)
+		scene_.addAggregate(*aggregates_[i]);
+	for (size_t i = 0; i != articulations_.size(); i++)
+		scene_.addArticulation(*articulations_[i]);
+	for (size_t i = 0; i != sleep_actors_.size(); i++)
+		sleep_actors_[i]->putToSleep();
+	for (size_t i = 0; i != sleep_articulations_.size(); i++)
+		sleep_articulations_[i]->putToSleep();
+
+	actors_.clear();
+	aggregates_.clear();
+	articulations_.clear();
+	sleep_actors_.clear();
+	sleep_articulations_.clear();
+	aggregate_ = NULL;
+}
+
+PxShape* SceneBuilder::getSharedShape(const PxGeometry &geometry, PxMaterial &material)
+{
+	return shape_cache_ ? shape_cache_->getShape(geometry, material, filter_data_) : NULL;
+}
+
+// 共有していないshapeはアクターごとに作られるので、作成した後にフィルタデータを設定する
+void SceneBuilder::setFilterData(PxRigidActor &actor)
+{
+	PxShape* shape;
+	if (actor.getShapes(&shape, 1) == 1 && shape->isExclusive())
+		shape->setSimulationFilterData(filter_data_);
+}
+
+void SceneBuilder::addActor(PxRigidActor &actor, bool dynamic)
+{
+	setFilterData(actor);
+
+	if (!batched_) {
+		scene_.addActor(actor);
+		return;
+	}
+
+	if (!in_aggregate_ || !dynamic) {
+		actors_.push_back(&actor);
+		return;
+	}
+
+	// 作成中のPxAggregateが無いか満杯なら、残りのアクター数に合わせて新しく作る
+	if (!aggregate_ || aggregate_->getNbActors() == aggregate_->getMaxNbActors()) {
+		const PxU32 kSize = PxClamp(aggregate_remaining_cnt_, 1u, kMaxAggregateActorCnt);
+		aggregate_ = physics_.createAggregate(kSize, self_collision_);
+		aggregates_.push_back(aggregate_);
+		aggregate_cnt_++;
+	}
+	aggregate_->addActor(actor);
+	if (aggregate_remaining_cnt_)
+		aggregate_remaining_cnt_--;
+}
+
+void releaseScene(PxScene &scene)
+{
+	// jointはアクターより先に解放する
+	vector<PxConstraint*> constraints(scene.getNbConstraints());
+	if (!constraints.empty())
+		scene.getConstraints(constraints.data(), (PxU32)constraints.size());
+	for (size_t i = 0; i != constraints.size(); i++) {
+		PxU32 type_id;
+		void* external = constraints[i]->getExternalReference(type_id);
+		if (type_id == PxConstraintExtIDs::eJOINT)
+			static_cast<PxJoint*>(external)->release();
+	}
+
+	const PxActorTypeFlags kTypes = PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
+	vector<PxActor*> actors(scene.getNbActors(kTypes));
+	if (!actors.empty())
+		scene.getActors(kTypes, actors.data(), (PxU32)actors.size());
+	for (size_t i = 0; i != actors.size(); i++)
+		actors[i]->release();
+
+	// articulationはリンクも一緒に解放される
+	vector<PxArticulationBase*> articulations(scene.getNbArticulations());
+	if (!articulations.empty())
+		scene.getArticulations(articulations.data(), (PxU32)articulations.size());
+	for (size_t i = 0; i != articulations.size(); i++)
+		articulations[i]->release();
+
+	// PxAggregateを解放しても中のアクターは解放されないので最後に解放する
+	vector<PxAggregate*> aggregates(scene.getNbAggregates());
+	if (!aggregates.empty())
+		scene.getAggregates(aggregates.data(), (PxU32)aggregates.size());
+	for (size_t i = 0; i != aggregates.size(); i++)
+		aggregates[i]->release();
+
+	scene.release();
+}
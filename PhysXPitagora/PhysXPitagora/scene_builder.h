@@ -0,0 +1,93 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "shape_cache.h"
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// アクターを作成し、シーンへの追加をまとめて行う
+// batchedの場合は、作成したアクターをflushでPxScene::addActorsにより1度に追加する
+// beginAggregateとendAggregateの間に作成したdynamic actorはPxAggregateにまとめ、
+// broadphaseではPxAggregateごとに1つのバウンディングボックスとして扱われるようにする
+//
+// shape_cacheを渡した場合は、同じ形のアクターでshapeを共有する
+//
+// シーンに追加する前のアクターはputToSleepできないので、builderのputToSleepを使う
+class SceneBuilder {
+public:
+	// batched: falseの場合はアクターを作成するたびにaddActorする(PxAggregateも使わない)
+	// shape_cache: NULLの場合はアクターごとにshapeを作成する
+	SceneBuilder(PxPhysics &physics, PxScene &scene, bool batched, ShapeCache* shape_cache = NULL);
+	~SceneBuilder();
+
+	// Dynamic Rigidbodyの作成
+	PxRigidDynamic* createDynamic(const PxTransform &t, const PxGeometry &geometry, PxMaterial &material,
+		PxReal density = 10.0f);
+
+	// Static Rigidbodyの作成
+	PxRigidStatic* createStatic(const PxTransform &t, const PxGeometry &geometry, PxMaterial &material);
+
+	// 同じ形のshapeをlocal_posesの位置に複数持つDynamic Rigidbodyの作成(FractureCompound用)
+	// shapeは位置が異なるので共有しない
+	PxRigidDynamic* createCompound(const PxTransform &t, const PxGeometry &geometry,
+		const vector<PxTransform> &local_poses, PxMaterial &material, PxReal density = 10.0f);
+
+	// articulationのリンクの作成(shapeとフィルタデータはアクターと同じように設定する)
+	// parent: NULLの場合はルートのリンク
+	PxArticulationLink* createLink(PxArticulationReducedCoordinate &articulation, PxArticulationLink* parent,
+		const PxTransform &t, const PxGeometry &geometry, PxMaterial &material, PxReal density = 10.0f);
+
+	// リンクを作成し終えたarticulationをシーンに追加する
+	// PxAggregateには入れない(articulationのリンクはまとめてbroadphaseに登録される)
+	// sleep: 追加した後にスリープさせる
+	void addArticulation(PxArticulationReducedCoordinate &articulation, bool sleep);
+
+	// 以降endAggregateまでに作成するdynamic actorを空間的にまとまった1つのグループとする
+	// actor_cnt: グループのアクター数(kMaxAggregateActorCntを超える分は別のPxAggregateにする)
+	// self_collision: グループ内のアクター同士で衝突させるか
+	void beginAggregate(PxU32 actor_cnt, bool self_collision);
+	void endAggregate();
+
+	// 以降に作成するアクターのshapeに設定するシミュレーションのフィルタデータ(既定は全て0)
+	void setSimulationFilterData(const PxFilterData &filter_data) { filter_data_ = filter_data; }
+
+	// シーンに追加した後にスリープさせる
+	void putToSleep(PxRigidDynamic &actor);
+
+	// 溜めたアクターとPxAggregateをシーンに追加する(デストラクタでも呼ばれる)
+	void flush();
+
+	// 作成したPxAggregateの数
+	PxU32 getAggregateCount() const { return aggregate_cnt_; }
+
+private:
+	static const PxU32 kMaxAggregateActorCnt = 128;  // PxAggregateに入れられるアクター数の上限
+
+	PxPhysics &physics_;
+	PxScene &scene_;
+	bool batched_;
+	ShapeCache* shape_cache_;
+	PxFilterData filter_data_;
+
+	vector<PxActor*> actors_;               // addActorsで追加するアクター
+	vector<PxAggregate*> aggregates_;       // addAggregateで追加するPxAggregate
+	vector<PxRigidDynamic*> sleep_actors_;  // 追加後にスリープさせるアクター
+	vector<PxArticulationReducedCoordinate*> articulations_;        // addArticulationで追加するarticulation
+	vector<PxArticulationReducedCoordinate*> sleep_articulations_;  // 追加後にスリープさせるarticulation
+
+	// 作成中のグループ
+	bool in_aggregate_;
+	bool self_collision_;
+	PxU32 aggregate_remaining_cnt_;  // グループのまだ作成していないアクター数
+	PxAggregate* aggregate_;         // 作成中のPxAggregate(満杯になったら次を作る)
+	PxU32 aggregate_cnt_;
+
+	PxShape* getSharedShape(const PxGeometry &geometry, PxMaterial &material);
+	void setFilterData(PxRigidActor &actor);
+	void addActor(PxRigidActor &actor, bool dynamic);
+};
+
+// シーンに追加したjoint、アクター、articulation、PxAggregateを解放してからシーンを解放する
+// (PxScene::releaseはこれらをシーンから外すだけで解放しない)
+void releaseScene(PxScene &scene);
@@ -0,0 +1,168 @@
+#include "scene_checkpoint.h"
+
+
+using namespace std;
+
+// articulationのキャッシュで保存・復元する内容
+static const PxArticulationCacheFlags kArticulationCacheFlags
+	= PxArticulationCache::ePOSITION | PxArticulationCache::eVELOCITY | PxArticulationCache::eROOT;
+
+void SceneCheckpoint::capture(PxScene &scene, PxU32 step)
+{
+	clear();
+	step_ = step;
+
+	const PxU32 kActorCnt = scene.getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+	vector<PxActor*> actors(kActorCnt);
+	if (kActorCnt)
+		scene.getActors(PxActorTypeFlag::eRIGID_DYNAMIC, actors.data(), kActorCnt);
+
+	actors_.resize(kActorCnt);
+	for (PxU32 i = 0; i != kActorCnt; i++) {
+		PxRigidDynamic* actor = static_cast<PxRigidDynamic*>(actors[i]);
+		ActorState &state = actors_[i];
+		state.actor = actor;
+		state.pose = actor->getGlobalPose();
+		state.kinematic = actor->getRigidBodyFlags() & PxRigidBodyFlag::eKINEMATIC;
+		state.linear_velocity = state.kinematic ? PxVec3(0.0f) : actor->getLinearVelocity();
+		state.angular_velocity = state.kinematic ? PxVec3(0.0f) : actor->getAngularVelocity();
+		state.wake_counter = actor->getWakeCounter();
+		state.sleeping = actor->isSleeping();
+		state.has_target = state.kinematic && actor->getKinematicTarget(state.target);
+	}
+
+	// articulationのリンクはgetActorsに含まれないので、関節の状態とルートの状態から戻す
+	const PxU32 kArticulationCnt = scene.getNbArticulations();
+	vector<PxArticulationBase*> articulations(kArticulationCnt);
+	if (kArticulationCnt)
+		scene.getArticulations(articulations.data(), kArticulationCnt);
+	for (PxU32 i = 0; i != kArticulationCnt; i++) {
+		if (articulations[i]->getConcreteType() != PxConcreteType::eARTICULATION_REDUCED_COORDINATE)
+			continue;
+		ArticulationState state;
+		state.articulation = static_cast<PxArticulationReducedCoordinate*>(articulations[i]);
+		state.cache = state.articulation->createCache();
+		state.articulation->copyInternalStateToCache(*state.cache, kArticulationCacheFlags);
+		state.wake_counter = state.articulation->getWakeCounter();
+		state.sleeping = state.articulation->isSleeping();
+		articulations_.push_back(state);
+	}
+
+	const PxU32 kConstraintCnt = scene.getNbConstraints();
+	vector<PxConstraint*> constraints(kConstraintCnt);
+	if (kConstraintCnt)
+		scene.getConstraints(constraints.data(), kConstraintCnt);
+
+	joints_.resize(kConstraintCnt);
+	for (PxU32 i = 0; i != kConstraintCnt; i++) {
+		joints_[i].constraint = constraints[i];
+		joints_[i].broken = constraints[i]->getFlags() & PxConstraintFlag::eBROKEN;
+	}
+}
+
+bool SceneCheckpoint::restore() const
+{
+	for (size_t i = 0; i != actors_.size(); i++) {
+		const ActorState &state = actors_[i];
+		PxRigidDynamic &actor = *state.actor;
+
+		if (state.kinematic) {
+			actor.setGlobalPose(state.pose, false);
+			if (state.has_target)
+				actor.setKinematicTarget(state.target);
+			continue;
+		}
+
+		// 速度を戻してからスリープ状態を戻す(putToSleepは速度を0にする)
+		// 起きていたアクターは、wake counterが0でも眠っているアクターと区別するためにwakeUpしてから戻す
+		actor.setGlobalPose(state.pose, false);
+		actor.setLinearVelocity(state.linear_velocity, false);
+		actor.setAngularVelocity(state.angular_velocity, false);
+		if (state.sleeping) {
+			actor.putToSleep();
+		}
+		else {
+			actor.wakeUp();
+			actor.setWakeCounter(state.wake_counter);
+		}
+	}
+
+	for (size_t i = 0; i != articulations_.size(); i++) {
+		const ArticulationState &state = articulations_[i];
+		PxArticulationReducedCoordinate &articulation = *state.articulation;
+		articulation.applyCache(*state.cache, kArticulationCacheFlags, false);
+		if (state.sleeping) {
+			articulation.putToSleep();
+		}
+		else {
+			articulation.wakeUp();
+			articulation.setWakeCounter(state.wake_counter);
+		}
+	}
+
+	// 壊れたjointは戻せない(eBROKENは読み取り専用)
+	bool restored = true;
+	for (size_t i = 0; i != joints_.size(); i++) {
+		const bool kBroken = joints_[i].constraint->getFlags() & PxConstraintFlag::eBROKEN;
+		if (kBroken && !joints_[i].broken)
+			restored = false;
+	}
+	return restored;
+}
+
+bool SceneCheckpoint::matches() const
+{
+	for (size_t i = 0; i != actors_.size(); i++) {
+		const ActorState &state = actors_[i];
+		const PxRigidDynamic &actor = *state.actor;
+		if (!(actor.getGlobalPose() == state.pose))
+			return false;
+
+		if (state.kinematic) {
+			PxTransform target;
+			const bool kHasTarget = actor.getKinematicTarget(target);
+			if (kHasTarget != state.has_target
+				|| (kHasTarget && !(target == state.target)))
+				return false;
+			continue;
+		}
+
+		if (actor.getLinearVelocity() != state.linear_velocity
+			|| actor.getAngularVelocity() != state.angular_velocity
+			|| actor.isSleeping() != state.sleeping
+			|| actor.getWakeCounter() != state.wake_counter)
+			return false;
+	}
+
+	// articulationは現在の状態をキャッシュに読み出して比べる
+	for (size_t i = 0; i != articulations_.size(); i++) {
+		const ArticulationState &state = articulations_[i];
+		const PxArticulationReducedCoordinate &articulation = *state.articulation;
+		if (articulation.isSleeping() != state.sleeping || articulation.getWakeCounter() != state.wake_counter)
+			return false;
+
+		PxArticulationCache* current = articulation.createCache();
+		articulation.copyInternalStateToCache(*current, kArticulationCacheFlags);
+		bool same = current->rootLinkData->transform == state.cache->rootLinkData->transform
+			&& current->rootLinkData->worldLinVel == state.cache->rootLinkData->worldLinVel
+			&& current->rootLinkData->worldAngVel == state.cache->rootLinkData->worldAngVel;
+		const PxU32 kDofCnt = articulation.getDofs();
+		for (PxU32 d = 0; d != kDofCnt && same; d++) {
+			same = current->jointPosition[d] == state.cache->jointPosition[d]
+				&& current->jointVelocity[d] == state.cache->jointVelocity[d];
+		}
+		articulation.releaseCache(*current);
+		if (!same)
+			return false;
+	}
+	return true;
+}
+
+void SceneCheckpoint::clear()
+{
+	for (size_t i = 0; i != articulations_.size(); i++)
+		articulations_[i].articulation->releaseCache(*articulations_[i].cache);
+	articulations_.clear();
+	actors_.clear();
+	joints_.clear();
+}
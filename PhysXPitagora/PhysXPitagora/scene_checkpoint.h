@@ -0,0 +1,69 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// シミュレーション途中の状態をメモリ上に保存し、同じシーンに戻す
+// 同じ前半のステップから、設定を変えた複数の後半の実行を分岐させるために使う
+//
+// 保存するのは、dynamic actorの姿勢・速度・スリープ状態・kinematic target、jointが壊れているか、
+// articulationの関節の角度・速度とルートのリンクの姿勢・速度(PxArticulationCache)とスリープ状態
+// 接触のキャッシュなどPhysX内部の状態は保存できないので、再開後の結果は連続した実行と完全には一致しない
+// 保存と復元はsimulateからfetchResultsまでの間には行わないこと。また、保存後にアクターやjointを解放しないこと
+// articulationのキャッシュを解放するので、シーンを解放する前にclearする
+class SceneCheckpoint {
+public:
+	SceneCheckpoint() : step_(0) {}
+	~SceneCheckpoint() { clear(); }
+	SceneCheckpoint(const SceneCheckpoint&) = delete;
+	SceneCheckpoint& operator=(const SceneCheckpoint&) = delete;
+
+	// sceneの状態を保存する。stepは次に実行するステップ番号
+	void capture(PxScene &scene, PxU32 step);
+
+	// 保存した状態をアクターに戻す(保存後に追加したアクターは変更しない)
+	// jointは壊れた状態から戻せないので、保存後に壊れたjointがあればfalse
+	bool restore() const;
+
+	// アクターの現在の姿勢・速度・スリープ状態・wake counterが保存した値と一致するか(restore直後の確認用)
+	bool matches() const;
+
+	// 保存した状態を捨てる
+	void clear();
+
+	PxU32 getStep() const { return step_; }
+	size_t getActorCount() const { return actors_.size(); }
+	size_t getArticulationCount() const { return articulations_.size(); }
+
+private:
+	struct ActorState {
+		PxRigidDynamic* actor;
+		PxTransform pose;
+		PxVec3 linear_velocity;
+		PxVec3 angular_velocity;
+		PxReal wake_counter;
+		bool sleeping;
+		bool kinematic;
+		bool has_target;        // kinematic targetが設定されているか
+		PxTransform target;
+	};
+
+	struct ArticulationState {
+		PxArticulationReducedCoordinate* articulation;
+		PxArticulationCache* cache;
+		PxReal wake_counter;
+		bool sleeping;
+	};
+
+	struct JointState {
+		PxConstraint* constraint;
+		bool broken;
+	};
+
+	PxU32 step_;
+	vector<ActorState> actors_;
+	vector<ArticulationState> articulations_;
+	vector<JointState> joints_;
+};
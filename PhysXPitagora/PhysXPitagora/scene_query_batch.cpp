@@ -0,0 +1,153 @@
+#include "scene_query_batch.h"
+#include <thread>
+
+
+using namespace std;
+
+SceneQueryBatch::SceneQueryBatch(PxCpuDispatcher &dispatcher)
+	: dispatcher_(dispatcher), next_chunk_(0), running_task_cnt_(0), hit_query_cnt_(0)
+{
+	tasks_.resize(dispatcher.getWorkerCount());
+	for (size_t i = 0; i != tasks_.size(); i++)
+		tasks_[i].setBatch(*this);
+}
+
+SceneQueryBatch::~SceneQueryBatch()
+{
+}
+
+PxU32 SceneQueryBatch::raycast(PxScene &scene, const RaycastQuery* queries, PxU32 query_cnt, QueryHit* hits)
+{
+	Job job = {};
+	job.type = SceneQueryType::eRAYCAST;
+	job.scene = &scene;
+	job.queries = queries;
+	job.query_cnt = query_cnt;
+	job.hits = hits;
+	return execute(job);
+}
+
+PxU32 SceneQueryBatch::sweep(PxScene &scene, const PxGeometry &geometry, const SweepQuery* queries,
+	PxU32 query_cnt, QueryHit* hits)
+{
+	Job job = {};
+	job.type = SceneQueryType::eSWEEP;
+	job.scene = &scene;
+	job.geometry = &geometry;
+	job.queries = queries;
+	job.query_cnt = query_cnt;
+	job.hits = hits;
+	return execute(job);
+}
+
+PxU32 SceneQueryBatch::overlap(PxScene &scene, const PxGeometry &geometry, const PxTransform* poses,
+	PxU32 query_cnt, PxOverlapHit* hits, PxU32 max_hit_cnt, PxU32* hit_cnts)
+{
+	Job job = {};
+	job.type = SceneQueryType::eOVERLAP;
+	job.scene = &scene;
+	job.geometry = &geometry;
+	job.queries = poses;
+	job.query_cnt = query_cnt;
+	job.overlap_hits = hits;
+	job.max_hit_cnt = max_hit_cnt;
+	job.hit_cnts = hit_cnts;
+	return execute(job);
+}
+
+PxU32 SceneQueryBatch::execute(const Job &job)
+{
+	job_ = job;
+	next_chunk_ = 0;
+	hit_query_cnt_ = 0;
+
+	// 移動したアクターのクエリ用の構造への反映は最初のクエリで行われるので、
+	// 複数のスレッドから同時にクエリする前に済ませておく
+	job.scene->flushQueryUpdates();
+
+	// チャンクが1つしかない場合はワーカーに渡さない
+	const PxU32 kChunkCnt = (job.query_cnt + kChunkQueryCnt - 1) / kChunkQueryCnt;
+	const PxU32 kTaskCnt = PxMin((PxU32)tasks_.size(), kChunkCnt > 0 ? kChunkCnt - 1 : 0);
+	running_task_cnt_ = kTaskCnt;
+	for (PxU32 i = 0; i != kTaskCnt; i++)
+		dispatcher_.submitTask(tasks_[i]);
+
+	// 呼び出したスレッドも1つのタスクとしてチャンクを受け持ち、残りのタスクの終了を待つ
+	runChunks();
+	while (running_task_cnt_.load(memory_order_acquire) != 0)
+		this_thread::yield();
+	return hit_query_cnt_;
+}
+
+void SceneQueryBatch::runChunks()
+{
+	PxU32 hit_cnt = 0;
+	while (true) {
+		const PxU32 kBegin = next_chunk_.fetch_add(1) * kChunkQueryCnt;
+		if (kBegin >= job_.query_cnt)
+			break;
+		const PxU32 kEnd = PxMin(kBegin + kChunkQueryCnt, job_.query_cnt);
+		for (PxU32 i = kBegin; i != kEnd; i++)
+			hit_cnt += runQuery(i);
+	}
+	hit_query_cnt_.fetch_add(hit_cnt);
+}
+
+// index番目のクエリを実行して結果を書き出し、ヒットした場合は1を返す
+PxU32 SceneQueryBatch::runQuery(PxU32 index) const
+{
+	const PxQueryFilterData kFilterData(PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC);
+
+	switch (job_.type) {
+	case SceneQueryType::eRAYCAST: {
+		const RaycastQuery &query = static_cast<const RaycastQuery*>(job_.queries)[index];
+		PxRaycastBuffer buffer;
+		job_.scene->raycast(query.origin, query.unit_dir, query.distance, buffer,
+			PxHitFlag::eDEFAULT, kFilterData);
+
+		QueryHit &hit = job_.hits[index];
+		hit.actor = buffer.hasBlock ? buffer.block.actor : NULL;
+		hit.shape = buffer.hasBlock ? buffer.block.shape : NULL;
+		hit.position = buffer.hasBlock ? buffer.block.position : PxVec3(0.0f);
+		hit.normal = buffer.hasBlock ? buffer.block.normal : PxVec3(0.0f);
+		hit.distance = buffer.hasBlock ? buffer.block.distance : query.distance;
+		return buffer.hasBlock ? 1 : 0;
+	}
+	case SceneQueryType::eSWEEP: {
+		const SweepQuery &query = static_cast<const SweepQuery*>(job_.queries)[index];
+		PxSweepBuffer buffer;
+		job_.scene->sweep(*job_.geometry, query.pose, query.unit_dir, query.distance, buffer,
+			PxHitFlag::eDEFAULT, kFilterData);
+
+		QueryHit &hit = job_.hits[index];
+		hit.actor = buffer.hasBlock ? buffer.block.actor : NULL;
+		hit.shape = buffer.hasBlock ? buffer.block.shape : NULL;
+		hit.position = buffer.hasBlock ? buffer.block.position : PxVec3(0.0f);
+		hit.normal = buffer.hasBlock ? buffer.block.normal : PxVec3(0.0f);
+		hit.distance = buffer.hasBlock ? buffer.block.distance : query.distance;
+		return buffer.hasBlock ? 1 : 0;
+	}
+	case SceneQueryType::eOVERLAP: {
+		// 全ての重なりをtouchとして受け取る(blockにすると1つしか返らない)
+		const PxTransform &pose = static_cast<const PxTransform*>(job_.queries)[index];
+		PxOverlapBuffer buffer(job_.overlap_hits + (size_t)index * job_.max_hit_cnt, job_.max_hit_cnt);
+		job_.scene->overlap(*job_.geometry, pose, buffer,
+			PxQueryFilterData(PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC | PxQueryFlag::eNO_BLOCK));
+
+		job_.hit_cnts[index] = buffer.getNbTouches();
+		return buffer.getNbTouches() ? 1 : 0;
+	}
+	}
+	return 0;
+}
+
+void SceneQueryBatch::ChunkTask::run()
+{
+	batch_->runChunks();
+}
+
+// ディスパッチャはrunの後にreleaseを呼ぶ
+void SceneQueryBatch::ChunkTask::release()
+{
+	batch_->running_task_cnt_.fetch_sub(1, memory_order_release);
+}
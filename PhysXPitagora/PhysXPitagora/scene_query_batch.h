@@ -0,0 +1,106 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <atomic>
+
+using namespace std;
+using namespace physx;
+
+// クエリの種類
+struct SceneQueryType {
+	enum Enum {
+		eRAYCAST,
+		eSWEEP,
+		eOVERLAP
+	};
+};
+
+// 1本のレイ
+struct RaycastQuery {
+	PxVec3 origin;
+	PxVec3 unit_dir;
+	PxReal distance;
+};
+
+// 形状を動かす1回のsweep(形状はバッチ内で共通)
+struct SweepQuery {
+	PxTransform pose;
+	PxVec3 unit_dir;
+	PxReal distance;
+};
+
+// raycast, sweepの最も近いヒット(actorがNULLの場合はヒットしなかった)
+struct QueryHit {
+	PxRigidActor* actor;
+	PxShape* shape;
+	PxVec3 position;
+	PxVec3 normal;
+	PxReal distance;
+};
+
+// 多数のraycast, sweep, overlapを、ディスパッチャのワーカースレッドに分けて実行する
+// クエリはkChunkQueryCnt個ずつに分け、ワーカー数+1個のタスク(呼び出したスレッドを含む)が空いた順に受け持つ
+// 結果は呼び出し側が確保したバッファに、クエリと同じ順に書き出す(実行中にメモリを確保しない)
+//
+// fetchResultsの後、次のsimulateの前に呼ぶこと(実行中は同じシーンに書き込まない)
+// 実行前にPxScene::flushQueryUpdatesでクエリ用の構造を更新しておき、ワーカースレッドからは読み出しのみを行う
+class SceneQueryBatch {
+public:
+	// dispatcher: タスクの投入先(シミュレーションと同じものでよい)
+	explicit SceneQueryBatch(PxCpuDispatcher &dispatcher);
+	~SceneQueryBatch();
+
+	SceneQueryBatch(const SceneQueryBatch&) = delete;
+	SceneQueryBatch& operator=(const SceneQueryBatch&) = delete;
+
+	// 各レイの最も近いヒットをhits[i]に書き出し、ヒットしたレイの数を返す
+	PxU32 raycast(PxScene &scene, const RaycastQuery* queries, PxU32 query_cnt, QueryHit* hits);
+
+	// geometryを各姿勢から動かした時の最も近いヒットをhits[i]に書き出し、ヒットした数を返す
+	PxU32 sweep(PxScene &scene, const PxGeometry &geometry, const SweepQuery* queries, PxU32 query_cnt,
+		QueryHit* hits);
+
+	// geometryを各姿勢に置いた時に重なるshapeを、hits[i * max_hit_cnt]から最大max_hit_cnt個書き出す
+	// 重なった数(最大max_hit_cnt)をhit_cnts[i]に書き出し、重なりのあったクエリの数を返す
+	PxU32 overlap(PxScene &scene, const PxGeometry &geometry, const PxTransform* poses, PxU32 query_cnt,
+		PxOverlapHit* hits, PxU32 max_hit_cnt, PxU32* hit_cnts);
+
+private:
+	static const PxU32 kChunkQueryCnt = 64;  // 1度に受け持つクエリ数
+
+	// 実行中のバッチ
+	struct Job {
+		SceneQueryType::Enum type;
+		PxScene* scene;
+		const PxGeometry* geometry;
+		const void* queries;
+		PxU32 query_cnt;
+		QueryHit* hits;
+		PxOverlapHit* overlap_hits;
+		PxU32 max_hit_cnt;
+		PxU32* hit_cnts;
+	};
+
+	// 空いたチャンクを受け持つタスク
+	class ChunkTask : public PxLightCpuTask {
+	public:
+		ChunkTask() : batch_(NULL) {}
+		void setBatch(SceneQueryBatch &batch) { batch_ = &batch; }
+		virtual void run();
+		virtual const char* getName() const { return "SceneQueryBatch"; }
+		virtual void release();
+	private:
+		SceneQueryBatch* batch_;
+	};
+
+	PxCpuDispatcher &dispatcher_;
+	vector<ChunkTask> tasks_;
+	Job job_;
+	atomic<PxU32> next_chunk_;
+	atomic<PxU32> running_task_cnt_;  // 投入してまだ終わっていないタスク数
+	atomic<PxU32> hit_query_cnt_;
+
+	PxU32 execute(const Job &job);
+	void runChunks();
+	PxU32 runQuery(PxU32 index) const;
+};
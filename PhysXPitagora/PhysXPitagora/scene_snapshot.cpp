@@ -0,0 +1,187 @@
+#include "scene_snapshot.h"
+#include <fstream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+using namespace std;
+
+SceneSnapshot::SceneSnapshot()
+	: registry_(NULL), collection_(NULL), data_(NULL), size_(0), mapped_(false)
+#if defined(_WIN32)
+	, file_handle_(NULL), mapping_handle_(NULL)
+#endif
+{
+}
+
+SceneSnapshot::~SceneSnapshot()
+{
+	unload();
+}
+
+bool SceneSnapshot::save(PxPhysics &physics, PxScene &scene, const vector<PxRigidDynamic*> &pushers,
+	const string &file_path)
+{
+	PxSerializationRegistry* registry = PxSerialization::createSerializationRegistry(physics);
+
+	// シーンのアクター、PxAggregate、jointを集め、参照しているshapeとmaterialを加える
+	PxCollection* collection = PxCollectionExt::createCollection(scene);
+	for (size_t i = 0; i != pushers.size(); i++)
+		collection->addId(*pushers[i], kPusherIdBase + i);
+	PxSerialization::complete(*collection, *registry);
+
+	PxDefaultFileOutputStream stream(file_path.c_str());
+	const bool kResult = stream.isValid()
+		&& PxSerialization::serializeCollectionToBinary(stream, *collection, *registry);
+
+	collection->release();
+	registry->release();
+	return kResult;
+}
+
+bool SceneSnapshot::load(PxPhysics &physics, PxScene &scene, const string &file_path,
+	vector<PxRigidDynamic*> &pushers, bool use_mapping)
+{
+	unload();
+	if (!(use_mapping ? mapFile(file_path) : readFile(file_path)))
+		return false;
+
+	// デシリアライズしたオブジェクトはdata_上に作られる
+	registry_ = PxSerialization::createSerializationRegistry(physics);
+	collection_ = PxSerialization::createCollectionFromBinary(data_, *registry_);
+	if (!collection_) {
+		unload();
+		return false;
+	}
+
+	// wake counterが0のアクターはスリープしたまま追加される
+	scene.addCollection(*collection_);
+
+	pushers.clear();
+	for (PxSerialObjectId id = kPusherIdBase; ; id++) {
+		PxBase* object = collection_->find(id);
+		if (!object || !object->is<PxRigidDynamic>())
+			break;
+		pushers.push_back(object->is<PxRigidDynamic>());
+	}
+	return true;
+}
+
+// オブジェクトがdata_を参照しているので、オブジェクトを先に解放する
+void SceneSnapshot::unload()
+{
+	if (collection_) {
+		PxCollectionExt::releaseObjects(*collection_);
+		collection_->release();
+		collection_ = NULL;
+	}
+	if (registry_) {
+		registry_->release();
+		registry_ = NULL;
+	}
+	closeFile();
+}
+
+// コピーオンライトでマップする(デシリアライズでポインタを書き換えるため)
+// マップの先頭はページ境界なので、PX_SERIAL_FILE_ALIGNの128byte境界にも揃っている
+bool SceneSnapshot::mapFile(const string &file_path)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	void* view = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping)
+		view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!view) {
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle_ = file;
+	mapping_handle_ = mapping;
+	data_ = view;
+	size_ = (size_t)size.QuadPart;
+	mapped_ = true;
+	return true;
+#elif defined(__linux__) || defined(__APPLE__)
+	const int kFile = open(file_path.c_str(), O_RDONLY);
+	if (kFile < 0)
+		return false;
+
+	struct stat file_stat;
+	void* view = MAP_FAILED;
+	if (fstat(kFile, &file_stat) == 0 && file_stat.st_size > 0)
+		view = mmap(NULL, (size_t)file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, kFile, 0);
+	close(kFile);  // マップはファイルを閉じても残る
+	if (view == MAP_FAILED)
+		return false;
+
+	data_ = view;
+	size_ = (size_t)file_stat.st_size;
+	mapped_ = true;
+	return true;
+#else
+	return readFile(file_path);
+#endif
+}
+
+// 128byte境界に揃えたバッファへ読み込む
+bool SceneSnapshot::readFile(const string &file_path)
+{
+	ifstream file(file_path, ios::binary | ios::ate);
+	if (!file)
+		return false;
+	const size_t kSize = (size_t)file.tellg();
+	if (kSize == 0)
+		return false;
+
+	buffer_.resize(kSize + PX_SERIAL_FILE_ALIGN - 1);
+	const size_t kAddress = reinterpret_cast<size_t>(buffer_.data());
+	char* data = buffer_.data() + ((PX_SERIAL_FILE_ALIGN - kAddress % PX_SERIAL_FILE_ALIGN) % PX_SERIAL_FILE_ALIGN);
+	file.seekg(0);
+	if (!file.read(data, kSize)) {
+		vector<char>().swap(buffer_);
+		return false;
+	}
+
+	data_ = data;
+	size_ = kSize;
+	mapped_ = false;
+	return true;
+}
+
+void SceneSnapshot::closeFile()
+{
+	if (mapped_) {
+#if defined(_WIN32)
+		UnmapViewOfFile(data_);
+		CloseHandle(mapping_handle_);
+		CloseHandle(file_handle_);
+		mapping_handle_ = NULL;
+		file_handle_ = NULL;
+#elif defined(__linux__) || defined(__APPLE__)
+		munmap(data_, size_);
+#endif
+	}
+	vector<char>().swap(buffer_);
+	data_ = NULL;
+	size_ = 0;
+	mapped_ = false;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace physx;
+
+// シーンのスナップショット(PxSerializationのバイナリ形式)
+// アクター、shape、material、joint、PxAggregateと、スリープ状態を保存する
+// シーン自体の設定(重力、ディスパッチャなど)は含まないので、読み込み先のシーンは別に作成する
+//
+// 読み込みは、ファイルをコピーオンライトでメモリマップし、その場でデシリアライズする
+// デシリアライズしたオブジェクトはマップしたメモリ上に置かれるので、unloadまでマップを閉じない
+class SceneSnapshot {
+public:
+	SceneSnapshot();
+	~SceneSnapshot();
+
+	// sceneの全オブジェクトをfile_pathへ書き出す
+	// pushersにはシリアルIDを付けて保存し、loadで取り出せるようにする
+	static bool save(PxPhysics &physics, PxScene &scene, const vector<PxRigidDynamic*> &pushers,
+		const string &file_path);
+
+	// file_pathのスナップショットを読み込んでsceneに追加し、保存したpushersを返す
+	// use_mapping: falseの場合はファイルを128byte境界に揃えたバッファへ読み込む
+	bool load(PxPhysics &physics, PxScene &scene, const string &file_path, vector<PxRigidDynamic*> &pushers,
+		bool use_mapping = true);
+
+	// 読み込んだオブジェクトを解放し、メモリを閉じる
+	void unload();
+
+	// 読み込んだデータの大きさ(byte)
+	size_t getSize() const { return size_; }
+
+private:
+	static const PxSerialObjectId kPusherIdBase = 1;  // pushersのシリアルID(1から連番)
+
+	PxSerializationRegistry* registry_;
+	PxCollection* collection_;
+
+	// スナップショットのデータ
+	void* data_;             // 128byte境界に揃えた先頭
+	size_t size_;
+	bool mapped_;            // trueならメモリマップ、falseならbuffer_
+	vector<char> buffer_;    // メモリマップを使わない場合の読み込み先
+#if defined(_WIN32)
+	void* file_handle_;
+	void* mapping_handle_;
+#endif
+
+	bool mapFile(const string &file_path);
+	bool readFile(const string &file_path);
+	void closeFile();
+};
@@ -0,0 +1,79 @@
+#include "shape_cache.h"
+#include <functional>
+
+
+using namespace std;
+
+ShapeCache::ShapeCache(PxPhysics &physics)
+	: physics_(physics), hit_cnt_(0)
+{
+}
+
+ShapeCache::~ShapeCache()
+{
+	for (map<Key, PxShape*>::iterator it = shapes_.begin(); it != shapes_.end(); ++it)
+		it->second->release();
+}
+
+PxShape* ShapeCache::getShape(const PxGeometry &geometry, PxMaterial &material,
+	const PxFilterData &filter_data, PxShapeFlags flags)
+{
+	Key key;
+	key.type = geometry.getType();
+	key.dimensions[0] = key.dimensions[1] = key.dimensions[2] = 0.0f;
+	key.material = &material;
+	key.filter_words[0] = filter_data.word0;
+	key.filter_words[1] = filter_data.word1;
+	key.filter_words[2] = filter_data.word2;
+	key.filter_words[3] = filter_data.word3;
+	key.flags = (PxU8)flags;
+
+	switch (key.type) {
+	case PxGeometryType::eBOX: {
+		const PxVec3 &half_extents = static_cast<const PxBoxGeometry&>(geometry).halfExtents;
+		key.dimensions[0] = half_extents.x;
+		key.dimensions[1] = half_extents.y;
+		key.dimensions[2] = half_extents.z;
+		break;
+	}
+	case PxGeometryType::eSPHERE:
+		key.dimensions[0] = static_cast<const PxSphereGeometry&>(geometry).radius;
+		break;
+	case PxGeometryType::eCAPSULE:
+		key.dimensions[0] = static_cast<const PxCapsuleGeometry&>(geometry).radius;
+		key.dimensions[1] = static_cast<const PxCapsuleGeometry&>(geometry).halfHeight;
+		break;
+	default:
+		return NULL;
+	}
+
+	map<Key, PxShape*>::iterator it = shapes_.find(key);
+	if (it != shapes_.end()) {
+		hit_cnt_++;
+		return it->second;
+	}
+
+	PxShape* shape = physics_.createShape(geometry, material, false, flags);
+	if (shape) {
+		shape->setSimulationFilterData(filter_data);
+		shapes_[key] = shape;
+	}
+	return shape;
+}
+
+bool ShapeCache::Key::operator<(const Key &other) const
+{
+	if (type != other.type)
+		return type < other.type;
+	for (int i = 0; i != 3; i++) {
+		if (dimensions[i] != other.dimensions[i])
+			return dimensions[i] < other.dimensions[i];
+	}
+	if (material != other.material)
+		return less<const PxMaterial*>()(material, other.material);
+	for (int i = 0; i != 4; i++) {
+		if (filter_words[i] != other.filter_words[i])
+			return filter_words[i] < other.filter_words[i];
+	}
+	return flags < other.flags;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <map>
+
+using namespace std;
+using namespace physx;
+
+// 形状・寸法・material・フィルタデータ・flagsが同じshapeを複数のアクターで共有する(isExclusive = false)
+// PxCreateDynamic/PxCreateStaticにgeometryを渡すとアクターごとにshapeが作られるので、
+// ドミノや構造物の箱のように同じ形のアクターが多い場合にshapeの数とメモリを減らせる
+//
+// shapeの寸法やflagsを後から変更すると共有している全てのアクターに反映されるので、変更しないこと
+class ShapeCache {
+public:
+	explicit ShapeCache(PxPhysics &physics);
+	~ShapeCache();  // キャッシュが持つ参照を解放する(アクターに付いたshapeは残る)
+
+	// 条件に合うshapeを返す。無ければ作成する
+	// 共有に対応していない形状(box, sphere, capsule以外)の場合はNULL
+	// filter_data: 作成したshapeに設定するシミュレーションのフィルタデータ
+	PxShape* getShape(const PxGeometry &geometry, PxMaterial &material,
+		const PxFilterData &filter_data = PxFilterData(),
+		PxShapeFlags flags = PxShapeFlag::eVISUALIZATION | PxShapeFlag::eSCENE_QUERY_SHAPE | PxShapeFlag::eSIMULATION_SHAPE);
+
+	// 作成したshapeの数と、作成済みのshapeを返した回数
+	PxU32 getShapeCount() const { return (PxU32)shapes_.size(); }
+	PxU64 getHitCount() const { return hit_cnt_; }
+
+private:
+	struct Key {
+		PxGeometryType::Enum type;
+		PxReal dimensions[3];  // box: 半辺長, sphere: 半径, capsule: 半径と半分の長さ
+		const PxMaterial* material;
+		PxU32 filter_words[4];  // PxFilterData::word0-3
+		PxU8 flags;
+
+		bool operator<(const Key &other) const;
+	};
+
+	PxPhysics &physics_;
+	map<Key, PxShape*> shapes_;
+	PxU64 hit_cnt_;
+};
@@ -0,0 +1,168 @@
+#include "solver_profile.h"
+#include <set>
+
+
+using namespace std;
+
+const vector<SolverProfile>& getSolverProfiles()
+{
+	// name, keep_scene_desc, solver_type, pcm, stabilization, broad_phase_type, mbp_subdiv,
+	// chain(position, velocity), debris(position, velocity)
+	static const vector<SolverProfile> kProfiles = {
+		{ "default", true, PxSolverType::ePGS, true, false, PxBroadPhaseType::eSAP, 0, 64, 1, 4, 1 },
+		{ "pgs", false, PxSolverType::ePGS, true, false, PxBroadPhaseType::eSAP, 0, 32, 1, 4, 1 },
+		{ "tgs", false, PxSolverType::eTGS, true, false, PxBroadPhaseType::eABP, 0, 8, 1, 4, 1 },
+		{ "tgs-stable", false, PxSolverType::eTGS, true, true, PxBroadPhaseType::eABP, 0, 8, 1, 2, 1 },
+		{ "tgs-mbp", false, PxSolverType::eTGS, true, false, PxBroadPhaseType::eMBP, 4, 8, 1, 4, 1 },
+	};
+	return kProfiles;
+}
+
+const SolverProfile* findSolverProfile(const string &name)
+{
+	const vector<SolverProfile> &profiles = getSolverProfiles();
+	for (size_t i = 0; i != profiles.size(); i++) {
+		if (name == profiles[i].name)
+			return &profiles[i];
+	}
+	return NULL;
+}
+
+void applySolverProfile(const SolverProfile &profile, PxSceneDesc &scene_desc)
+{
+	if (profile.keep_scene_desc)
+		return;
+
+	scene_desc.solverType = profile.solver_type;
+	scene_desc.broadPhaseType = profile.broad_phase_type;
+	if (profile.pcm)
+		scene_desc.flags |= PxSceneFlag::eENABLE_PCM;
+	else
+		scene_desc.flags.clear(PxSceneFlag::eENABLE_PCM);
+	if (profile.stabilization)
+		scene_desc.flags |= PxSceneFlag::eENABLE_STABILIZATION;
+	else
+		scene_desc.flags.clear(PxSceneFlag::eENABLE_STABILIZATION);
+}
+
+void applySolverProfile(const SolverProfile &profile, PxScene &scene)
+{
+	// jointで連結されたアクター
+	set<const PxActor*> chain_actors;
+	const PxU32 kConstraintCnt = scene.getNbConstraints();
+	vector<PxConstraint*> constraints(kConstraintCnt);
+	if (kConstraintCnt)
+		scene.getConstraints(constraints.data(), kConstraintCnt);
+	for (PxU32 i = 0; i != kConstraintCnt; i++) {
+		PxU32 type_id;
+		void* reference = constraints[i]->getExternalReference(type_id);
+		if (type_id != PxConstraintExtIDs::eJOINT)
+			continue;
+
+		PxRigidActor *actor0, *actor1;
+		static_cast<PxJoint*>(reference)->getActors(actor0, actor1);
+		chain_actors.insert(actor0);
+		chain_actors.insert(actor1);
+	}
+
+	const PxU32 kActorCnt = scene.getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC);
+	vector<PxActor*> actors(kActorCnt);
+	if (kActorCnt)
+		scene.getActors(PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC, actors.data(), kActorCnt);
+
+	PxBounds3 bounds = PxBounds3::empty();
+	for (PxU32 i = 0; i != kActorCnt; i++) {
+		bounds.include(actors[i]->getWorldBounds());
+		if (actors[i]->getType() != PxActorType::eRIGID_DYNAMIC)
+			continue;
+
+		PxRigidDynamic* actor = static_cast<PxRigidDynamic*>(actors[i]);
+		if (chain_actors.count(actor))
+			actor->setSolverIterationCounts(profile.chain_position_iterations, profile.chain_velocity_iterations);
+		else
+			actor->setSolverIterationCounts(profile.debris_position_iterations, profile.debris_velocity_iterations);
+	}
+
+	// articulationのリンクは全てchainとする
+	const PxU32 kArticulationCnt = scene.getNbArticulations();
+	vector<PxArticulationBase*> articulations(kArticulationCnt);
+	if (kArticulationCnt)
+		scene.getArticulations(articulations.data(), kArticulationCnt);
+	for (PxU32 i = 0; i != kArticulationCnt; i++) {
+		articulations[i]->setSolverIterationCounts(profile.chain_position_iterations, profile.chain_velocity_iterations);
+
+		const PxU32 kLinkCnt = articulations[i]->getNbLinks();
+		vector<PxArticulationLink*> links(kLinkCnt);
+		articulations[i]->getLinks(links.data(), kLinkCnt);
+		for (PxU32 l = 0; l != kLinkCnt; l++)
+			bounds.include(links[l]->getWorldBounds());
+	}
+
+	// MBPは領域の外のアクターを衝突させないので、アクターの範囲を覆う領域を追加する
+	// (落下などで範囲を出る分として上下に余裕を持たせる)
+	if (profile.keep_scene_desc || profile.broad_phase_type != PxBroadPhaseType::eMBP || bounds.isEmpty())
+		return;
+
+	bounds.fattenFast(10.0f);
+	vector<PxBounds3> region_bounds(profile.mbp_subdiv * profile.mbp_subdiv);
+	const PxU32 kRegionCnt = PxBroadPhaseExt::createRegionsFromWorldBounds(
+		region_bounds.data(), bounds, profile.mbp_subdiv);
+	for (PxU32 i = 0; i != kRegionCnt; i++) {
+		PxBroadPhaseRegion region;
+		region.bounds = region_bounds[i];
+		region.userData = NULL;
+		scene.addBroadPhaseRegion(region, true);
+	}
+}
+
+void measureJointDrift(PxScene &scene, JointDrift &drift)
+{
+	const PxU32 kConstraintCnt = scene.getNbConstraints();
+	vector<PxConstraint*> constraints(kConstraintCnt);
+	if (kConstraintCnt)
+		scene.getConstraints(constraints.data(), kConstraintCnt);
+
+	for (PxU32 i = 0; i != kConstraintCnt; i++) {
+		PxU32 type_id;
+		void* reference = constraints[i]->getExternalReference(type_id);
+		if (type_id != PxConstraintExtIDs::eJOINT)
+			continue;
+
+		// 破断したjointは対象外
+		PxJoint* joint = static_cast<PxJoint*>(reference);
+		if (joint->getConstraintFlags() & PxConstraintFlag::eBROKEN)
+			continue;
+
+		PxRigidActor *actor0, *actor1;
+		joint->getActors(actor0, actor1);
+		const PxVec3 kAnchor0 = actor0->getGlobalPose().transform(joint->getLocalPose(PxJointActorIndex::eACTOR0).p);
+		const PxVec3 kAnchor1 = actor1->getGlobalPose().transform(joint->getLocalPose(PxJointActorIndex::eACTOR1).p);
+		const PxReal kError = (kAnchor0 - kAnchor1).magnitude();
+		drift.max_error = PxMax(drift.max_error, kError);
+		drift.total_error += kError;
+		drift.sample_cnt++;
+	}
+
+	// articulationの関節(親のリンクと子のリンクから見た関節の位置)
+	const PxU32 kArticulationCnt = scene.getNbArticulations();
+	vector<PxArticulationBase*> articulations(kArticulationCnt);
+	if (kArticulationCnt)
+		scene.getArticulations(articulations.data(), kArticulationCnt);
+	for (PxU32 i = 0; i != kArticulationCnt; i++) {
+		const PxU32 kLinkCnt = articulations[i]->getNbLinks();
+		vector<PxArticulationLink*> links(kLinkCnt);
+		articulations[i]->getLinks(links.data(), kLinkCnt);
+		for (PxU32 l = 0; l != kLinkCnt; l++) {
+			const PxArticulationJointBase* joint = links[l]->getInboundJoint();
+			if (!joint)
+				continue;
+
+			const PxVec3 kAnchor0 = joint->getParentArticulationLink().getGlobalPose().transform(joint->getParentPose().p);
+			const PxVec3 kAnchor1 = links[l]->getGlobalPose().transform(joint->getChildPose().p);
+			const PxReal kError = (kAnchor0 - kAnchor1).magnitude();
+			drift.max_error = PxMax(drift.max_error, kError);
+			drift.total_error += kError;
+			drift.sample_cnt++;
+		}
+	}
+}
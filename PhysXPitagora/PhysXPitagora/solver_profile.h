@@ -0,0 +1,58 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace physx;
+
+// シーンのソルバー、接触生成、ブロードフェーズと、アクターの反復回数の組み合わせ
+// 反復回数はアクターの役割ごとに設定する
+//  chain : jointで連結されたアクター(振り子の要素など)とarticulation
+//  debris: それ以外の動的アクター(ドミノ、構造物の箱など)
+struct SolverProfile {
+	const char* name;
+	bool keep_scene_desc;  // trueの場合はPxSceneDescを変更しない(PhysXの既定値を使う)
+	PxSolverType::Enum solver_type;
+	bool pcm;              // PxSceneFlag::eENABLE_PCM
+	bool stabilization;    // PxSceneFlag::eENABLE_STABILIZATION
+	PxBroadPhaseType::Enum broad_phase_type;
+	PxU32 mbp_subdiv;      // MBPの場合にシーンの範囲をmbp_subdiv x mbp_subdivの領域に分ける
+	PxU32 chain_position_iterations;
+	PxU32 chain_velocity_iterations;
+	PxU32 debris_position_iterations;
+	PxU32 debris_velocity_iterations;
+};
+
+// 定義済みのプロファイル
+//  default   : PxSceneDescの既定値、振り子はposition iteration 64回(元のサンプルと同じ)
+//  pgs       : PGS + PCM + SAP
+//  tgs       : TGS + PCM + ABP(TGSは少ない反復回数で収束するので振り子も8回)
+//  tgs-stable: tgsに加えてstabilizationを有効にし、debrisの反復回数を減らす
+//  tgs-mbp   : tgsのブロードフェーズをMBPにする
+const vector<SolverProfile>& getSolverProfiles();
+
+// 名前が一致するプロファイル。無ければNULL
+const SolverProfile* findSolverProfile(const string &name);
+
+// シーンを作成する前に、ソルバー、接触生成、ブロードフェーズをsceneDescに設定する
+void applySolverProfile(const SolverProfile &profile, PxSceneDesc &scene_desc);
+
+// アクターを追加した後に、役割ごとの反復回数を設定する
+// MBPの場合は、アクターの範囲を覆うブロードフェーズの領域も追加する
+void applySolverProfile(const SolverProfile &profile, PxScene &scene);
+
+// jointのずれ(2つのアクターから見たjointの位置の距離)
+// 振り子が伸びたり暴れたりすると大きくなる
+struct JointDrift {
+	PxReal max_error;
+	PxReal total_error;
+	PxU32 sample_cnt;
+
+	JointDrift() : max_error(0.0f), total_error(0.0f), sample_cnt(0) {}
+
+	PxReal getMeanError() const { return sample_cnt ? total_error / sample_cnt : 0.0f; }
+};
+
+// シーンの全てのjointとarticulationの関節のずれをdriftに加える
+void measureJointDrift(PxScene &scene, JointDrift &drift);
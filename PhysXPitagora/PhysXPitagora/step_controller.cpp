@@ -0,0 +1,54 @@
+#include "step_controller.h"
+#include <chrono>
+
+
+using namespace std;
+
+StepController::StepController(PxScene &scene, PxReal frame_time, PxU32 substep_cnt, PxU32 max_step_cnt,
+	ActorStateBuffer* state_buffer)
+	: scene_(scene), step_time_(frame_time / PxMax(substep_cnt, 1u)), substep_cnt_(PxMax(substep_cnt, 1u)),
+	max_step_cnt_(PxMax(max_step_cnt, 1u)), state_buffer_(state_buffer),
+	accumulator_(0.0), dropped_time_(0.0), step_cpu_time_(0.0), step_cnt_(0)
+{
+}
+
+PxU32 StepController::advance(double elapsed_time)
+{
+	accumulator_ += elapsed_time;
+
+	// 上限を超えた分は捨てる
+	const double kMaxTime = (double)step_time_ * max_step_cnt_;
+	if (accumulator_ > kMaxTime) {
+		dropped_time_ += accumulator_ - kMaxTime;
+		accumulator_ = kMaxTime;
+	}
+
+	PxU32 step_cnt = 0;
+	while (accumulator_ >= step_time_) {
+		step();
+		accumulator_ -= step_time_;
+		step_cnt++;
+	}
+	return step_cnt;
+}
+
+void StepController::stepFrame()
+{
+	for (PxU32 i = 0; i != substep_cnt_; i++)
+		step();
+}
+
+void StepController::step()
+{
+	if (pre_step_)
+		pre_step_(getSimulationTime(), step_time_);
+
+	const chrono::steady_clock::time_point kStart = chrono::steady_clock::now();
+	scene_.simulate(step_time_);
+	scene_.fetchResults(true);
+	step_cpu_time_ += chrono::duration<double>(chrono::steady_clock::now() - kStart).count();
+	step_cnt_++;
+
+	if (state_buffer_)
+		state_buffer_->update();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include "actor_state_buffer.h"
+#include <functional>
+
+using namespace std;
+using namespace physx;
+
+// 実時間に合わせて、固定の時間刻みでシミュレーションを進める
+// 経過時間を溜めておき、溜まった分だけ1/(60 * substep_cnt)秒などの固定ステップを進める
+// 時間刻みは常に同じなので、同じステップ数を進めた結果は実行速度によらず同じになる
+//
+// 処理が追いつかない場合に溜まる時間は、max_step_cnt回のステップ分で打ち切る
+// (溜まった時間を全て進めようとすると、さらに遅れて止まらなくなる)
+//
+// state_bufferを渡した場合は各ステップの後にupdateし、ステップの間の時刻の姿勢を
+// getInterpolationAlphaとActorStateBuffer::getInterpolatedPoseで補間できる
+class StepController {
+public:
+	// frame_time: 1フレームの時間
+	// substep_cnt: 1フレームを分割するステップ数(1回のsimulateの時間はframe_time / substep_cnt)
+	// max_step_cnt: 1回のadvanceで進める最大ステップ数
+	StepController(PxScene &scene, PxReal frame_time, PxU32 substep_cnt, PxU32 max_step_cnt,
+		ActorStateBuffer* state_buffer = NULL);
+
+	// 各ステップのsimulateの前に呼ぶ処理(kinematic targetの設定など)
+	// time: ステップ開始時のシミュレーション時刻, step_time: ステップの時間
+	void setPreStepCallback(const function<void(double time, PxReal step_time)> &callback) { pre_step_ = callback; }
+
+	// elapsed_time(実時間)を溜め、溜まった分だけステップを進めて、進めたステップ数を返す
+	PxU32 advance(double elapsed_time);
+
+	// 1フレーム分(substep_cnt回)のステップを、実時間によらず進める
+	void stepFrame();
+
+	// 溜まっている1ステップ未満の時間の割合(0以上1未満)
+	// 最後のステップの前の姿勢と後の姿勢をこの割合で補間すると、現在の時刻の姿勢になる
+	PxReal getInterpolationAlpha() const { return (PxReal)(accumulator_ / step_time_); }
+
+	PxReal getStepTime() const { return step_time_; }
+	PxU64 getStepCount() const { return step_cnt_; }
+	double getSimulationTime() const { return step_cnt_ * (double)step_time_; }
+
+	// 追いつけずに捨てた時間
+	double getDroppedTime() const { return dropped_time_; }
+
+	// simulateとfetchResultsにかかった時間の合計
+	double getStepCpuTime() const { return step_cpu_time_; }
+
+private:
+	PxScene &scene_;
+	PxReal step_time_;
+	PxU32 substep_cnt_;
+	PxU32 max_step_cnt_;
+	ActorStateBuffer* state_buffer_;
+	function<void(double, PxReal)> pre_step_;
+
+	double accumulator_;
+	double dropped_time_;
+	double step_cpu_time_;
+	PxU64 step_cnt_;
+
+	void step();
+};
@@ -0,0 +1,364 @@
+#include "stl_mesh.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <iostream>
+#if defined(STL_MESH_AVX) || defined(STL_MESH_SSE)
+#include <immintrin.h>
+#endif
+
+
+using namespace std;
+
+static const PxVec3 g_box_vertex_data[] = {
+	PxVec3(-1.0f, -1.0f, -1.0f),// 三角形1:開始
+	PxVec3(-1.0f, -1.0f, 1.0f),
+	PxVec3(-1.0f, 1.0f, 1.0f),// 三角形1:終了
+
+	PxVec3(1.0f, 1.0f, -1.0f),// 三角形2:開始
+	PxVec3(-1.0f, -1.0f, -1.0f),
+	PxVec3(-1.0f, 1.0f, -1.0f),// 三角形2:終了
+
+	PxVec3(1.0f, -1.0f, 1.0f),
+	PxVec3(-1.0f, -1.0f, -1.0f),
+	PxVec3(1.0f, -1.0f, -1.0f),
+
+	PxVec3(1.0f, 1.0f, -1.0f),
+	PxVec3(1.0f, -1.0f, -1.0f),
+	PxVec3(-1.0f, -1.0f, -1.0f),
+
+	PxVec3(-1.0f, -1.0f, -1.0f),
+	PxVec3(-1.0f, 1.0f, 1.0f),
+	PxVec3(-1.0f, 1.0f, -1.0f),
+
+	PxVec3(1.0f, -1.0f, 1.0f),
+	PxVec3(-1.0f, -1.0f, 1.0f),
+	PxVec3(-1.0f, -1.0f, -1.0f),
+
+	PxVec3(-1.0f, 1.0f, 1.0f),
+	PxVec3(-1.0f, -1.0f, 1.0f),
+	PxVec3(1.0f, -1.0f, 1.0f),
+
+	PxVec3(1.0f, 1.0f, 1.0f),
+	PxVec3(1.0f, -1.0f, -1.0f),
+	PxVec3(1.0f, 1.0f, -1.0f),
+
+	PxVec3(1.0f, -1.0f, -1.0f),
+	PxVec3(1.0f, 1.0f, 1.0f),
+	PxVec3(1.0f, -1.0f, 1.0f),
+
+	PxVec3(1.0f, 1.0f, 1.0f),
+	PxVec3(1.0f, 1.0f, -1.0f),
+	PxVec3(-1.0f, 1.0f, -1.0f),
+
+	PxVec3(1.0f, 1.0f, 1.0f),
+	PxVec3(-1.0f, 1.0f, -1.0f),
+	PxVec3(-1.0f, 1.0f, 1.0f),
+
+	PxVec3(1.0f, 1.0f, 1.0f),
+	PxVec3(-1.0f, 1.0f, 1.0f),
+	PxVec3(1.0f, -1.0f, 1.0f)
+};
+
+static const PxVec3 g_box_normal_data[] = {
+	PxVec3(-1.0f, 0.0f, 0.0f),
+	PxVec3(0.0f, 0.0f, -1.0f),
+	PxVec3(0.0f, -1.0f, 0.0f),
+	PxVec3(0.0f, 0.0f, -1.0f),
+	PxVec3(-1.0f, 0.0f, 0.0f),
+	PxVec3(0.0f, -1.0f, 0.0f),
+	PxVec3(0.0f, 0.0f, 1.0f),
+	PxVec3(1.0f, 0.0f, 0.0f),
+	PxVec3(1.0f, 0.0f, 0.0f),
+	PxVec3(0.0f, 1.0f, 0.0f),
+	PxVec3(0.0f, 1.0f, 0.0f),
+	PxVec3(0.0f, 0.0f, 1.0f)
+};
+
+
+// 球の頂点，法線を得る関数
+// http://stackoverflow.com/questions/7946770/calculating-a-sphere-in-opengl
+static void createSphereVerticesAndNormals(vector<PxVec3> &sphere_vertices, vector<PxVec3> &sphere_normals, vector<short> &sphere_indices, int rings, int sectors)
+{
+	float radius = 1.0; //半径1
+	float const kR = 1. / (float)(rings - 1);
+	float const kS = 1. / (float)(sectors - 1);
+	const size_t kRings = (size_t)rings;
+	const size_t kSectors = (size_t)sectors;
+	size_t r, s;
+
+	sphere_vertices.resize(rings * sectors * 3);
+	sphere_normals.resize(rings * sectors * 3);
+
+	vector<PxVec3>::iterator v = sphere_vertices.begin();
+	vector<PxVec3>::iterator n = sphere_normals.begin();
+
+	for (r = 0; r < kRings; r++) for (s = 0; s < kSectors; s++) {
+		float const ky = sin(-M_PI_2 + M_PI * r * kR);
+		float const kx = cos(2 * M_PI * s * kS) * sin(M_PI * r * kR);
+		float const kz = sin(2 * M_PI * s * kS) * sin(M_PI * r * kR);
+
+		*v++ = PxVec3(kx, ky, kz) * radius;
+
+		*n++ = PxVec3(kx, ky, kz);
+	}
+
+	sphere_indices.clear();
+	for (r = 0; r < kRings; r++) for (s = 0; s < kSectors; s++) {
+		sphere_indices.push_back((short)(r * kSectors + s));
+		sphere_indices.push_back((short)(r * kSectors + (s + 1)));
+		sphere_indices.push_back((short)((r + 1) * kSectors + (s + 1)));
+		sphere_indices.push_back((short)((r + 1) * kSectors + s));
+
+		if (((r + 1) * kSectors + (s + 1)) == sphere_vertices.size() / 3) {
+			return;
+		}
+	}
+}
+
+// 頂点をSoA形式でmeshに格納する
+static void setVertices(UnitMesh &mesh, const PxVec3 *vertices, size_t vertex_cnt)
+{
+	const size_t kPaddedCnt =
+		(vertex_cnt + UnitMesh::kSimdWidth - 1) / UnitMesh::kSimdWidth * UnitMesh::kSimdWidth;
+	mesh.vertex_cnt = vertex_cnt;
+	mesh.x.assign(kPaddedCnt, 0.0f);
+	mesh.y.assign(kPaddedCnt, 0.0f);
+	mesh.z.assign(kPaddedCnt, 0.0f);
+	for (size_t i = 0; i != vertex_cnt; i++) {
+		mesh.x[i] = vertices[i].x;
+		mesh.y[i] = vertices[i].y;
+		mesh.z[i] = vertices[i].z;
+	}
+}
+
+static void addTriangle(UnitMesh &mesh, int i0, int i1, int i2, const PxVec3 &normal)
+{
+	mesh.indices.push_back((PxU16)i0);
+	mesh.indices.push_back((PxU16)i1);
+	mesh.indices.push_back((PxU16)i2);
+	mesh.normals.push_back(normal);
+}
+
+const UnitMesh& UnitMeshCache::getBox()
+{
+	if (!box_.normals.empty())
+		return box_;
+
+	// g_box_vertex_dataは三角形ごとに頂点を持つので、重複を除いた8頂点にまとめる
+	const size_t kBoxVertexCnt = sizeof(g_box_vertex_data) / sizeof(PxVec3);
+	vector<PxVec3> vertices;
+	vector<int> indices;
+	for (size_t i = 0; i != kBoxVertexCnt; i++) {
+		size_t j = 0;
+		while (j != vertices.size() && vertices[j] != g_box_vertex_data[i])
+			j++;
+		if (j == vertices.size())
+			vertices.push_back(g_box_vertex_data[i]);
+		indices.push_back((int)j);
+	}
+
+	setVertices(box_, &vertices[0], vertices.size());
+	for (size_t i = 0; i != kBoxVertexCnt / 3; i++)
+		addTriangle(box_, indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2], g_box_normal_data[i]);
+	return box_;
+}
+
+const UnitMesh& UnitMeshCache::getSphere(int rings, int sectors)
+{
+	const pair<int, int> kKey(rings, sectors);
+	map<pair<int, int>, UnitMesh>::iterator it = spheres_.find(kKey);
+	if (it != spheres_.end())
+		return it->second;
+
+	//半径1の球の頂点・法線を取得
+	vector<PxVec3> vertices;
+	vector<PxVec3> normals;
+	vector<short> indices;
+	createSphereVerticesAndNormals(vertices, normals, indices, rings, sectors);
+
+	UnitMesh &mesh = spheres_[kKey];
+	setVertices(mesh, &vertices[0], rings * sectors);
+	for (size_t i = 0; i != indices.size() - 4; i += 4)
+	{
+		// triangle0: 2-1-0
+		addTriangle(mesh, indices[i + 2], indices[i + 1], indices[i + 0],
+			(normals[indices[i + 0]] + normals[indices[i + 1]] + normals[indices[i + 2]]) / 3.0f);
+
+		// triangle1: 3-2-0
+		addTriangle(mesh, indices[i + 3], indices[i + 2], indices[i + 0],
+			(normals[indices[i + 0]] + normals[indices[i + 2]] + normals[indices[i + 2]]) / 3.0f);
+	}
+	return mesh;
+}
+
+void transformVerticesScalar(const PxMat44 &model_matrix, const UnitMesh &mesh,
+	float* out_x, float* out_y, float* out_z)
+{
+	for (size_t i = 0; i != mesh.getPaddedVertexCount(); i++) {
+		const PxVec3 kVertex = model_matrix.transform(PxVec3(mesh.x[i], mesh.y[i], mesh.z[i]));
+		out_x[i] = kVertex.x;
+		out_y[i] = kVertex.y;
+		out_z[i] = kVertex.z;
+	}
+}
+
+// PxMat44::transformと同じ順序(column0*x + column1*y + column2*z + column3)で演算する
+void transformVertices(const PxMat44 &model_matrix, const UnitMesh &mesh,
+	float* out_x, float* out_y, float* out_z)
+{
+	const PxMat44 &m = model_matrix;
+	const size_t kVertexCnt = mesh.getPaddedVertexCount();
+	const float* x = mesh.x.data();
+	const float* y = mesh.y.data();
+	const float* z = mesh.z.data();
+
+#if defined(STL_MESH_AVX)
+	const __m256 kC0x = _mm256_set1_ps(m.column0.x), kC0y = _mm256_set1_ps(m.column0.y), kC0z = _mm256_set1_ps(m.column0.z);
+	const __m256 kC1x = _mm256_set1_ps(m.column1.x), kC1y = _mm256_set1_ps(m.column1.y), kC1z = _mm256_set1_ps(m.column1.z);
+	const __m256 kC2x = _mm256_set1_ps(m.column2.x), kC2y = _mm256_set1_ps(m.column2.y), kC2z = _mm256_set1_ps(m.column2.z);
+	const __m256 kC3x = _mm256_set1_ps(m.column3.x), kC3y = _mm256_set1_ps(m.column3.y), kC3z = _mm256_set1_ps(m.column3.z);
+
+	for (size_t i = 0; i < kVertexCnt; i += 8) {
+		const __m256 kX = _mm256_loadu_ps(x + i);
+		const __m256 kY = _mm256_loadu_ps(y + i);
+		const __m256 kZ = _mm256_loadu_ps(z + i);
+
+		__m256 rx = _mm256_mul_ps(kC0x, kX);
+		__m256 ry = _mm256_mul_ps(kC0y, kX);
+		__m256 rz = _mm256_mul_ps(kC0z, kX);
+		rx = _mm256_add_ps(rx, _mm256_mul_ps(kC1x, kY));
+		ry = _mm256_add_ps(ry, _mm256_mul_ps(kC1y, kY));
+		rz = _mm256_add_ps(rz, _mm256_mul_ps(kC1z, kY));
+		rx = _mm256_add_ps(rx, _mm256_mul_ps(kC2x, kZ));
+		ry = _mm256_add_ps(ry, _mm256_mul_ps(kC2y, kZ));
+		rz = _mm256_add_ps(rz, _mm256_mul_ps(kC2z, kZ));
+		_mm256_storeu_ps(out_x + i, _mm256_add_ps(rx, kC3x));
+		_mm256_storeu_ps(out_y + i, _mm256_add_ps(ry, kC3y));
+		_mm256_storeu_ps(out_z + i, _mm256_add_ps(rz, kC3z));
+	}
+#elif defined(STL_MESH_SSE)
+	const __m128 kC0x = _mm_set1_ps(m.column0.x), kC0y = _mm_set1_ps(m.column0.y), kC0z = _mm_set1_ps(m.column0.z);
+	const __m128 kC1x = _mm_set1_ps(m.column1.x), kC1y = _mm_set1_ps(m.column1.y), kC1z = _mm_set1_ps(m.column1.z);
+	const __m128 kC2x = _mm_set1_ps(m.column2.x), kC2y = _mm_set1_ps(m.column2.y), kC2z = _mm_set1_ps(m.column2.z);
+	const __m128 kC3x = _mm_set1_ps(m.column3.x), kC3y = _mm_set1_ps(m.column3.y), kC3z = _mm_set1_ps(m.column3.z);
+
+	for (size_t i = 0; i < kVertexCnt; i += 4) {
+		const __m128 kX = _mm_loadu_ps(x + i);
+		const __m128 kY = _mm_loadu_ps(y + i);
+		const __m128 kZ = _mm_loadu_ps(z + i);
+
+		__m128 rx = _mm_mul_ps(kC0x, kX);
+		__m128 ry = _mm_mul_ps(kC0y, kX);
+		__m128 rz = _mm_mul_ps(kC0z, kX);
+		rx = _mm_add_ps(rx, _mm_mul_ps(kC1x, kY));
+		ry = _mm_add_ps(ry, _mm_mul_ps(kC1y, kY));
+		rz = _mm_add_ps(rz, _mm_mul_ps(kC1z, kY));
+		rx = _mm_add_ps(rx, _mm_mul_ps(kC2x, kZ));
+		ry = _mm_add_ps(ry, _mm_mul_ps(kC2y, kZ));
+		rz = _mm_add_ps(rz, _mm_mul_ps(kC2z, kZ));
+		_mm_storeu_ps(out_x + i, _mm_add_ps(rx, kC3x));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(ry, kC3y));
+		_mm_storeu_ps(out_z + i, _mm_add_ps(rz, kC3z));
+	}
+#else
+	PX_UNUSED(m); PX_UNUSED(kVertexCnt); PX_UNUSED(x); PX_UNUSED(y); PX_UNUSED(z);
+	transformVerticesScalar(model_matrix, mesh, out_x, out_y, out_z);
+#endif
+}
+
+// 変更前の経路(単位形状の頂点を三角形ごとにPxMat44::transformで1頂点ずつ変換する)で三角形の頂点を求める
+// is_boxなら箱、それ以外は球(rings, sectors)として扱う
+static void transformTrianglesBaseline(const PxMat44 &model_matrix, int rings, int sectors, bool is_box,
+	vector<PxVec3> &triangle_vertices)
+{
+	triangle_vertices.clear();
+	if (is_box) {
+		for (size_t i = 0; i != sizeof(g_box_vertex_data) / sizeof(PxVec3); i++)
+			triangle_vertices.push_back(model_matrix.transform(PxVec4(g_box_vertex_data[i], 1)).getXYZ());
+		return;
+	}
+
+	vector<PxVec3> vertices;
+	vector<PxVec3> normals;
+	vector<short> indices;
+	createSphereVerticesAndNormals(vertices, normals, indices, rings, sectors);
+	for (size_t i = 0; i != indices.size() - 4; i += 4) {
+		// triangle0: 2-1-0
+		triangle_vertices.push_back(model_matrix.transform(vertices[indices[i + 2]]));
+		triangle_vertices.push_back(model_matrix.transform(vertices[indices[i + 1]]));
+		triangle_vertices.push_back(model_matrix.transform(vertices[indices[i + 0]]));
+
+		// triangle1: 3-2-0
+		triangle_vertices.push_back(model_matrix.transform(vertices[indices[i + 3]]));
+		triangle_vertices.push_back(model_matrix.transform(vertices[indices[i + 2]]));
+		triangle_vertices.push_back(model_matrix.transform(vertices[indices[i + 0]]));
+	}
+}
+
+bool verifyTransformVertices()
+{
+	UnitMeshCache cache;
+	struct MeshCase {
+		const UnitMesh* mesh;
+		bool is_box;
+		int rings, sectors;
+	};
+	const MeshCase kMeshes[] = {
+		{ &cache.getBox(), true, 0, 0 },
+		{ &cache.getSphere(20, 20), false, 20, 20 },
+		{ &cache.getSphere(7, 13), false, 7, 13 },
+	};
+
+	// 拡大縮小・回転・平行移動を含む変換行列
+	const PxTransform kTransforms[] = {
+		PxTransform(PxIdentity),
+		PxTransform(PxVec3(1.5f, -2.0f, 30.0f), PxQuat(PxPi / 6.0f, PxVec3(0.0f, 0.0f, 1.0f))),
+		PxTransform(PxVec3(-100.0f, 0.25f, 7.0f), PxQuat(1.0f, PxVec3(1.0f, 2.0f, 3.0f).getNormalized())),
+	};
+	const PxVec3 kScales[] = { PxVec3(1.0f), PxVec3(0.45f), PxVec3(0.2f, 0.5f, 6.0f) };
+
+	float max_error = 0.0f;           // SIMD版とスカラー版の差
+	float max_baseline_error = 0.0f;  // SIMD版と変更前の経路の差
+	bool triangle_cnt_ok = true;
+	vector<PxVec3> baseline;
+	for (size_t m = 0; m != sizeof(kMeshes) / sizeof(kMeshes[0]); m++) {
+		const UnitMesh &mesh = *kMeshes[m].mesh;
+		const size_t kCnt = mesh.getPaddedVertexCount();
+		vector<float> simd(kCnt * 3), scalar(kCnt * 3);
+
+		for (size_t t = 0; t != sizeof(kTransforms) / sizeof(kTransforms[0]); t++) {
+			const PxMat44 kModelMatrix = PxMat44(kTransforms[t]) * PxMat44(PxVec4(kScales[t], 1.0f));
+			transformVertices(kModelMatrix, mesh, &simd[0], &simd[kCnt], &simd[kCnt * 2]);
+			transformVerticesScalar(kModelMatrix, mesh, &scalar[0], &scalar[kCnt], &scalar[kCnt * 2]);
+
+			for (size_t i = 0; i != mesh.vertex_cnt; i++) {
+				for (size_t k = 0; k != 3; k++)
+					max_error = PxMax(max_error, PxAbs(simd[kCnt * k + i] - scalar[kCnt * k + i]));
+			}
+
+			// 三角形ごとの頂点を変更前の経路と比較する
+			transformTrianglesBaseline(kModelMatrix, kMeshes[m].rings, kMeshes[m].sectors, kMeshes[m].is_box, baseline);
+			if (baseline.size() != mesh.indices.size()) {
+				triangle_cnt_ok = false;
+				continue;
+			}
+			for (size_t i = 0; i != mesh.indices.size(); i++) {
+				const size_t kIndex = mesh.indices[i];
+				const PxVec3 kVertex(simd[kIndex], simd[kCnt + kIndex], simd[kCnt * 2 + kIndex]);
+				const PxVec3 kDiff = kVertex - baseline[i];
+				max_baseline_error = PxMax(max_baseline_error,
+					PxMax(PxAbs(kDiff.x), PxMax(PxAbs(kDiff.y), PxAbs(kDiff.z))));
+			}
+		}
+	}
+
+	const float kTolerance = 1e-5f;
+	const bool kScalarOk = max_error <= kTolerance;
+	const bool kBaselineOk = triangle_cnt_ok && max_baseline_error <= kTolerance;
+	cout << "transformVertices: max error " << max_error
+		<< (kScalarOk ? " (OK)" : " (NG)") << endl;
+	cout << "transformVertices: max error against baseline " << max_baseline_error
+		<< (triangle_cnt_ok ? "" : ", triangle count mismatch")
+		<< (kBaselineOk ? " (OK)" : " (NG)") << endl;
+	return kScalarOk && kBaselineOk;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <map>
+
+using namespace std;
+using namespace physx;
+
+// SIMD命令セットの選択
+// AVXが有効なら8要素、SSE2が使えるなら4要素ずつ変換し、どちらも無ければスカラーで変換する
+#if defined(__AVX__)
+#define STL_MESH_AVX
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define STL_MESH_SSE
+#endif
+
+// 単位形状(半径1の球、半辺長1の箱)のメッシュ
+// 頂点はSoA形式で保持し、一括変換のためにkSimdWidthの倍数までパディングする
+struct UnitMesh {
+	static const size_t kSimdWidth = 8;
+
+	vector<float> x, y, z;    // 頂点座標(重複なし)
+	size_t vertex_cnt;        // パディングを除いた頂点数
+	vector<PxU16> indices;    // 三角形ごとの頂点インデックス(3個ずつ)
+	vector<PxVec3> normals;   // 三角形ごとの法線(モデル座標系)
+
+	size_t getTriangleCount() const { return normals.size(); }
+	size_t getPaddedVertexCount() const { return x.size(); }
+};
+
+// 単位形状のメッシュをテッセレーションごとに1度だけ生成して使い回す
+class UnitMeshCache {
+public:
+	const UnitMesh& getBox();
+	const UnitMesh& getSphere(int rings, int sectors);
+
+private:
+	UnitMesh box_;
+	map<pair<int, int>, UnitMesh> spheres_;  // key: (rings, sectors)
+};
+
+// meshの全頂点にmodel_matrixを掛け、out_x/out_y/out_zへSoA形式で書き出す
+// 出力先はmesh.getPaddedVertexCount()個分の領域が必要
+void transformVertices(const PxMat44 &model_matrix, const UnitMesh &mesh,
+	float* out_x, float* out_y, float* out_z);
+
+// transformVerticesのスカラー版(PxMat44::transformで1頂点ずつ変換する)
+void transformVerticesScalar(const PxMat44 &model_matrix, const UnitMesh &mesh,
+	float* out_x, float* out_y, float* out_z);
+
+// SIMD版の変換結果がスカラー版、および変更前の経路(三角形ごとにPxMat44::transformで変換)と一致するかを確認する
+bool verifyTransformVertices();
@@ -1,283 +1,598 @@
 #include "stl_output.h"
-#define _USE_MATH_DEFINES
-#include <math.h>
+#include "trace_profiler.h"
 #include <iostream>
 #include <iomanip>
-#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 
 using namespace std;
 
-static const PxVec3 g_box_vertex_data[] = {
-	PxVec3(-1.0f, -1.0f, -1.0f),// Op`1:Jn
-	PxVec3(-1.0f, -1.0f, 1.0f),
-	PxVec3(-1.0f, 1.0f, 1.0f),// Op`1:I
-
-	PxVec3(1.0f, 1.0f, -1.0f),// Op`2:Jn
-	PxVec3(-1.0f, -1.0f, -1.0f),
-	PxVec3(-1.0f, 1.0f, -1.0f),// Op`2:I
-
-	PxVec3(1.0f, -1.0f, 1.0f),
-	PxVec3(-1.0f, -1.0f, -1.0f),
-	PxVec3(1.0f, -1.0f, -1.0f),
-
-	PxVec3(1.0f, 1.0f, -1.0f),
-	PxVec3(1.0f, -1.0f, -1.0f),
-	PxVec3(-1.0f, -1.0f, -1.0f),
-
-	PxVec3(-1.0f, -1.0f, -1.0f),
-	PxVec3(-1.0f, 1.0f, 1.0f),
-	PxVec3(-1.0f, 1.0f, -1.0f),
-
-	PxVec3(1.0f, -1.0f, 1.0f),
-	PxVec3(-1.0f, -1.0f, 1.0f),
-	PxVec3(-1.0f, -1.0f, -1.0f),
-
-	PxVec3(-1.0f, 1.0f, 1.0f),
-	PxVec3(-1.0f, -1.0f, 1.0f),
-	PxVec3(1.0f, -1.0f, 1.0f),
-
-	PxVec3(1.0f, 1.0f, 1.0f),
-	PxVec3(1.0f, -1.0f, -1.0f),
-	PxVec3(1.0f, 1.0f, -1.0f),
-
-	PxVec3(1.0f, -1.0f, -1.0f),
-	PxVec3(1.0f, 1.0f, 1.0f),
-	PxVec3(1.0f, -1.0f, 1.0f),
-
-	PxVec3(1.0f, 1.0f, 1.0f),
-	PxVec3(1.0f, 1.0f, -1.0f),
-	PxVec3(-1.0f, 1.0f, -1.0f),
-
-	PxVec3(1.0f, 1.0f, 1.0f),
-	PxVec3(-1.0f, 1.0f, -1.0f),
-	PxVec3(-1.0f, 1.0f, 1.0f),
-
-	PxVec3(1.0f, 1.0f, 1.0f),
-	PxVec3(-1.0f, 1.0f, 1.0f),
-	PxVec3(1.0f, -1.0f, 1.0f)
-};
-
-static const PxVec3 g_box_normal_data[] = {
-	PxVec3(-1.0f, 0.0f, 0.0f),
-	PxVec3(0.0f, 0.0f, -1.0f),
-	PxVec3(0.0f, -1.0f, 0.0f),
-	PxVec3(0.0f, 0.0f, -1.0f),
-	PxVec3(-1.0f, 0.0f, 0.0f),
-	PxVec3(0.0f, -1.0f, 0.0f),
-	PxVec3(0.0f, 0.0f, 1.0f),
-	PxVec3(1.0f, 0.0f, 0.0f),
-	PxVec3(1.0f, 0.0f, 0.0f),
-	PxVec3(0.0f, 1.0f, 0.0f),
-	PxVec3(0.0f, 1.0f, 0.0f),
-	PxVec3(0.0f, 0.0f, 1.0f)
-};
-
-
-// stlt@Co
-// output_path: o͐fBNg
-// actor_buffer: AN^[i[obt@
-// actor_cnt: obt@Ɋ܂܂AN^[
+StlOutput::StlOutput()
+	: format_(StlFormat::eASCII), allocation_cnt_(0), work_(NULL), first_worker_(0), work_thread_cnt_(0),
+	generation_(0), running_thread_cnt_(0), quit_(false)
+{
+}
+
+StlOutput::~StlOutput()
+{
+	{
+		lock_guard<mutex> lock(thread_mutex_);
+		quit_ = true;
+	}
+	thread_cv_.notify_all();
+	for (size_t i = 0; i != threads_.size(); i++)
+		threads_[i].join();
+}
+
+// stlファイルを書き出す
+// output_path: 出力先ディレクトリ
+// actor_buffer: アクター情報を格納したバッファ
+// actor_cnt: バッファに含まれるアクター数
 // divide_file:
-//  falseɂƑSĂactor1STLt@Cɂďo
-//  trueɂ1actorɂ1STLt@Co
-void StlOutput::outputStl(string output_path, PxActor** actor_buffer, PxU32 actor_cnt, bool divide_file)
+//  falseにすると全てのactor情報を1つのSTLファイルにして出力
+//  trueにすると1つのactorにつき1つのSTLファイルを出力
+// format: 出力形式(ASCII or バイナリ)
+// thread_cnt: テッセレーションを行うスレッド数
+StlOutputStats StlOutput::outputStl(const string &output_path, PxActor** actor_buffer, PxU32 actor_cnt, bool divide_file,
+	StlFormat::Enum format, PxU32 thread_cnt)
 {
-	cout << "STLt@Cc" << endl;
+	TraceZone zone("Export.outputStl");
+	const chrono::steady_clock::time_point kStartTime = chrono::steady_clock::now();
+	format_ = format;
+	thread_cnt = PxMax(thread_cnt, 1u);
+
+	// ワーカーの追加もこのexportでの確保として数えるので、基準は追加の前に取る
+	size_t allocation_cnt_before = allocation_cnt_;
+	for (size_t i = 0; i != workers_.size(); i++)
+		allocation_cnt_before += workers_[i].allocation_cnt;
+	if (workers_.size() < thread_cnt) {
+		workers_.resize(thread_cnt);
+		allocation_cnt_++;
+	}
+	for (size_t i = 0; i != workers_.size(); i++) {
+		workers_[i].triangle_cnt = 0;
+		workers_[i].bytes_written = 0;
+	}
+
+	// 単位メッシュはワーカーの起動前に生成しておき、ワーカーからは参照のみ行う
+	mesh_cache_.getBox();
+	mesh_cache_.getSphere(kSphereRings, kSphereSectors);
+
+	cout << "STLファイル生成中…" << endl;
+	if (format_ == StlFormat::eBINARY) {
+		cout << "バイナリ形式で出力" << endl;
+	}
 	if (divide_file) {
-		cout << "êʂSTLt@CƂďo" << endl;
+		cout << "各剛体を個別のSTLファイルとして出力" << endl;
+		writeDividedFiles(output_path, actor_buffer, actor_cnt, thread_cnt);
 	}
 	else {
-		cout << "Ŝ܂Ƃ߂STLt@CƂďo" << endl;
-		write_stream.open(output_path + "output.stl", ios::out);
+		cout << "全剛体をまとめたSTLファイルとして出力" << endl;
+		writeCombinedFile(output_path + "output.stl", actor_buffer, actor_cnt, thread_cnt);
 	}
 
-	size_t triangle_mesh_cnt = 0;
+	StlOutputStats stats;
+	stats.actor_cnt = actor_cnt;
+	stats.triangle_cnt = 0;
+	stats.bytes_written = 0;
+	stats.buffer_growth_cnt = allocation_cnt_;
+	for (size_t i = 0; i != workers_.size(); i++) {
+		stats.triangle_cnt += workers_[i].triangle_cnt;
+		stats.bytes_written += workers_[i].bytes_written;
+		stats.buffer_growth_cnt += workers_[i].allocation_cnt;
+	}
+	stats.buffer_growth_cnt -= allocation_cnt_before;
+	stats.thread_cnt = thread_cnt;
+	stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - kStartTime).count();
+
+	cout << "\t書き出しアクター数:\t " << actor_cnt << endl;
+	cout << "\t三角形メッシュ数:\t " << stats.triangle_cnt << endl;
+	cout << "\t書き出しバイト数:\t " << stats.bytes_written << endl;
+	cout << "\t作業領域の拡張回数:\t " << stats.buffer_growth_cnt << endl;
+	cout << "\tスレッド数:\t " << thread_cnt << endl;
+	if (stats.seconds > 0.0) {
+		cout << "\tスループット:\t " << (stats.bytes_written / (1024.0 * 1024.0)) / stats.seconds
+			<< " MB/s (" << stats.seconds * 1000.0 << " ms)" << endl;
+	}
+	cout << "書き出し完了" << endl;
+	return stats;
+}
 
-	for (PxU32 i = 0; i < actor_cnt; i++)
-	{
-		if (divide_file) {
-			stringstream fileName;
-			fileName << i << ".stl";
-			write_stream.open(output_path + fileName.str(), ios::out);
-			write_stream << "solid" << endl;
+// 1つのactorにつき1つのSTLファイルを書き出す
+// 各ワーカーが未処理のアクターを1つずつ取り出し、テッセレーションからファイル書き込みまで行う
+void StlOutput::writeDividedFiles(const string &output_path, PxActor** actor_buffer, PxU32 actor_cnt, PxU32 thread_cnt)
+{
+	atomic<PxU32> next_actor(0);
+
+	runWorkers(thread_cnt, [&](Worker &worker) {
+		for (PxU32 i = next_actor++; i < actor_cnt; i = next_actor++)
+		{
+			// パスはワーカーの文字列を使い回して組み立てる
+			char file_name[16];
+			snprintf(file_name, sizeof(file_name), "%u.stl", i);
+			worker.file_path.assign(output_path);
+			worker.file_path.append(file_name);
+
+			PxRigidActor* rigid_actor = (PxRigidActor*)actor_buffer[i];	// アクターの取得
+			worker.buffer.clear();
+			beginSolid(worker, worker.buffer);
+			const size_t kTriangleCnt = writeRigidActor(worker, rigid_actor, worker.buffer);
+			endSolid(worker, worker.buffer, kTriangleCnt);
+
+			worker.triangle_cnt += kTriangleCnt;
+			worker.bytes_written += writeFile(worker.file_path, worker.buffer);
 		}
+	}, function<void()>());
+}
 
-		PxRigidActor* rigid_actor = (PxRigidActor*)actor_buffer[i];	// AN^[̎擾
-		triangle_mesh_cnt += writeRigidActor(rigid_actor);
+// 全てのactorを1つのSTLファイルにまとめて書き出す
+void StlOutput::writeCombinedFile(const string &file_path, PxActor** actor_buffer, PxU32 actor_cnt, PxU32 thread_cnt)
+{
+	const PxU32 kChunkCnt = (actor_cnt + kChunkActorCnt - 1) / kChunkActorCnt;
+	thread_cnt = PxMin(thread_cnt, kChunkCnt);
+
+	if (thread_cnt <= 1) {
+		// 1ファイル分を1つのバッファに組み立て、1回のwriteで書き出す
+		Worker &worker = workers_[0];
+		worker.buffer.clear();
+		beginSolid(worker, worker.buffer);
+		for (PxU32 i = 0; i < actor_cnt; i++)
+			worker.triangle_cnt += writeRigidActor(worker, (PxRigidActor*)actor_buffer[i], worker.buffer);
+		endSolid(worker, worker.buffer, worker.triangle_cnt);
+		worker.bytes_written += writeFile(file_path, worker.buffer);
+		return;
+	}
 
-		if (divide_file)
+	// ワーカーはkChunkActorCnt個ずつアクターをテッセレーションしてチャンクに格納し、
+	// 呼び出し元のスレッドは完了したチャンクをアクター順にファイルへ書き出す
+	// チャンクはkSlotCnt個のスロットを使い回し、書き出しが追いつくまでワーカーを待たせる
+	const PxU32 kSlotCnt = thread_cnt * 2;
+	if (chunks_.size() < kSlotCnt) {
+		chunks_.resize(kSlotCnt);
+		allocation_cnt_++;
+	}
+	for (PxU32 i = 0; i != kSlotCnt; i++)
+		chunks_[i].done = false;
+
+	mutex chunk_mutex;
+	condition_variable chunk_cv;
+	PxU32 next_chunk = 0;     // 次にワーカーが処理するチャンク
+	PxU32 written_chunk = 0;  // 書き出し済みのチャンク数
+	size_t triangle_cnt = 0;
+	size_t bytes_written = 0;
+
+	runWorkers(thread_cnt, [&](Worker &worker) {
+		for (;;)
 		{
-			write_stream << "endsolid" << endl;
-			write_stream.close();
+			PxU32 c;
+			{
+				unique_lock<mutex> lock(chunk_mutex);
+				chunk_cv.wait(lock, [&] { return next_chunk >= kChunkCnt || next_chunk < written_chunk + kSlotCnt; });
+				if (next_chunk >= kChunkCnt)
+					return;
+				c = next_chunk++;
+			}
+
+			Chunk &chunk = chunks_[c % kSlotCnt];
+			chunk.buffer.clear();
+			chunk.triangle_cnt = 0;
+			if (c == 0)
+				beginSolid(worker, chunk.buffer);
+
+			const PxU32 kEnd = PxMin(actor_cnt, (c + 1) * kChunkActorCnt);
+			for (PxU32 i = c * kChunkActorCnt; i < kEnd; i++)
+				chunk.triangle_cnt += writeRigidActor(worker, (PxRigidActor*)actor_buffer[i], chunk.buffer);
+
+			// バイナリ形式の三角形数は全チャンクの書き出し後に埋める
+			if (c == kChunkCnt - 1 && format_ == StlFormat::eASCII)
+				endSolid(worker, chunk.buffer, 0);
+
+			{
+				lock_guard<mutex> lock(chunk_mutex);
+				chunk.index = c;
+				chunk.done = true;
+			}
+			chunk_cv.notify_all();
 		}
-	}
+	}, [&]() {
+		ofstream stream(file_path, format_ == StlFormat::eBINARY ? ios::out | ios::binary : ios::out);
+		for (PxU32 c = 0; c != kChunkCnt; c++)
+		{
+			Chunk &chunk = chunks_[c % kSlotCnt];
+			{
+				unique_lock<mutex> lock(chunk_mutex);
+				chunk_cv.wait(lock, [&] { return chunk.done && chunk.index == c; });
+			}
+
+			stream.write(chunk.buffer.data(), chunk.buffer.size());
+			triangle_cnt += chunk.triangle_cnt;
+
+			{
+				lock_guard<mutex> lock(chunk_mutex);
+				chunk.done = false;
+				written_chunk = c + 1;
+			}
+			chunk_cv.notify_all();
+		}
+
+		bytes_written = (size_t)stream.tellp();
+		if (format_ == StlFormat::eBINARY) {
+			const uint32_t kTriangleCnt = (uint32_t)triangle_cnt;
+			stream.seekp(kBinaryHeaderSize);
+			stream.write((const char*)&kTriangleCnt, sizeof(uint32_t));
+		}
+	});
 
-	cout << "\toAN^[:\t " << actor_cnt << endl;
-	cout << "\tOp`bV:\t " << triangle_mesh_cnt << endl;
-	cout << "o" << endl;
+	workers_[0].triangle_cnt += triangle_cnt;
+	workers_[0].bytes_written += bytes_written;
 }
 
-size_t StlOutput::writeRigidActor(PxRigidActor* actor)
+// workをthread_cnt個のワーカーで実行する
+// main_workを指定した場合は、全ワーカーを別スレッドで実行し、呼び出し元のスレッドでmain_workを実行する
+// 指定しない場合は、先頭のワーカーを呼び出し元のスレッドで実行する
+// スレッドは足りない分だけ起動し、以降のexportでも使い回す
+void StlOutput::runWorkers(PxU32 thread_cnt, const function<void(Worker&)> &work, const function<void()> &main_work)
 {
-	// shape擾
-	PxShape** shapes;
-	shapes = new PxShape*[actor->getNbShapes()];
-	actor->getShapes(shapes, actor->getNbShapes());
-	PxShape* shape = shapes[0];
+	const PxU32 kFirstWorker = main_work ? 0 : 1;
+	const PxU32 kWorkThreadCnt = thread_cnt - kFirstWorker;
+	if (threads_.size() < kWorkThreadCnt) {
+		threads_.reserve(kWorkThreadCnt);
+		for (PxU32 i = (PxU32)threads_.size(); i != kWorkThreadCnt; i++)
+			threads_.push_back(thread(&StlOutput::threadMain, this, i));
+		allocation_cnt_++;
+	}
 
-	// transform擾
-	PxTransform transform = PxShapeExt::getGlobalPose(*shape, *actor);
+	{
+		lock_guard<mutex> lock(thread_mutex_);
+		work_ = &work;
+		first_worker_ = kFirstWorker;
+		work_thread_cnt_ = kWorkThreadCnt;
+		running_thread_cnt_ = kWorkThreadCnt;
+		generation_++;
+	}
+	thread_cv_.notify_all();
 
-	// geometry_type擾
-	PxGeometryType::Enum geometry_type = shape->getGeometryType();
+	if (main_work)
+		main_work();
+	else
+		work(workers_[0]);
 
+	unique_lock<mutex> lock(thread_mutex_);
+	thread_cv_.wait(lock, [&] { return running_thread_cnt_ == 0; });
+	work_ = NULL;
+}
 
-	if (geometry_type == PxGeometryType::eBOX) {
-		PxBoxGeometry box;
-		shape->getBoxGeometry(box);
-		return writeBox(transform, box.halfExtents);
+// threads_[index]の処理。runWorkersで投入された仕事を待って実行する
+void StlOutput::threadMain(PxU32 index)
+{
+	PxU32 generation = 0;
+	for (;;) {
+		const function<void(Worker&)>* work;
+		Worker* worker;
+		{
+			unique_lock<mutex> lock(thread_mutex_);
+			thread_cv_.wait(lock, [&] { return quit_ || (generation_ != generation && index < work_thread_cnt_); });
+			if (quit_)
+				return;
+			generation = generation_;
+			work = work_;
+			worker = &workers_[first_worker_ + index];
+		}
+
+		(*work)(*worker);
+
+		{
+			lock_guard<mutex> lock(thread_mutex_);
+			running_thread_cnt_--;
+		}
+		thread_cv_.notify_all();
 	}
-	else if (geometry_type == PxGeometryType::eSPHERE)
-	{
-		PxSphereGeometry sphere;
-		shape->getSphereGeometry(sphere);
-		return writeSphere(transform, sphere.radius);
+}
+
+// STLファイルのヘッダをoutに追加する
+void StlOutput::beginSolid(Worker &worker, vector<char> &out)
+{
+	if (format_ == StlFormat::eBINARY) {
+		// ヘッダ(80byte)と三角形数(4byte)の領域を確保する。三角形数はendSolidで書き込む
+		char* header = growBuffer(out, kBinaryHeaderSize + sizeof(uint32_t), worker.allocation_cnt);
+		const char kHeader[] = "PhysXPitagora binary STL";
+		memset(header, 0, kBinaryHeaderSize + sizeof(uint32_t));
+		memcpy(header, kHeader, sizeof(kHeader) - 1);
 	}
 	else {
-		cout << "Ή̌`" << endl;
-		return 0;
+		const char kSolid[] = "solid\n";
+		memcpy(growBuffer(out, sizeof(kSolid) - 1, worker.allocation_cnt), kSolid, sizeof(kSolid) - 1);
+	}
+}
+
+// STLファイルのフッタをoutに追加する
+// バイナリ形式の場合は、outの先頭にあるヘッダへ三角形数を書き込む
+void StlOutput::endSolid(Worker &worker, vector<char> &out, size_t triangle_cnt)
+{
+	if (format_ == StlFormat::eBINARY) {
+		const uint32_t kTriangleCnt = (uint32_t)triangle_cnt;
+		memcpy(out.data() + kBinaryHeaderSize, &kTriangleCnt, sizeof(uint32_t));
+	}
+	else {
+		const char kEndSolid[] = "endsolid\n";
+		memcpy(growBuffer(out, sizeof(kEndSolid) - 1, worker.allocation_cnt), kEndSolid, sizeof(kEndSolid) - 1);
 	}
 }
 
+// dataを1回のwriteでファイルに書き出す
+// 戻り値: 書き込んだバイト数
+size_t StlOutput::writeFile(const string &file_path, const vector<char> &data)
+{
+	ofstream stream(file_path, format_ == StlFormat::eBINARY ? ios::out | ios::binary : ios::out);
+	stream.write(data.data(), data.size());
+	return (size_t)stream.tellp();
+}
 
-size_t StlOutput::writeBox(const PxTransform &transform, const PxVec3 &scale)
+bool StlShape::fromActor(const PxRigidActor &actor, StlShape &shape)
 {
-	PxMat44 matS = PxMat44(PxVec4(scale, 1.0f));//gks
-	PxMat44 matR = PxMat44(transform); //iE]s
-	PxMat44 model_matrix = matR * matS;//gk]sړ̏
+	// shapeを取得(先頭のshapeのみ使用する)
+	PxShape* px_shape = NULL;
+	if (actor.getShapes(&px_shape, 1) == 0)
+		return false;
 
-	vector<Triangle> triangles;
+	shape.type = px_shape->getGeometryType();
+	shape.half_extents = PxVec3(0.0f);
+	shape.radius = 0.0f;
+	shape.local_pose = px_shape->getLocalPose();
 
-	for (size_t i = 0; i != 12; i++)
-	{
-		PxVec3* triangle_vertices = new PxVec3[3];
-		// g_box_vertex_databox\Op`̂1oAAtBϊXYZWoB
-		triangle_vertices[0] = model_matrix.transform(PxVec4(g_box_vertex_data[i * 3], 1)).getXYZ();
-		triangle_vertices[1] = model_matrix.transform(PxVec4(g_box_vertex_data[i * 3 + 1], 1)).getXYZ();
-		triangle_vertices[2] = model_matrix.transform(PxVec4(g_box_vertex_data[i * 3 + 2], 1)).getXYZ();
+	if (shape.type == PxGeometryType::eBOX) {
+		PxBoxGeometry box;
+		px_shape->getBoxGeometry(box);
+		shape.half_extents = box.halfExtents;
+	}
+	else if (shape.type == PxGeometryType::eSPHERE) {
+		PxSphereGeometry sphere;
+		px_shape->getSphereGeometry(sphere);
+		shape.radius = sphere.radius;
+	}
+	return true;
+}
 
-		triangles.push_back(Triangle(g_box_normal_data[i], triangle_vertices));
+StlOutputStats StlOutput::outputShapes(const string &file_path, const StlShape* shapes, const PxTransform* actor_poses,
+	PxU32 shape_cnt, StlFormat::Enum format)
+{
+	const chrono::steady_clock::time_point kStartTime = chrono::steady_clock::now();
+	format_ = format;
+	if (workers_.empty()) {
+		workers_.resize(1);
+		allocation_cnt_++;
 	}
 
-	return writeSolid(triangles);
+	Worker &worker = workers_[0];
+	const size_t kAllocationCntBefore = worker.allocation_cnt;
+	worker.buffer.clear();
+	beginSolid(worker, worker.buffer);
+	size_t triangle_cnt = 0;
+	for (PxU32 i = 0; i < shape_cnt; i++)
+		triangle_cnt += writeShape(worker, shapes[i], actor_poses[i] * shapes[i].local_pose, worker.buffer);
+	endSolid(worker, worker.buffer, triangle_cnt);
+
+	StlOutputStats stats;
+	stats.actor_cnt = shape_cnt;
+	stats.triangle_cnt = triangle_cnt;
+	stats.bytes_written = writeFile(file_path, worker.buffer);
+	stats.buffer_growth_cnt = worker.allocation_cnt - kAllocationCntBefore;
+	stats.thread_cnt = 1;
+	stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - kStartTime).count();
+	return stats;
 }
 
+size_t StlOutput::writeRigidActor(Worker &worker, PxRigidActor* actor, vector<char> &out)
+{
+	StlShape shape;
+	if (!StlShape::fromActor(*actor, shape))
+		return 0;
+
+	// transformを取得
+	return writeShape(worker, shape, actor->getGlobalPose() * shape.local_pose, out);
+}
 
-size_t StlOutput::writeSphere(const PxTransform &transform, const PxReal radius)
+// transform: shapeのワールド座標系での姿勢
+size_t StlOutput::writeShape(Worker &worker, const StlShape &shape, const PxTransform &transform, vector<char> &out)
 {
-	PxMat44 matS = PxMat44(PxVec4(PxVec3(radius), 1.0f));//gks
-	PxMat44 matR = PxMat44(transform); //iE]s
-	PxMat44 model_matrix = matR * matS;//gk]sړ̏
-
-	vector<Triangle> triangles;
-
-	//a1̋̒_E@擾
-	vector<PxVec3> vertices;
-	vector<PxVec3> normals;
-	vector<short> indices;
-	const int kRings = 20;
-	const int kSectors = 20;
-	createSphereVerticesAndNormals(vertices, normals, indices, kRings, kSectors);
-	for (size_t i = 0; i != indices.size() - 4; i += 4)
+	if (shape.type == PxGeometryType::eBOX) {
+		return writeBox(worker, transform, shape.half_extents, out);
+	}
+	else if (shape.type == PxGeometryType::eSPHERE)
 	{
-		// triangle0: 2-1-0
-		PxVec3* triangle_vertices_0 = new PxVec3[3];
-		triangle_vertices_0[0] = model_matrix.transform(vertices[indices[i + 2]]);
-		triangle_vertices_0[1] = model_matrix.transform(vertices[indices[i + 1]]);
-		triangle_vertices_0[2] = model_matrix.transform(vertices[indices[i + 0]]);
-		PxVec3 normal0 = 
-			  (normals[indices[i + 0]] + normals[indices[i + 1]] + normals[indices[i + 2]])/3.0f;
-		triangles.push_back(Triangle(normal0, triangle_vertices_0));
-
-		// triangle1: 3-2-0
-		PxVec3* triangle_vertices_1 = new PxVec3[3];
-		triangle_vertices_1[0] = model_matrix.transform(vertices[indices[i + 3]]);
-		triangle_vertices_1[1] = model_matrix.transform(vertices[indices[i + 2]]);
-		triangle_vertices_1[2] = model_matrix.transform(vertices[indices[i + 0]]);
-		PxVec3 normal1 =
-			(normals[indices[i + 0]] + normals[indices[i + 2]] + normals[indices[i + 2]]) / 3.0f;
-
-		triangles.push_back(Triangle(normal1, triangle_vertices_1));
+		return writeSphere(worker, transform, shape.radius, out);
+	}
+	else {
+		cout << "未対応の形状" << endl;
+		return 0;
 	}
-	return writeSolid(triangles);
 }
 
-size_t StlOutput::writeSolid(const vector<Triangle> &triangles)
+
+size_t StlOutput::writeBox(Worker &worker, const PxTransform &transform, const PxVec3 &scale, vector<char> &out)
 {
-	//o
-	for (size_t i = 0; i != triangles.size(); i++)
-	{
-		writeFacetNormal(triangles[i].normal_, triangles[i].vertices_ptr_);
-		delete triangles[i].vertices_ptr_;
-	}
-	return triangles.size();
+	PxMat44 matS = PxMat44(PxVec4(scale, 1.0f));//拡大縮小行列
+	PxMat44 matR = PxMat44(transform); //並進・回転行列
+	PxMat44 model_matrix = matR * matS;//拡大縮小→回転→平行移動の順番
+
+	return writeMesh(worker, mesh_cache_.getBox(), model_matrix, out);
 }
 
-// ̒_C@𓾂֐
-// http://stackoverflow.com/questions/7946770/calculating-a-sphere-in-opengl
-void StlOutput::createSphereVerticesAndNormals(vector<PxVec3> &sphere_vertices, vector<PxVec3> &sphere_normals, vector<short> &sphere_indices, int rings, int sectors)
+
+size_t StlOutput::writeSphere(Worker &worker, const PxTransform &transform, const PxReal radius, vector<char> &out)
 {
-	float radius = 1.0; //a1
-	float const kR = 1. / (float)(rings - 1);
-	float const kS = 1. / (float)(sectors - 1);
-	int r, s;
+	PxMat44 matS = PxMat44(PxVec4(PxVec3(radius), 1.0f));//拡大縮小行列
+	PxMat44 matR = PxMat44(transform); //並進・回転行列
+	PxMat44 model_matrix = matR * matS;//拡大縮小→回転→平行移動の順番
 
-	sphere_vertices.resize(rings * sectors * 3);
-	sphere_normals.resize(rings * sectors * 3);
+	return writeMesh(worker, mesh_cache_.getSphere(kSphereRings, kSphereSectors), model_matrix, out);
+}
 
-	vector<PxVec3>::iterator v = sphere_vertices.begin();
-	vector<PxVec3>::iterator n = sphere_normals.begin();
+// 単位形状のメッシュをmodel_matrixで変換して書き出す
+size_t StlOutput::writeMesh(Worker &worker, const UnitMesh &mesh, const PxMat44 &model_matrix, vector<char> &out)
+{
+	// 全頂点を一括で変換する
+	const size_t kVertexCnt = mesh.getPaddedVertexCount();
+	if (kVertexCnt > worker.transformed_x.size()) {
+		worker.transformed_x.resize(kVertexCnt);
+		worker.transformed_y.resize(kVertexCnt);
+		worker.transformed_z.resize(kVertexCnt);
+		worker.allocation_cnt++;
+	}
+	const float* x = worker.transformed_x.data();
+	const float* y = worker.transformed_y.data();
+	const float* z = worker.transformed_z.data();
+	transformVertices(model_matrix, mesh,
+		worker.transformed_x.data(), worker.transformed_y.data(), worker.transformed_z.data());
+
+	// インデックスに従って三角形を組み立てる
+	const size_t kTriangleCnt = mesh.getTriangleCount();
+	StlFacet* facets = allocateFacets(worker, kTriangleCnt);
+	const PxU16* index = mesh.indices.data();
+	for (size_t i = 0; i != kTriangleCnt; i++)
+	{
+		facets[i].normal = mesh.normals[i];
+		for (size_t k = 0; k != 3; k++, index++)
+			facets[i].vertices[k] = PxVec3(x[*index], y[*index], z[*index]);
+	}
+	return writeSolid(worker, out);
+}
 
-	for (r = 0; r < rings; r++) for (s = 0; s < sectors; s++) {
-		float const ky = sin(-M_PI_2 + M_PI * r * kR);
-		float const kx = cos(2 * M_PI * s * kS) * sin(M_PI * r * kR);
-		float const kz = sin(2 * M_PI * s * kS) * sin(M_PI * r * kR);
+// 三角形バッファにn個分の領域を追加し、その先頭を返す
+// バッファはexport間で使い回すため、容量が足りない時以外は確保しない
+StlFacet* StlOutput::allocateFacets(Worker &worker, size_t n)
+{
+	const size_t kOffset = worker.facets.size();
+	if (kOffset + n > worker.facets.capacity()) {
+		worker.facets.reserve(PxMax(kOffset + n, worker.facets.capacity() * 2));
+		worker.allocation_cnt++;
+	}
+	worker.facets.resize(kOffset + n);
+	return &worker.facets[kOffset];
+}
 
-		*v++ = PxVec3(kx, ky, kz) * radius;
+// 三角形バッファの内容をoutに追加し、三角形バッファを空にする
+size_t StlOutput::writeSolid(Worker &worker, vector<char> &out)
+{
+	const vector<StlFacet> &facets = worker.facets;
 
-		*n++ = PxVec3(kx, ky, kz);
+	//書き出し
+	if (format_ == StlFormat::eBINARY) {
+		char* dst = growBuffer(out, facets.size() * kBinaryFacetSize, worker.allocation_cnt);
+		for (size_t i = 0; i != facets.size(); i++, dst += kBinaryFacetSize)
+			writeBinaryFacet(facets[i], dst);
+	}
+	else {
+		for (size_t i = 0; i != facets.size(); i++)
+			writeFacetNormal(worker, facets[i], out);
 	}
 
-	vector<short>::iterator i = sphere_indices.begin();
-	for (r = 0; r < rings; r++) for (s = 0; s < sectors; s++) {
-		sphere_indices.push_back(r * sectors + s);
-		sphere_indices.push_back(r * sectors + (s + 1));
-		sphere_indices.push_back((r + 1) * sectors + (s + 1));
-		sphere_indices.push_back((r + 1) * sectors + s);
+	const size_t kTriangleCnt = facets.size();
+	worker.facets.clear();  // 容量は保持される
+	return kTriangleCnt;
+}
 
-		if (((r + 1) * sectors + (s + 1)) == sphere_vertices.size() / 3) {
-			return;
-		}
+// outをsizeバイト拡張し、追加した領域の先頭を返す
+// 容量が足りない時は倍々で確保し、allocation_cntを増やす
+char* StlOutput::growBuffer(vector<char> &out, size_t size, size_t &allocation_cnt)
+{
+	const size_t kOffset = out.size();
+	if (kOffset + size > out.capacity()) {
+		out.reserve(PxMax(kOffset + size, out.capacity() * 2));
+		allocation_cnt++;
 	}
+	out.resize(kOffset + size);
+	return out.data() + kOffset;
 }
 
-void StlOutput::writeFacetNormal(PxVec3 normal, PxVec3 *vertices)
+// ASCII形式の三角形1つ分をoutに追加する(座標は小数点以下3桁)
+void StlOutput::writeFacetNormal(Worker &worker, const StlFacet &facet, vector<char> &out)
 {
-	write_stream << "facet normal " << normal.x << " " << normal.y << " " << normal.z << endl;
-	writeOuterLoop(vertices);
-	write_stream << "endfacet" << endl;
+	char text[1024];
+	const int kLength = snprintf(text, sizeof(text),
+		"facet normal %.3f %.3f %.3f\n"
+		"outer loop\n"
+		"vertex %.3f %.3f %.3f\n"
+		"vertex %.3f %.3f %.3f\n"
+		"vertex %.3f %.3f %.3f\n"
+		"endloop\n"
+		"endfacet\n",
+		facet.normal.x, facet.normal.y, facet.normal.z,
+		facet.vertices[0].x, facet.vertices[0].y, facet.vertices[0].z,
+		facet.vertices[1].x, facet.vertices[1].y, facet.vertices[1].z,
+		facet.vertices[2].x, facet.vertices[2].y, facet.vertices[2].z);
+	const size_t kSize = PxMin((size_t)kLength, sizeof(text) - 1);
+	memcpy(growBuffer(out, kSize, worker.allocation_cnt), text, kSize);
 }
 
-void StlOutput::writeOuterLoop(PxVec3 *vertices)
+// バイナリ形式の三角形1つ分(法線、3頂点、属性2byte)をdstに書き込む
+// STLのバイナリ形式はリトルエンディアンのfloatで格納する
+void StlOutput::writeBinaryFacet(const StlFacet &facet, char* dst)
 {
-	write_stream << "outer loop" << endl;
-	for (size_t i = 0; i != 3; i++)
-		writeVertex(vertices[i]);
-	write_stream << "endloop" << endl;
+	static_assert(sizeof(StlFacet) == sizeof(float) * 12, "StlFacet must be 12 packed floats");
+
+	memcpy(dst, &facet, sizeof(StlFacet));
+	memset(dst + sizeof(StlFacet), 0, sizeof(uint16_t));  // attribute byte count
 }
 
-void StlOutput::writeVertex(PxVec3 vertex)
+bool readStl(const string &file_path, StlFormat::Enum format, vector<StlFacet> &facets)
 {
-	write_stream << "vertex " << fixed << setprecision(3) << vertex.x << " " << vertex.y << " " << vertex.z << endl;
+	facets.clear();
+	ifstream stream(file_path, format == StlFormat::eBINARY ? ios::in | ios::binary : ios::in);
+	if (!stream)
+		return false;
+
+	if (format == StlFormat::eBINARY) {
+		const size_t kHeaderSize = 80;
+		const size_t kFacetSize = 50;  // 法線(12) + 頂点(36) + 属性(2)
+		char header[kHeaderSize];
+		uint32_t triangle_cnt = 0;
+		if (!stream.read(header, kHeaderSize) || !stream.read((char*)&triangle_cnt, sizeof(triangle_cnt)))
+			return false;
+
+		facets.resize(triangle_cnt);
+		char record[kFacetSize];
+		for (uint32_t i = 0; i != triangle_cnt; i++) {
+			if (!stream.read(record, kFacetSize))
+				return false;
+			memcpy(&facets[i], record, sizeof(StlFacet));
+		}
+		// 三角形数より後ろにデータが残っていれば壊れている
+		return stream.peek() == char_traits<char>::eof();
+	}
+
+	// ASCII形式: "facet normal"の後に"vertex"が3つ続く
+	string token;
+	if (!(stream >> token) || token != "solid")
+		return false;
+	size_t vertex_cnt = 3;
+	while (stream >> token) {
+		if (token == "facet") {
+			if (vertex_cnt != 3)
+				return false;
+			StlFacet facet;
+			if (!(stream >> token) || token != "normal"
+				|| !(stream >> facet.normal.x >> facet.normal.y >> facet.normal.z))
+				return false;
+			facets.push_back(facet);
+			vertex_cnt = 0;
+		}
+		else if (token == "vertex") {
+			if (vertex_cnt == 3)
+				return false;
+			PxVec3 &vertex = facets.back().vertices[vertex_cnt++];
+			if (!(stream >> vertex.x >> vertex.y >> vertex.z))
+				return false;
+		}
+		else if (token == "endsolid") {
+			return vertex_cnt == 3;
+		}
+	}
+	return false;  // endsolidが無い
 }
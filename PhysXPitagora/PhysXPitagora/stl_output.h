@@ -1,37 +1,144 @@
 #pragma once
 #include "PxPhysicsAPI.h"
+#include "stl_mesh.h"
 #include <vector>
 #include <fstream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 using namespace physx;
 
 
-class Triangle {
-public:
-	Triangle(PxVec3 normal, PxVec3* vertices)
-	{
-		this->normal_ = normal;
-		this->vertices_ptr_ = vertices;
-	}
-	PxVec3 normal_;
-	PxVec3 *vertices_ptr_;
+// STLの三角形1つ分(法線と3頂点)
+struct StlFacet {
+	PxVec3 normal;
+	PxVec3 vertices[3];
+};
+
+// 書き出し対象の形状(アクターの先頭のshape)
+// シーンを参照せずにテッセレーションできるよう、形状と寸法をコピーして保持する
+struct StlShape {
+	PxGeometryType::Enum type;  // eBOX or eSPHERE
+	PxVec3 half_extents;        // box
+	PxReal radius;              // sphere
+	PxTransform local_pose;     // アクター座標系での姿勢
+
+	// actorの先頭のshapeを取得する。shapeが無い場合はfalse
+	static bool fromActor(const PxRigidActor &actor, StlShape &shape);
+};
+
+// STLファイルの出力形式
+struct StlFormat {
+	enum Enum {
+		eASCII,  // テキスト形式
+		eBINARY  // バイナリ形式(80byteヘッダ + 三角形数 + 50byte/三角形)
+	};
+};
+
+// 書き出し結果
+struct StlOutputStats {
+	size_t actor_cnt;
+	size_t triangle_cnt;
+	size_t bytes_written;
+	// 書き出し中に、export間で使い回す作業領域(ワーカー、スレッド、三角形・頂点・書き出しデータのバッファ)を
+	// 拡張した回数(2回目以降のexportでは通常0)
+	// ファイルのストリームやパスの文字列など、exportごとの確保は含まない
+	size_t buffer_growth_cnt;
+	PxU32 thread_cnt;
+	double seconds;
 };
 
 class StlOutput {
 public:
-	void outputStl(string output_path, PxActor** actor_buffer, PxU32 actor_cnt, bool divide_file);
+	StlOutput();
+	~StlOutput();
+
+	StlOutput(const StlOutput&) = delete;
+	StlOutput& operator=(const StlOutput&) = delete;
+
+	// thread_cnt: 2以上にすると剛体のテッセレーションを複数スレッドで行う
+	//  1ファイルにまとめる場合も、出力内容はアクター順でシングルスレッドと同一になる
+	StlOutputStats outputStl(const string &output_path, PxActor** actor_buffer, PxU32 actor_cnt, bool divide_file,
+		StlFormat::Enum format = StlFormat::eASCII, PxU32 thread_cnt = 1);
+
+	// 形状とワールド座標系の姿勢(actorの姿勢)の配列から、1つのSTLファイルを書き出す
+	// PxActorを参照しないので、シミュレーション中に別スレッドから呼び出せる
+	StlOutputStats outputShapes(const string &file_path, const StlShape* shapes, const PxTransform* actor_poses,
+		PxU32 shape_cnt, StlFormat::Enum format);
 
 private:
-	ofstream write_stream;
-
-	size_t writeRigidActor(PxRigidActor* actor);
-	size_t writeBox(const PxTransform &transform, const PxVec3 &scale);
-	size_t writeSphere(const PxTransform &transform, const PxReal radius);
-	size_t writeSolid(const vector<Triangle> &triangles);
-	void createSphereVerticesAndNormals(vector<PxVec3> &sphere_vertices, vector<PxVec3> &sphere_normals, vector<short> &sphere_indices, int rings, int sectors);
-
-	void writeFacetNormal(PxVec3 normal, PxVec3 *vertices);
-	void writeOuterLoop(PxVec3 *vertices);
-	void writeVertex(PxVec3 vertex);
-};
\ No newline at end of file
+	static const size_t kBinaryHeaderSize = 80;
+	static const size_t kBinaryFacetSize = 50;  // 法線(12) + 頂点(36) + 属性(2)
+	static const int kSphereRings = 20;
+	static const int kSphereSectors = 20;
+	static const PxU32 kChunkActorCnt = 64;     // 並列書き出しで1度にワーカーが受け持つアクター数
+
+	// スレッドごとの作業領域(export間で使い回す)
+	struct Worker {
+		Worker() : allocation_cnt(0), triangle_cnt(0), bytes_written(0) {}
+
+		vector<StlFacet> facets;  // 1剛体分の三角形バッファ
+		vector<float> transformed_x, transformed_y, transformed_z;  // 変換後の頂点(SoA)
+		vector<char> buffer;      // 1ファイル分の書き出しデータ
+		string file_path;         // 書き出すファイルのパス(アクターごとに書き出す場合)
+		size_t allocation_cnt;
+		size_t triangle_cnt;
+		size_t bytes_written;
+	};
+
+	// 1ファイルにまとめて並列に書き出す時の、書き出し待ちデータ
+	struct Chunk {
+		Chunk() : index(0), triangle_cnt(0), done(false) {}
+
+		PxU32 index;
+		vector<char> buffer;
+		size_t triangle_cnt;
+		bool done;
+	};
+
+	StlFormat::Enum format_;
+	UnitMeshCache mesh_cache_;
+	vector<Worker> workers_;
+	vector<Chunk> chunks_;
+	size_t allocation_cnt_;  // workers_/chunks_/threads_を拡張した回数
+
+	// ワーカーを実行するスレッド(export間で使い回す)
+	// threads_[i]は、runWorkersが呼ばれるたびにi < work_thread_cnt_ならworkers_[first_worker_ + i]でwork_を実行する
+	vector<thread> threads_;
+	mutex thread_mutex_;
+	condition_variable thread_cv_;          // 仕事の投入と完了の通知
+	const function<void(Worker&)>* work_;
+	PxU32 first_worker_;
+	PxU32 work_thread_cnt_;
+	PxU32 generation_;                      // 仕事を投入するたびに増やす
+	PxU32 running_thread_cnt_;              // 仕事を終えていないスレッド数
+	bool quit_;
+
+	void writeDividedFiles(const string &output_path, PxActor** actor_buffer, PxU32 actor_cnt, PxU32 thread_cnt);
+	void writeCombinedFile(const string &file_path, PxActor** actor_buffer, PxU32 actor_cnt, PxU32 thread_cnt);
+	void runWorkers(PxU32 thread_cnt, const function<void(Worker&)> &work, const function<void()> &main_work);
+	void threadMain(PxU32 index);
+
+	size_t writeRigidActor(Worker &worker, PxRigidActor* actor, vector<char> &out);
+	size_t writeShape(Worker &worker, const StlShape &shape, const PxTransform &transform, vector<char> &out);
+	size_t writeBox(Worker &worker, const PxTransform &transform, const PxVec3 &scale, vector<char> &out);
+	size_t writeSphere(Worker &worker, const PxTransform &transform, const PxReal radius, vector<char> &out);
+	size_t writeMesh(Worker &worker, const UnitMesh &mesh, const PxMat44 &model_matrix, vector<char> &out);
+	StlFacet* allocateFacets(Worker &worker, size_t n);
+	size_t writeSolid(Worker &worker, vector<char> &out);
+
+	void beginSolid(Worker &worker, vector<char> &out);
+	void endSolid(Worker &worker, vector<char> &out, size_t triangle_cnt);
+	size_t writeFile(const string &file_path, const vector<char> &data);
+	char* growBuffer(vector<char> &out, size_t size, size_t &allocation_cnt);
+
+	void writeFacetNormal(Worker &worker, const StlFacet &facet, vector<char> &out);
+	void writeBinaryFacet(const StlFacet &facet, char* dst);
+};
+
+// STLファイルを読み込み、三角形をfacetsに格納する(書き出しの確認用)
+// ファイルが開けない、または形式が壊れている場合はfalse
+bool readStl(const string &file_path, StlFormat::Enum format, vector<StlFacet> &facets);
@@ -0,0 +1,141 @@
+#include "trace_profiler.h"
+#include <iomanip>
+
+
+using namespace std;
+
+TraceProfiler::TraceProfiler()
+	: start_time_(chrono::steady_clock::now()), next_(NULL), installed_(false), dropped_cnt_(0)
+{
+}
+
+TraceProfiler::~TraceProfiler()
+{
+	uninstall();
+}
+
+void TraceProfiler::install()
+{
+	if (installed_)
+		return;
+	next_ = PxGetProfilerCallback();
+	start_time_ = chrono::steady_clock::now();
+	main_thread_ = this_thread::get_id();
+	PxSetProfilerCallback(this);
+	installed_ = true;
+}
+
+void TraceProfiler::uninstall()
+{
+	if (!installed_)
+		return;
+	PxSetProfilerCallback(next_);
+	next_ = NULL;
+	installed_ = false;
+}
+
+void* TraceProfiler::zoneStart(const char* eventName, bool detached, uint64_t contextId)
+{
+	record(eventName, detached ? 'b' : 'B', contextId);
+	return next_ ? next_->zoneStart(eventName, detached, contextId) : NULL;
+}
+
+void TraceProfiler::zoneEnd(void* profilerData, const char* eventName, bool detached, uint64_t contextId)
+{
+	record(eventName, detached ? 'e' : 'E', contextId);
+	if (next_)
+		next_->zoneEnd(profilerData, eventName, detached, contextId);
+}
+
+// 呼び出したスレッドのバッファ
+// 最初の呼び出しでのみロックを取って登録し、以降はthread_localのポインタを使う
+TraceProfiler::ThreadBuffer* TraceProfiler::getThreadBuffer()
+{
+	thread_local const TraceProfiler* tls_owner = NULL;
+	thread_local ThreadBuffer* tls_buffer = NULL;
+	if (tls_owner == this)
+		return tls_buffer;
+
+	unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+	{
+		lock_guard<mutex> lock(mutex_);
+		buffer->thread_index = (PxU32)buffers_.size();
+		buffer->main_thread = this_thread::get_id() == main_thread_;
+		buffers_.push_back(move(buffer));
+		tls_buffer = buffers_.back().get();
+	}
+	tls_owner = this;
+	return tls_buffer;
+}
+
+void TraceProfiler::record(const char* name, char phase, uint64_t context_id)
+{
+	const uint64_t kTime = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now() - start_time_).count();
+
+	ThreadBuffer* buffer = getThreadBuffer();
+	const size_t kIndex = buffer->event_cnt.load(memory_order_relaxed);
+	const size_t kChunk = kIndex / kChunkEventCnt;
+	if (kChunk == buffer->chunks.size()) {
+		if (kChunk == kMaxChunkCnt) {
+			dropped_cnt_.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+		buffer->chunks.push_back(unique_ptr<Event[]>(new Event[kChunkEventCnt]));
+	}
+
+	Event &event = buffer->chunks[kChunk][kIndex % kChunkEventCnt];
+	event.name = name;
+	event.time = kTime;
+	event.context_id = context_id;
+	event.phase = phase;
+	buffer->event_cnt.store(kIndex + 1, memory_order_release);
+}
+
+PxU64 TraceProfiler::getEventCount() const
+{
+	lock_guard<mutex> lock(mutex_);
+	PxU64 event_cnt = 0;
+	for (size_t i = 0; i != buffers_.size(); i++)
+		event_cnt += buffers_[i]->event_cnt.load(memory_order_acquire);
+	return event_cnt;
+}
+
+PxU32 TraceProfiler::getThreadCount() const
+{
+	lock_guard<mutex> lock(mutex_);
+	return (PxU32)buffers_.size();
+}
+
+// tsはマイクロ秒。スレッドごとにtidを分け、thread_nameのメタデータで名前を付ける
+void TraceProfiler::writeChromeTrace(ostream &out) const
+{
+	lock_guard<mutex> lock(mutex_);
+
+	out << "{\"traceEvents\":[" << endl;
+	for (size_t b = 0; b != buffers_.size(); b++) {
+		const ThreadBuffer &buffer = *buffers_[b];
+		const PxU32 kTid = buffer.thread_index + 1;
+		out << (b == 0 ? "" : ",\n")
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << kTid
+			<< ",\"args\":{\"name\":\"";
+		if (buffer.main_thread)
+			out << "main";
+		else
+			out << "thread " << kTid;
+		out << "\"}}";
+
+		const size_t kEventCnt = buffer.event_cnt.load(memory_order_acquire);
+		for (size_t i = 0; i != kEventCnt; i++) {
+			const Event &event = buffer.chunks[i / kChunkEventCnt][i % kChunkEventCnt];
+			out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"physx\",\"ph\":\"" << event.phase
+				<< "\",\"ts\":" << event.time / 1000 << "." << setw(3) << setfill('0') << event.time % 1000
+				<< setfill(' ') << ",\"pid\":1,\"tid\":" << kTid;
+			// 別スレッドで終了しうるゾーンは、contextIdで開始と終了を対応させる
+			if (event.phase == 'b' || event.phase == 'e')
+				out << ",\"id\":" << event.context_id;
+			out << "}";
+		}
+	}
+	out << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+}
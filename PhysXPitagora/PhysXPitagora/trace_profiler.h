@@ -0,0 +1,107 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <ostream>
+
+using namespace std;
+using namespace physx;
+
+// PhysX内部のプロファイルゾーン(broadphase、narrowphase、island生成、ソルバーなど)を
+// スレッドごとに記録し、Chromeのtrace event形式のJSON(chrome://tracingやPerfettoで開ける)に書き出す
+//
+// 各スレッドは自分専用のバッファに追記するだけなので、記録にロックは使わない
+// (ロックを取るのは、スレッドが最初に記録するときのバッファの登録のみ)
+// バッファはkChunkEventCnt個ずつ確保し、1スレッドあたりkMaxChunkCnt個を超える分は捨てて数だけ数える
+//
+// PxCreateFoundationの後にinstallでPxSetProfilerCallbackに登録する
+// PVDなど既に登録されているコールバックがあれば、そちらにもゾーンを渡す
+// PhysXのrelease構成のライブラリが報告するゾーンは少ないので、詳細はprofile構成で確認する
+class TraceProfiler : public PxProfilerCallback {
+public:
+	TraceProfiler();
+	virtual ~TraceProfiler();
+	TraceProfiler(const TraceProfiler&) = delete;
+	TraceProfiler& operator=(const TraceProfiler&) = delete;
+
+	// PxSetProfilerCallbackに登録する(それまでのコールバックは引き継ぐ)
+	void install();
+
+	// 登録を解除し、元のコールバックに戻す
+	// 記録中のスレッドが無くなってから(simulateの完了後に)呼ぶ
+	void uninstall();
+
+	// 記録したゾーンをtrace eventのJSONとして書き出す。uninstallの後に呼ぶ
+	void writeChromeTrace(ostream &out) const;
+
+	// 記録したイベント数(ゾーンの開始と終了を1つずつ数える)と、捨てたイベント数
+	PxU64 getEventCount() const;
+	PxU64 getDroppedCount() const { return dropped_cnt_.load(memory_order_relaxed); }
+	PxU32 getThreadCount() const;
+
+	// PxProfilerCallback
+	virtual void* zoneStart(const char* eventName, bool detached, uint64_t contextId);
+	virtual void zoneEnd(void* profilerData, const char* eventName, bool detached, uint64_t contextId);
+
+private:
+	static const size_t kChunkEventCnt = 16 * 1024;
+	static const size_t kMaxChunkCnt = 64;
+
+	struct Event {
+		const char* name;  // PhysXのゾーン名は文字列リテラルなので、ポインタのみを持つ
+		uint64_t time;     // 記録開始からの時間(ns)
+		uint64_t context_id;
+		char phase;        // 'B'/'E': 同じスレッドで開始・終了するゾーン、'b'/'e': 別スレッドで終了しうるゾーン
+	};
+
+	// 1つのスレッドのイベント(書き込むのはそのスレッドのみ)
+	struct ThreadBuffer {
+		PxU32 thread_index;
+		bool main_thread;  // installを呼んだスレッド
+		vector<unique_ptr<Event[]> > chunks;
+		atomic<size_t> event_cnt;
+
+		ThreadBuffer() : thread_index(0), main_thread(false), event_cnt(0) {}
+	};
+
+	chrono::steady_clock::time_point start_time_;
+	PxProfilerCallback* next_;  // install前に登録されていたコールバック
+	thread::id main_thread_;
+	bool installed_;
+
+	mutable mutex mutex_;  // buffers_の追加と読み出しのみ
+	vector<unique_ptr<ThreadBuffer> > buffers_;
+	atomic<PxU64> dropped_cnt_;
+
+	ThreadBuffer* getThreadBuffer();
+	void record(const char* name, char phase, uint64_t context_id);
+};
+
+// アプリケーション側の処理(シーンの作成、書き出しなど)のゾーン
+// PxGetProfilerCallbackに登録されたコールバックに、スコープの開始と終了を渡す
+class TraceZone {
+public:
+	TraceZone(const char* name, uint64_t context_id = 0)
+		: callback_(PxGetProfilerCallback()), name_(name), context_id_(context_id), data_(NULL)
+	{
+		if (callback_)
+			data_ = callback_->zoneStart(name_, false, context_id_);
+	}
+	~TraceZone()
+	{
+		if (callback_)
+			callback_->zoneEnd(data_, name_, false, context_id_);
+	}
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	PxProfilerCallback* callback_;
+	const char* name_;
+	uint64_t context_id_;
+	void* data_;
+};
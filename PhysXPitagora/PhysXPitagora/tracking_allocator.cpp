@@ -0,0 +1,247 @@
+#include "tracking_allocator.h"
+#include <iomanip>
+#include <map>
+#include <string>
+#include <algorithm>
+
+
+using namespace std;
+
+TrackingAllocator::TrackingAllocator()
+	: pool_enabled_(false), phase_(AllocationPhase::eINIT)
+{
+	static_assert(sizeof(BlockHeader) <= kHeaderSize, "BlockHeader must fit in kHeaderSize");
+	static_assert(kHeaderSize % 16 == 0, "kHeaderSize must keep 16 byte alignment");
+	for (PxU32 i = 0; i != kSizeClassCnt; i++)
+		free_lists_[i] = NULL;
+}
+
+// プールのページは終了時にまとめて解放する
+TrackingAllocator::~TrackingAllocator()
+{
+	for (size_t i = 0; i != pages_.size(); i++)
+		backend_.deallocate(pages_[i]);
+}
+
+void* TrackingAllocator::allocate(size_t size, const char* typeName, const char* filename, int line)
+{
+	const PxU32 kSizeClass = getSizeClass(size);
+	const bool kPooled = pool_enabled_ && kSizeClass != kNoSizeClass;
+
+	// プールを使わない確保はロックの外で行う
+	char* block = NULL;
+	if (!kPooled) {
+		block = static_cast<char*>(backend_.allocate(kHeaderSize + size, typeName, filename, line));
+		if (!block)
+			return NULL;
+	}
+
+	lock_guard<mutex> lock(mutex_);
+	if (kPooled) {
+		block = static_cast<char*>(allocateFromPool(kSizeClass));
+		if (!block)
+			return NULL;
+	}
+
+	BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+	header->size = size;
+	header->tag = typeName;
+	header->phase = phase_;
+	header->size_class = kPooled ? kSizeClass : kNoSizeClass;
+
+	addAllocation(total_, size);
+
+	Stats &phase = phases_[phase_];
+	phase.allocation_cnt++;
+	phase.allocated_bytes += size;
+	phase.live_bytes += size;
+	phase.peak_bytes = PxMax(phase.peak_bytes, total_.live_bytes);
+
+	TagStats &tag = tags_[typeName];
+	addAllocation(tag, size);
+	if (phase_ == AllocationPhase::eSIMULATE) {
+		tag.simulate_allocation_cnt++;
+		if (!steps_.empty()) {
+			steps_.back().allocation_cnt++;
+			steps_.back().allocated_bytes += size;
+		}
+	}
+
+	// プールを使わない場合も、プールを使った場合に割り当てられるサイズクラスで数える
+	if (kSizeClass != kNoSizeClass) {
+		SizeClassStats &size_class = size_classes_[kSizeClass];
+		size_class.allocation_cnt++;
+		if (kPooled)
+			size_class.pooled_cnt++;
+		size_class.live_blocks++;
+		size_class.peak_blocks = PxMax(size_class.peak_blocks, size_class.live_blocks);
+	}
+
+	return block + kHeaderSize;
+}
+
+void TrackingAllocator::deallocate(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	char* block = static_cast<char*>(ptr) - kHeaderSize;
+	const BlockHeader kHeader = *reinterpret_cast<BlockHeader*>(block);
+	{
+		lock_guard<mutex> lock(mutex_);
+		total_.deallocation_cnt++;
+		total_.live_bytes -= kHeader.size;
+
+		// 解放数は解放した区間、残っている量は確保した区間で数える
+		phases_[phase_].deallocation_cnt++;
+		phases_[kHeader.phase].live_bytes -= kHeader.size;
+
+		TagStats &tag = tags_[kHeader.tag];
+		tag.deallocation_cnt++;
+		tag.live_bytes -= kHeader.size;
+
+		const PxU32 kSizeClass = getSizeClass(kHeader.size);
+		if (kSizeClass != kNoSizeClass)
+			size_classes_[kSizeClass].live_blocks--;
+
+		// プールのブロックは空きリストへ戻す
+		if (kHeader.size_class != kNoSizeClass) {
+			*reinterpret_cast<void**>(block) = free_lists_[kHeader.size_class];
+			free_lists_[kHeader.size_class] = block;
+			return;
+		}
+	}
+	backend_.deallocate(block);
+}
+
+void TrackingAllocator::setPhase(AllocationPhase::Enum phase)
+{
+	lock_guard<mutex> lock(mutex_);
+	phase_ = phase;
+	phases_[phase].peak_bytes = PxMax(phases_[phase].peak_bytes, total_.live_bytes);
+	if (phase == AllocationPhase::eSIMULATE) {
+		const StepStats kStep = { 0, 0 };
+		steps_.push_back(kStep);
+	}
+}
+
+size_t TrackingAllocator::getLiveBytes() const
+{
+	lock_guard<mutex> lock(mutex_);
+	return total_.live_bytes;
+}
+
+size_t TrackingAllocator::getPeakBytes() const
+{
+	lock_guard<mutex> lock(mutex_);
+	return total_.peak_bytes;
+}
+
+void TrackingAllocator::writeSummary(ostream &out, size_t tag_cnt) const
+{
+	lock_guard<mutex> lock(mutex_);
+	const double kKB = 1.0 / 1024.0;
+	out << fixed << setprecision(1);
+
+	out << "PhysX memory (pool " << (pool_enabled_ ? "on" : "off") << ")" << endl;
+	out << "\tallocations: " << total_.allocation_cnt << ", allocated: " << total_.allocated_bytes * kKB
+		<< " KB, peak: " << total_.peak_bytes * kKB << " KB, live: " << total_.live_bytes * kKB << " KB" << endl;
+
+	// 区間ごと(retainedはその区間で確保されて解放されていない量)
+	const char* kPhaseNames[] = { "init", "scene build", "simulate", "export", "shutdown" };
+	out << "phase\tallocs\tfrees\tallocated[KB]\tretained[KB]\tpeak[KB]" << endl;
+	for (PxU32 i = 0; i != AllocationPhase::eCOUNT; i++) {
+		const Stats &phase = phases_[i];
+		out << kPhaseNames[i] << "\t" << phase.allocation_cnt << "\t" << phase.deallocation_cnt << "\t"
+			<< phase.allocated_bytes * kKB << "\t" << phase.live_bytes * kKB << "\t" << phase.peak_bytes * kKB << endl;
+	}
+
+	// ステップごとの確保(1ステップ目は初回の領域確保を含むので別に表示する)
+	if (!steps_.empty()) {
+		PxU64 total_cnt = 0, total_bytes = 0, max_cnt = 0, max_bytes = 0;
+		for (size_t i = 1; i < steps_.size(); i++) {
+			total_cnt += steps_[i].allocation_cnt;
+			total_bytes += steps_[i].allocated_bytes;
+			max_cnt = PxMax(max_cnt, steps_[i].allocation_cnt);
+			max_bytes = PxMax(max_bytes, steps_[i].allocated_bytes);
+		}
+		const double kRestCnt = (double)PxMax(steps_.size() - 1, size_t(1));
+		out << "steps: " << steps_.size() << endl;
+		out << "\tfirst step:  " << steps_[0].allocation_cnt << " allocs, "
+			<< steps_[0].allocated_bytes * kKB << " KB" << endl;
+		out << "\tlater steps: " << total_cnt / kRestCnt << " allocs, " << total_bytes * kKB / kRestCnt
+			<< " KB per step (max " << max_cnt << " allocs, " << max_bytes * kKB << " KB)" << endl;
+	}
+
+	// サイズクラスごと(peak blocksはプールに必要なブロック数の目安)
+	out << "size class\tallocs\tpooled\tpeak blocks" << endl;
+	for (PxU32 i = 0; i != kSizeClassCnt; i++) {
+		const SizeClassStats &size_class = size_classes_[i];
+		out << "<= " << (32 << i) << " B\t" << size_class.allocation_cnt << "\t" << size_class.pooled_cnt << "\t"
+			<< size_class.peak_blocks << endl;
+	}
+	if (pool_enabled_)
+		out << "\tpool pages: " << pages_.size() << " (" << pages_.size() * kPageSize * kKB << " KB)" << endl;
+
+	// 確保名ごと(同じ名前の別のポインタはまとめる。peakはそれぞれの最大値の和)
+	map<string, TagStats> merged;
+	for (unordered_map<const char*, TagStats>::const_iterator it = tags_.begin(); it != tags_.end(); ++it) {
+		TagStats &tag = merged[it->first ? it->first : "(unnamed)"];
+		tag.allocation_cnt += it->second.allocation_cnt;
+		tag.deallocation_cnt += it->second.deallocation_cnt;
+		tag.allocated_bytes += it->second.allocated_bytes;
+		tag.live_bytes += it->second.live_bytes;
+		tag.peak_bytes += it->second.peak_bytes;
+		tag.simulate_allocation_cnt += it->second.simulate_allocation_cnt;
+	}
+	vector<pair<string, TagStats> > sorted(merged.begin(), merged.end());
+	sort(sorted.begin(), sorted.end(), [](const pair<string, TagStats> &a, const pair<string, TagStats> &b) {
+		return a.second.peak_bytes > b.second.peak_bytes;
+	});
+
+	const double kStepCnt = (double)PxMax(steps_.size(), size_t(1));
+	out << "allocs\tper step\tpeak[KB]\tlive[KB]\tname" << endl;
+	for (size_t i = 0; i != PxMin(tag_cnt, sorted.size()); i++) {
+		const TagStats &tag = sorted[i].second;
+		out << tag.allocation_cnt << "\t" << tag.simulate_allocation_cnt / kStepCnt << "\t"
+			<< tag.peak_bytes * kKB << "\t" << tag.live_bytes * kKB << "\t" << sorted[i].first << endl;
+	}
+}
+
+PxU32 TrackingAllocator::getSizeClass(size_t size)
+{
+	for (PxU32 i = 0; i != kSizeClassCnt; i++) {
+		if (size <= (size_t(32) << i))
+			return i;
+	}
+	return kNoSizeClass;
+}
+
+// 空きブロックが無ければページを確保してブロックに切り分ける
+void* TrackingAllocator::allocateFromPool(PxU32 size_class)
+{
+	if (!free_lists_[size_class]) {
+		char* page = static_cast<char*>(backend_.allocate(kPageSize, "TrackingAllocator pool", __FILE__, __LINE__));
+		if (!page)
+			return NULL;
+		pages_.push_back(page);
+
+		const size_t kBlockSize = getBlockSize(size_class);
+		for (size_t offset = 0; offset + kBlockSize <= kPageSize; offset += kBlockSize) {
+			*reinterpret_cast<void**>(page + offset) = free_lists_[size_class];
+			free_lists_[size_class] = page + offset;
+		}
+	}
+
+	void* block = free_lists_[size_class];
+	free_lists_[size_class] = *reinterpret_cast<void**>(block);
+	return block;
+}
+
+void TrackingAllocator::addAllocation(Stats &stats, size_t size)
+{
+	stats.allocation_cnt++;
+	stats.allocated_bytes += size;
+	stats.live_bytes += size;
+	stats.peak_bytes = PxMax(stats.peak_bytes, stats.live_bytes);
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <mutex>
+
+using namespace std;
+using namespace physx;
+
+// メモリ確保を集計する区間
+struct AllocationPhase {
+	enum Enum {
+		eINIT,         // Foundation/Physicsの作成
+		eSCENE_BUILD,  // シーンとアクターの作成
+		eSIMULATE,     // simulateからfetchResultsまで(1ステップごとにも集計する)
+		eEXPORT,       // STLなどの書き出し
+		eSHUTDOWN,     // 終了処理
+		eCOUNT
+	};
+};
+
+// 確保数と確保量を、確保名(typeName)ごと・区間ごとに集計するアロケータ
+// 小さな確保は、固定サイズのブロックを切り出すプールから割り当てることもできる
+//
+// 各ブロックの先頭にkHeaderSize byteのヘッダを置き、要求サイズ・確保名・区間を記録する
+// PhysXは16byte境界に揃ったメモリを要求するので、ヘッダも16の倍数にする
+class TrackingAllocator : public PxAllocatorCallback {
+public:
+	TrackingAllocator();
+	virtual ~TrackingAllocator();
+
+	virtual void* allocate(size_t size, const char* typeName, const char* filename, int line);
+	virtual void deallocate(void* ptr);
+
+	// プールを使うかどうか。最初の確保より前に設定する
+	void setPoolEnabled(bool enabled) { pool_enabled_ = enabled; }
+
+	// 以降の確保を集計する区間を切り替える
+	// eSIMULATEへ切り替えるたびに1ステップとして数える
+	void setPhase(AllocationPhase::Enum phase);
+
+	// 現在確保されている量(byte)と、その最大値
+	size_t getLiveBytes() const;
+	size_t getPeakBytes() const;
+
+	// 集計結果を書き出す。tag_cntは表示する確保名の数(最大確保量の多い順)
+	void writeSummary(ostream &out, size_t tag_cnt = 20) const;
+
+private:
+	static const size_t kHeaderSize = 32;
+	static const size_t kPageSize = 64 * 1024;  // プールが1度に確保する大きさ
+	static const PxU32 kSizeClassCnt = 5;       // 32, 64, 128, 256, 512byte以下
+	static const PxU32 kNoSizeClass = 0xffffffff;
+
+	struct BlockHeader {
+		size_t size;      // 要求サイズ
+		const char* tag;  // 確保名
+		PxU32 phase;
+		PxU32 size_class; // プールから割り当てた場合のサイズクラス(それ以外はkNoSizeClass)
+	};
+
+	struct Stats {
+		Stats() : allocation_cnt(0), deallocation_cnt(0), allocated_bytes(0), live_bytes(0), peak_bytes(0) {}
+
+		PxU64 allocation_cnt;
+		PxU64 deallocation_cnt;
+		PxU64 allocated_bytes;  // 確保量の累計
+		size_t live_bytes;      // 区間の場合は、その区間で確保されて解放されていない量
+		size_t peak_bytes;      // 区間の場合は、その区間中の全体の最大確保量
+	};
+
+	struct TagStats : Stats {
+		TagStats() : simulate_allocation_cnt(0) {}
+
+		PxU64 simulate_allocation_cnt;  // eSIMULATE中の確保数(ステップごとの確保の多い確保名を探す)
+	};
+
+	// 1ステップ分の確保
+	struct StepStats {
+		PxU64 allocation_cnt;
+		PxU64 allocated_bytes;
+	};
+
+	// サイズクラスごとの確保数と同時に確保されていたブロック数(プールの大きさの目安)
+	struct SizeClassStats {
+		SizeClassStats() : allocation_cnt(0), pooled_cnt(0), live_blocks(0), peak_blocks(0) {}
+
+		PxU64 allocation_cnt;
+		PxU64 pooled_cnt;  // プールから割り当てた数
+		size_t live_blocks;
+		size_t peak_blocks;
+	};
+
+	PxDefaultAllocator backend_;  // プール以外の確保とプールのページの確保
+	bool pool_enabled_;
+
+	mutable mutex mutex_;  // 以下を保護する(PhysXのワーカースレッドからも確保される)
+	AllocationPhase::Enum phase_;
+	Stats total_;
+	Stats phases_[AllocationPhase::eCOUNT];
+	unordered_map<const char*, TagStats> tags_;  // 確保名は文字列リテラルなのでポインタで引く
+	vector<StepStats> steps_;
+	SizeClassStats size_classes_[kSizeClassCnt];
+	void* free_lists_[kSizeClassCnt];  // プールの空きブロック(先頭に次の空きブロックを置く)
+	vector<void*> pages_;
+
+	static PxU32 getSizeClass(size_t size);
+	static size_t getBlockSize(PxU32 size_class) { return kHeaderSize + (size_t(32) << size_class); }
+	void* allocateFromPool(PxU32 size_class);
+	void addAllocation(Stats &stats, size_t size);
+};
@@ -0,0 +1,174 @@
+#include "work_stealing_dispatcher.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#endif
+
+
+using namespace std;
+
+namespace {
+	// 現在のスレッドがワーカーの場合、そのディスパッチャとワーカー番号
+	thread_local const WorkStealingDispatcher* tls_dispatcher = NULL;
+	thread_local PxU32 tls_worker_index = 0;
+}
+
+WorkStealingDispatcher::WorkStealingDispatcher(PxU32 thread_cnt, bool pin_threads)
+	: pending_cnt_(0), next_worker_(0), executed_cnt_(0), stolen_cnt_(0), stopping_(false)
+{
+	// 全ワーカーのdequeを用意してからスレッドを起動する(起動直後に他のdequeを盗みにいくため)
+	for (PxU32 i = 0; i != thread_cnt; i++)
+		workers_.push_back(unique_ptr<Worker>(new Worker()));
+
+	for (PxU32 i = 0; i != thread_cnt; i++) {
+		workers_[i]->worker_thread = thread(&WorkStealingDispatcher::workerLoop, this, i);
+		if (pin_threads)
+			pinThread(workers_[i]->worker_thread, i);
+	}
+}
+
+WorkStealingDispatcher::~WorkStealingDispatcher()
+{
+	{
+		lock_guard<mutex> lock(sleep_mutex_);
+		stopping_ = true;
+	}
+	wake_cv_.notify_all();
+	for (size_t i = 0; i != workers_.size(); i++)
+		workers_[i]->worker_thread.join();
+}
+
+// ワーカーから投入されたタスクはそのワーカーのdequeへ、それ以外は順番に各ワーカーへ振り分ける
+void WorkStealingDispatcher::submitTask(PxBaseTask &task)
+{
+	if (workers_.empty()) {
+		runTask(task);
+		return;
+	}
+
+	const PxU32 kIndex = tls_dispatcher == this
+		? tls_worker_index : next_worker_++ % (PxU32)workers_.size();
+	pending_cnt_++;  // 取り出した側で先に減らさないよう、dequeに入れる前に増やす
+	{
+		Worker &worker = *workers_[kIndex];
+		lock_guard<mutex> lock(worker.task_mutex);
+		worker.tasks.push_back(&task);
+	}
+
+	// 待機の判定とすれ違わないよう、sleep_mutex_を通してから起こす
+	{
+		lock_guard<mutex> lock(sleep_mutex_);
+	}
+	wake_cv_.notify_one();
+}
+
+uint32_t WorkStealingDispatcher::getWorkerCount() const
+{
+	return (uint32_t)workers_.size();
+}
+
+void WorkStealingDispatcher::workerLoop(PxU32 index)
+{
+	tls_dispatcher = this;
+	tls_worker_index = index;
+
+	while (true) {
+		PxBaseTask* task = popTask(index);
+		if (!task)
+			task = stealTask(index);
+		if (task) {
+			runTask(*task);
+			continue;
+		}
+
+		unique_lock<mutex> lock(sleep_mutex_);
+		wake_cv_.wait(lock, [this] { return stopping_ || pending_cnt_ != 0; });
+		if (stopping_)
+			break;
+	}
+}
+
+// 自分のdequeの末尾から取り出す
+PxBaseTask* WorkStealingDispatcher::popTask(PxU32 index)
+{
+	Worker &worker = *workers_[index];
+	lock_guard<mutex> lock(worker.task_mutex);
+	if (worker.tasks.empty())
+		return NULL;
+	PxBaseTask* task = worker.tasks.back();
+	worker.tasks.pop_back();
+	pending_cnt_--;
+	return task;
+}
+
+// 隣のワーカーから順に、dequeの先頭から盗む
+PxBaseTask* WorkStealingDispatcher::stealTask(PxU32 index)
+{
+	const PxU32 kWorkerCnt = (PxU32)workers_.size();
+	for (PxU32 i = 1; i < kWorkerCnt; i++) {
+		Worker &victim = *workers_[(index + i) % kWorkerCnt];
+		lock_guard<mutex> lock(victim.task_mutex);
+		if (victim.tasks.empty())
+			continue;
+		PxBaseTask* task = victim.tasks.front();
+		victim.tasks.pop_front();
+		pending_cnt_--;
+		stolen_cnt_++;
+		return task;
+	}
+	return NULL;
+}
+
+void WorkStealingDispatcher::runTask(PxBaseTask &task)
+{
+	task.run();
+	task.release();
+	executed_cnt_++;
+}
+
+// coreで指定した論理コアにスレッドを固定する
+void WorkStealingDispatcher::pinThread(thread &t, PxU32 core)
+{
+	const PxU32 kCoreCnt = PxMax(thread::hardware_concurrency(), 1u);
+#if defined(_WIN32)
+	SetThreadAffinityMask(t.native_handle(), DWORD_PTR(1) << (core % kCoreCnt % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core % kCoreCnt, &cpu_set);
+	pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set), &cpu_set);
+#else
+	PX_UNUSED(t);
+	PX_UNUSED(core);
+	PX_UNUSED(kCoreCnt);
+#endif
+}
+
+// pin_threads: eDEFAULTの場合はPxDefaultCpuDispatcherCreateのアフィニティマスクで固定する
+PxCpuDispatcher* createCpuDispatcher(DispatcherType::Enum type, PxU32 thread_cnt, bool pin_threads)
+{
+	if (type == DispatcherType::eWORK_STEALING)
+		return new WorkStealingDispatcher(thread_cnt, pin_threads);
+
+	if (!pin_threads)
+		return PxDefaultCpuDispatcherCreate(thread_cnt);
+
+	const PxU32 kCoreCnt = PxMax(thread::hardware_concurrency(), 1u);
+	vector<PxU32> affinity_masks(PxMax(thread_cnt, 1u));
+	for (PxU32 i = 0; i != thread_cnt; i++)
+		affinity_masks[i] = 1u << (i % kCoreCnt % 32);
+	return PxDefaultCpuDispatcherCreate(thread_cnt, affinity_masks.data());
+}
+
+void releaseCpuDispatcher(PxCpuDispatcher* dispatcher, DispatcherType::Enum type)
+{
+	if (!dispatcher)
+		return;
+	if (type == DispatcherType::eWORK_STEALING)
+		delete dispatcher;
+	else
+		static_cast<PxDefaultCpuDispatcher*>(dispatcher)->release();
+}
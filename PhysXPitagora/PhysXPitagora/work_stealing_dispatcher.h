@@ -0,0 +1,67 @@
+#pragma once
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+using namespace physx;
+
+// ワークスティーリング方式のCPUディスパッチャ
+// ワーカースレッドごとにタスクのdequeを持ち、ワーカーが投入したタスクは自分のdequeの末尾から取り出す(LIFO)
+// 自分のdequeが空になったら、他のワーカーのdequeの先頭からタスクを盗む
+// PxDefaultCpuDispatcherは全ワーカーで1つのキューを共有するので、タスクが細かいと競合しやすい
+class WorkStealingDispatcher : public PxCpuDispatcher {
+public:
+	// thread_cnt: ワーカースレッド数(0の場合はsubmitTaskを呼んだスレッドでタスクを実行する)
+	// pin_threads: trueの場合、ワーカースレッドをそれぞれ1つのコアに固定する
+	WorkStealingDispatcher(PxU32 thread_cnt, bool pin_threads);
+	virtual ~WorkStealingDispatcher();
+
+	virtual void submitTask(PxBaseTask &task);
+	virtual uint32_t getWorkerCount() const;
+
+	// 実行したタスク数と、そのうち他のワーカーから盗んだタスク数
+	PxU64 getExecutedTaskCount() const { return executed_cnt_; }
+	PxU64 getStolenTaskCount() const { return stolen_cnt_; }
+
+private:
+	struct Worker {
+		mutex task_mutex;          // tasksを保護する
+		deque<PxBaseTask*> tasks;
+		thread worker_thread;
+	};
+
+	vector<unique_ptr<Worker> > workers_;
+	atomic<PxU32> pending_cnt_;      // deque内の未実行タスク数
+	atomic<PxU32> next_worker_;      // ワーカー以外のスレッドから投入する時の投入先
+	atomic<PxU64> executed_cnt_;
+	atomic<PxU64> stolen_cnt_;
+
+	// 待機中のワーカーを起こす
+	mutex sleep_mutex_;
+	condition_variable wake_cv_;
+	bool stopping_;
+
+	void workerLoop(PxU32 index);
+	PxBaseTask* popTask(PxU32 index);
+	PxBaseTask* stealTask(PxU32 index);
+	void runTask(PxBaseTask &task);
+	static void pinThread(thread &t, PxU32 core);
+};
+
+// PxCpuDispatcherの種類
+struct DispatcherType {
+	enum Enum {
+		eDEFAULT,       // PxDefaultCpuDispatcher
+		eWORK_STEALING  // WorkStealingDispatcher
+	};
+};
+
+// ディスパッチャの作成と解放
+PxCpuDispatcher* createCpuDispatcher(DispatcherType::Enum type, PxU32 thread_cnt, bool pin_threads);
+void releaseCpuDispatcher(PxCpuDispatcher* dispatcher, DispatcherType::Enum type);
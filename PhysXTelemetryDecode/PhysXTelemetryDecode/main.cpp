@@ -0,0 +1,94 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <string>
+#include <set>
+#include "../../Common/telemetry_record.h"
+
+using namespace std;
+
+// TelemetryLogのバイナリのログをCSVに変換する
+int main(int argc, char* argv[])
+{
+	// コマンドライン引数
+	//  <path>          : バイナリのログ(TelemetryFormat::eBINARY)
+	//  --output <path> : CSVの書き出し先(省略時は標準出力)
+	//  --actor <id>    : 指定したアクターのレコードのみを書き出す
+	//  --summary       : CSVを書き出さず、レコード数とステップの範囲のみを表示する
+	const char* input_path = NULL;
+	const char* output_path = NULL;
+	bool filter_actor = false;
+	uint32_t actor_id = 0;
+	bool summary_only = false;
+	for (int i = 1; i < argc; i++) {
+		const string kArg = argv[i];
+		if (kArg == "--output" && i + 1 < argc) {
+			output_path = argv[++i];
+		}
+		else if (kArg == "--actor" && i + 1 < argc) {
+			filter_actor = true;
+			actor_id = (uint32_t)atoi(argv[++i]);
+		}
+		else if (kArg == "--summary") {
+			summary_only = true;
+		}
+		else {
+			input_path = argv[i];
+		}
+	}
+	if (!input_path) {
+		cerr << "Usage: PhysXTelemetryDecode <path> [--output <path>] [--actor <id>] [--summary]" << endl;
+		return 1;
+	}
+
+	ifstream in(input_path, ios::binary);
+	TelemetryHeader header;
+	if (!in || !readTelemetryHeader(in, header)) {
+		cerr << "Not a telemetry log: " << input_path << endl;
+		return 1;
+	}
+
+	ofstream file;
+	ostream* out = &cout;
+	if (output_path && !summary_only) {
+		file.open(output_path);
+		if (!file) {
+			cerr << "Failed to open " << output_path << endl;
+			return 1;
+		}
+		out = &file;
+	}
+	if (!summary_only)
+		writeTelemetryCsvHeader(*out);
+
+	// ヘッダのレコード数はログを閉じたときに書き込まれるので、途中で終了したログでは0になる
+	// レコード数ではなくファイルの終わりまで読む
+	TelemetryRecord record;
+	uint64_t record_cnt = 0;
+	uint64_t written_cnt = 0;
+	uint32_t first_step = 0;
+	uint32_t last_step = 0;
+	set<uint32_t> actor_ids;
+	while (in.read((char*)&record, sizeof(record))) {
+		if (record_cnt == 0)
+			first_step = record.step;
+		last_step = record.step;
+		record_cnt++;
+		actor_ids.insert(record.actor_id);
+		if (filter_actor && record.actor_id != actor_id)
+			continue;
+		if (!summary_only)
+			writeTelemetryCsv(*out, record);
+		written_cnt++;
+	}
+
+	cerr << record_cnt << " records (" << header.dropped_cnt << " dropped), " << actor_ids.size() << " actors";
+	if (record_cnt)
+		cerr << ", steps " << first_step << "-" << last_step;
+	cerr << endl;
+	if (filter_actor)
+		cerr << written_cnt << " records of actor " << actor_id << endl;
+	if (header.record_cnt && header.record_cnt != record_cnt)
+		cerr << "Warning: the header has " << header.record_cnt << " records" << endl;
+	return 0;
+}